@@ -0,0 +1,363 @@
+/****************************************************************************
+ *  batch.c is part of dumpomf                                              *
+ *  Copyright (C) 2022 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+/*
+ * --batch support
+ * Files are collected from the command line, directory trees and @filelist
+ * files, then each one is dumped either to <file>.dump or to one combined
+ * output file, each by a worker from jobs.c.
+ * For per file output, a manifest records the size, mtime and decoder version
+ * of each file dumped, so that unchanged files are skipped on a rerun.
+ */
+
+#include "omf.h"
+#include "_version.h"
+#include <sys/stat.h>
+#ifdef _MSC_VER
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
+
+#define DUMPEXT     ".dump"
+#define MANIFESTTAG "# dumpomf manifest"
+
+enum { JOB_OK = 0, JOB_NOOPEN, JOB_NOTOMF, JOB_NOWRITE, JOB_CRASHED, JOB_PENDING, JOB_UNCHANGED };
+
+typedef struct {
+    char *path;
+    long long size;
+    long long mtime;
+    bool fromDir; /* found by directory scan, non OMF files are ignored */
+    int status;
+} job_t;
+
+typedef struct {
+    char *path;
+    long long size;
+    long long mtime;
+    bool valid;
+} manifest_t;
+
+static job_t *jobs;
+static int jobCnt;
+static int jobSize;
+
+static manifest_t *entries;
+static int entryCnt;
+static int entrySize;
+static int *hashTable; /* index into entries, -1 if empty */
+static uint32_t hashSize;
+
+static char const *combined;
+static FILE *combinedFp;
+static char version[32];
+
+/* FNV-1a */
+static uint32_t hashPath(char const *s) {
+    uint32_t hash = 2166136261u;
+    while (*s)
+        hash = (hash ^ (uint8_t)*s++) * 16777619u;
+    return hash;
+}
+
+static int *lookupSlot(char const *path) {
+    uint32_t i = hashPath(path) & (hashSize - 1);
+    while (hashTable[i] >= 0 && strcmp(entries[hashTable[i]].path, path) != 0)
+        i = (i + 1) & (hashSize - 1);
+    return &hashTable[i];
+}
+
+static manifest_t *findEntry(char const *path) {
+    if (!hashSize)
+        return NULL;
+    int idx = *lookupSlot(path);
+    return idx >= 0 && entries[idx].valid ? &entries[idx] : NULL;
+}
+
+static void setEntry(char const *path, long long size, long long mtime) {
+    if (entryCnt * 2 >= (int)hashSize) { /* grow and rehash */
+        hashSize  = hashSize ? hashSize * 2 : 1024;
+        hashTable = xrealloc(hashTable, hashSize * sizeof(int));
+        memset(hashTable, 0xff, hashSize * sizeof(int));
+        for (int i = 0; i < entryCnt; i++)
+            *lookupSlot(entries[i].path) = i;
+    }
+    int *slot = lookupSlot(path);
+    if (*slot < 0) {
+        if (entryCnt >= entrySize) {
+            entrySize = entrySize ? entrySize * 2 : 1024;
+            entries   = xrealloc(entries, entrySize * sizeof(manifest_t));
+        }
+        entries[entryCnt].path = xstrdup(path);
+        *slot                  = entryCnt++;
+    }
+    entries[*slot].size  = size;
+    entries[*slot].mtime = mtime;
+    entries[*slot].valid = true;
+}
+
+/* entries made with a different decoder version are dropped */
+static void addManifestEntry(char const *line) {
+    long long size, mtime;
+    char ver[sizeof(version)];
+    int pos;
+
+    if (sscanf(line, "%lld %lld %31s %n", &size, &mtime, ver, &pos) == 3 && line[pos] &&
+        strcmp(ver, version) == 0)
+        setEntry(line + pos, size, mtime);
+}
+
+/* entries for files not processed this run are retained */
+static void putManifestEntries(FILE *fp) {
+    for (int i = 0; i < entryCnt; i++)
+        if (entries[i].valid)
+            fprintf(fp, "%lld %lld %s %s\n", entries[i].size, entries[i].mtime, version,
+                    entries[i].path);
+}
+
+static void addJob(char *path, long long size, long long mtime, bool fromDir) {
+    if (jobCnt >= jobSize) {
+        jobSize = jobSize ? jobSize * 2 : 256;
+        jobs    = xrealloc(jobs, jobSize * sizeof(job_t));
+    }
+    jobs[jobCnt++] = (job_t){ path, size, mtime, fromDir, JOB_PENDING };
+}
+
+static int cmpJob(void const *a, void const *b) {
+    return strcmp(((job_t const *)a)->path, ((job_t const *)b)->path);
+}
+
+static void addPath(char *path, bool fromDir);
+
+/* files in a directory are added in name order so combined output is repeatable */
+static void scanDir(char const *dir) {
+    int first = jobCnt;
+#ifdef _MSC_VER
+    struct _finddata_t fd;
+    char *pattern = joinPath(dir, "*");
+    intptr_t handle;
+
+    if ((handle = _findfirst(pattern, &fd)) == -1)
+        fprintf(stderr, "%s: can't open directory\n", dir);
+    else {
+        do {
+            if (strcmp(fd.name, ".") != 0 && strcmp(fd.name, "..") != 0)
+                addPath(joinPath(dir, fd.name), true);
+        } while (_findnext(handle, &fd) == 0);
+        _findclose(handle);
+    }
+    free(pattern);
+#else
+    DIR *dp;
+    struct dirent *de;
+
+    if ((dp = opendir(dir)) == NULL) {
+        fprintf(stderr, "%s: can't open directory\n", dir);
+        return;
+    }
+    while ((de = readdir(dp)))
+        if (strcmp(de->d_name, ".") != 0 && strcmp(de->d_name, "..") != 0)
+            addPath(joinPath(dir, de->d_name), true);
+    closedir(dp);
+#endif
+    qsort(jobs + first, jobCnt - first, sizeof(job_t), cmpJob);
+}
+
+static bool isLink(char const *path) {
+#ifdef _MSC_VER
+    return false;
+#else
+    struct stat st;
+
+    return lstat(path, &st) == 0 && (st.st_mode & S_IFMT) == S_IFLNK;
+#endif
+}
+
+/* takes ownership of path. Links to directories found while scanning are
+ * skipped, as a link back up the tree would otherwise be followed forever
+ */
+static void addPath(char *path, bool fromDir) {
+    struct stat st;
+
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "%s: can't access\n", path);
+        free(path);
+    } else if ((st.st_mode & S_IFMT) == S_IFDIR) {
+        if (fromDir && isLink(path))
+            fprintf(stderr, "%s: link to a directory skipped\n", path);
+        else
+            scanDir(path);
+        free(path);
+    } else if ((st.st_mode & S_IFMT) == S_IFREG && !(fromDir && hasSuffix(path, DUMPEXT)))
+        addJob(path, st.st_size, st.st_mtime, fromDir);
+    else
+        free(path);
+}
+
+static void addList(char const *listFile) {
+    FILE *fp;
+    char line[4096];
+
+    if ((fp = fopen(listFile, "r")) == NULL) {
+        fprintf(stderr, "%s: can't open file list\n", listFile);
+        return;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (*line)
+            addPath(xstrdup(line), false);
+    }
+    fclose(fp);
+}
+
+static char *outName(int i) {
+    char const *base = combined ? combined : jobs[i].path;
+    char *name       = xrealloc(NULL, strlen(base) + 16);
+
+    if (combined)
+        sprintf(name, "%s.%d.tmp", combined, i);
+    else
+        strcat(strcpy(name, base), DUMPEXT);
+    return name;
+}
+
+static bool isPending(int i) {
+    return jobs[i].status == JOB_PENDING;
+}
+
+static int runJob(int i) {
+    int spec;
+    char *name = outName(i);
+    int status = JOB_OK;
+
+    if (openInput(jobs[i].path) == NULL)
+        status = JOB_NOOPEN;
+    else {
+        omfFlavour = ANY;
+        spec       = detectOMF();
+        if (spec == OMFUKN && jobs[i].fromDir)
+            status = JOB_NOTOMF;
+        else if ((dst = fopen(name, "w")) == NULL)
+            status = JOB_NOWRITE;
+        else {
+            setOutputBuffer(dst);
+            resetDisplay();
+            displayFile(spec);
+            if (fclose(dst) != 0)
+                status = JOB_NOWRITE;
+        }
+        fclose(src);
+    }
+    free(name);
+    return status;
+}
+
+static void finishJob(int i, int status) {
+    jobs[i].status = status;
+    if (status != JOB_OK && !combined) {
+        manifest_t *entry = findEntry(jobs[i].path);
+        if (entry)
+            entry->valid = false;
+    }
+    switch (status) {
+    case JOB_OK:
+        if (!combined)
+            setEntry(jobs[i].path, jobs[i].size, jobs[i].mtime);
+        break;
+    case JOB_NOOPEN:
+        fprintf(stderr, "%s: can't open\n", jobs[i].path);
+        break;
+    case JOB_NOWRITE:
+        fprintf(stderr, "%s: can't write output\n", jobs[i].path);
+        break;
+    case JOB_CRASHED:
+        fprintf(stderr, "%s: decoder failed\n", jobs[i].path);
+        break;
+    }
+}
+
+/* append completed dumps to the combined output, in job order */
+static int nextOut;
+
+static void flushCombined() {
+    for (; nextOut < jobCnt && jobs[nextOut].status < JOB_PENDING; nextOut++) {
+        char *name = outName(nextOut);
+        FILE *part;
+        if (jobs[nextOut].status == JOB_OK && (part = fopen(name, "r"))) {
+            char buf[BUFSIZ];
+            size_t len;
+            fprintf(combinedFp, "%s:\n", jobs[nextOut].path);
+            while ((len = fread(buf, 1, sizeof(buf), part)) > 0)
+                fwrite(buf, 1, len, combinedFp);
+            putc('\n', combinedFp);
+            fclose(part);
+        }
+        remove(name);
+        free(name);
+    }
+}
+
+int batchDump(int argc, char **argv, int workers, char const *combinedFile,
+              char const *manifest) {
+    int counts[JOB_UNCHANGED + 1] = { 0 };
+
+    combined = combinedFile;
+    sprintf(version, "%.20s%s", GIT_VERSION, rawMode ? "-r" : "");
+    for (int i = 0; i < argc; i++)
+        if (argv[i][0] == '@')
+            addList(argv[i] + 1);
+        else
+            addPath(xstrdup(argv[i]), false);
+
+    if (combined) {
+        if (strcmp(combined, "-") == 0)
+            combinedFp = stdout;
+        else if ((combinedFp = fopen(combined, "w")) == NULL)
+            usage("can't create combined output file\n");
+    } else {
+        readManifest(manifest, addManifestEntry);
+        for (int i = 0; i < jobCnt; i++) {
+            manifest_t *entry = findEntry(jobs[i].path);
+            char *name        = outName(i);
+            struct stat st;
+            if (entry && entry->size == jobs[i].size && entry->mtime == jobs[i].mtime &&
+                stat(name, &st) == 0)
+                jobs[i].status = JOB_UNCHANGED;
+            free(name);
+        }
+    }
+    jobs_t pool = { jobCnt, JOB_CRASHED, isPending, runJob, finishJob,
+                    combinedFp ? flushCombined : NULL };
+    runJobs(&pool, workers);
+
+    if (combinedFp && combinedFp != stdout)
+        fclose(combinedFp);
+    else if (!combined)
+        writeManifest(manifest, MANIFESTTAG, putManifestEntries);
+
+    for (int i = 0; i < jobCnt; i++)
+        counts[jobs[i].status]++;
+    fprintf(stderr, "%d dumped, %d unchanged, %d not OMF, %d failed\n", counts[JOB_OK],
+            counts[JOB_UNCHANGED], counts[JOB_NOTOMF],
+            counts[JOB_NOOPEN] + counts[JOB_NOWRITE] + counts[JOB_CRASHED]);
+    return counts[JOB_NOOPEN] + counts[JOB_NOWRITE] + counts[JOB_CRASHED] ? 1 : 0;
+}
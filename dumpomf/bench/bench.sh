@@ -0,0 +1,75 @@
+#!/bin/bash
+# bench.sh is part of dumpomf
+#
+# usage: bench.sh dumpomf genomf goldendir
+# Checks the dumps of small generated files against the golden dumps, then
+# reports the speed of dumping larger generated files, including worst cases.
+# Run with UPDATE=1 to rewrite the golden dumps after an intended change.
+# Timings are the best of 3 runs, the record counts come from dumpomf -T.
+
+DUMPOMF=$(realpath "$1")
+GENOMF=$(realpath "$2")
+GOLDEN=$3
+WORK=$(mktemp -d)
+TIMEFORMAT=%3R
+trap 'rm -rf "$WORK"' EXIT
+failed=0
+
+# name|genomf options|dumpomf options
+golden=(
+    "omf85|-f 85 -l 2 -r 16|"
+    "omf85-disasm|-f 85 -r 16|--disasm"
+    "omf51|-f 51 -l 2 -r 16|"
+    "omf51-disasm|-f 51 -r 16|--disasm"
+    "omf96|-f 96 -l 2 -r 16|"
+    "omf86|-f 86 -l 2 -r 16|"
+    "omf86-fixups|-f 86 -r 16|--fixups"
+    "omf86-nested|-f 86 -r 8 -d 64|"
+)
+
+# name|genomf options
+bench=(
+    "omf85|-f 85 -l 100 -r 500 -n 32"
+    "omf51|-f 51 -l 100 -r 500 -n 32"
+    "omf96|-f 96 -l 100 -r 500 -n 32"
+    "omf86|-f 86 -l 100 -r 500 -n 32"
+    "omf86-fixups|-f 86 -l 100 -r 500 -x 64"
+    "omf86-nested|-f 86 -l 10 -r 400 -d 2000"
+    "omf86-maxlen|-f 86 -l 10 -r 20 -m"
+)
+
+for t in "${golden[@]}"; do
+    IFS='|' read -r name gen opts <<< "$t"
+    $GENOMF $gen "$WORK/$name.obj" || exit 1
+    $DUMPOMF $opts "$WORK/$name.obj" > "$WORK/$name.dump"
+    if [ -n "$UPDATE" ]; then
+        cp "$WORK/$name.dump" "$GOLDEN/$name.dump"
+    elif ! cmp -s "$WORK/$name.dump" "$GOLDEN/$name.dump"; then
+        echo "golden: $name differs"
+        diff "$GOLDEN/$name.dump" "$WORK/$name.dump" | head -20
+        failed=1
+    fi
+done
+[ -n "$UPDATE" ] && echo "golden dumps updated" || [ $failed -ne 0 ] || echo "golden dumps ok"
+
+printf "%-14s %10s %10s %10s %10s %12s\n" "Bench" "Bytes" "Records" "ms" "MB/s" "Records/s"
+for t in "${bench[@]}"; do
+    IFS='|' read -r name gen <<< "$t"
+    $GENOMF $gen "$WORK/$name.obj" || exit 1
+    bytes=$(wc -c < "$WORK/$name.obj")
+    $DUMPOMF -T "$WORK/$name.obj" > /dev/null 2> "$WORK/timing"
+    records=$(awk '$1 == "Records" { sub(",", "", $2); print $2 }' "$WORK/timing")
+    best=
+    for run in 1 2 3; do
+        secs=$( { time $DUMPOMF "$WORK/$name.obj" > /dev/null; } 2>&1 )
+        if [ -z "$best" ] || awk "BEGIN { exit !($secs < $best) }"; then
+            best=$secs
+        fi
+    done
+    awk -v n="$name" -v b="$bytes" -v r="$records" -v s="$best" 'BEGIN {
+        ms = s * 1000
+        s  = s > 0 ? s : 1e-3
+        printf "%-14s %10d %10d %10.0f %10.1f %12.0f\n", n, b, r, ms, b / s / 1048576, r / s
+    }'
+done
+exit $failed
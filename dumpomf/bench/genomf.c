@@ -0,0 +1,500 @@
+/****************************************************************************
+ *  genomf.c is part of dumpomf                                             *
+ *  Copyright (C) 2022 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+/*
+ * genomf writes synthetic OMF85, OMF51, OMF96 and OMF86 objects and libraries
+ * for benchmarking dumpomf and checking its output. The content is meaningless
+ * but each record is well formed for the decoders, and for a given seed the
+ * file is always the same.
+ * -m makes every data record as long as the record length allows, and -d
+ * sets the nesting depth of the OMF86 LIDATA iterated blocks.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { OMF85 = 85, OMF51 = 51, OMF96 = 96, OMF86 = 86 };
+
+#define MAXBODY 0xfffe /* record length includes the CRC */
+
+static FILE *out;
+static long outPos;
+static uint8_t body[MAXBODY + 1];
+static int bodyLen;
+
+static int format    = OMF86;
+static int modules   = 1;
+static bool library  = false;
+static int records   = 100;
+static int names     = 8;
+static int fixups    = 4;
+static int depth     = 2;
+static bool maxLen   = false;
+static uint32_t seed = 1;
+
+static long *modPos;
+
+_Noreturn static void usage(char const *s) {
+    if (s && *s)
+        fputs(s, stderr);
+    fprintf(stderr,
+            "usage: genomf [-f 85|51|96|86] [-l modules] [-r records] [-n names] [-x fixups]\n"
+            "              [-d depth] [-m] [-s seed] outfile\n"
+            "Where:\n"
+            "  -f fmt      OMF flavour to generate, default 86\n"
+            "  -l n        write a library of n modules, default is a single object\n"
+            "  -r n        data records per module, default 100\n"
+            "  -n n        names per public and external record, default 8\n"
+            "  -x n        fixups per fixup record, default 4\n"
+            "  -d n        OMF86 LIDATA nesting depth, default 2\n"
+            "  -m          make data records the maximum length\n"
+            "  -s n        random number seed, default 1\n");
+    exit(1);
+}
+
+/* xorshift32, good enough for content and sizes */
+static uint32_t rnd(uint32_t range) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return range ? seed % range : seed;
+}
+
+static void put8(uint8_t val) {
+    if (bodyLen >= MAXBODY) {
+        fprintf(stderr, "Fatal: record too long\n");
+        exit(1);
+    }
+    body[bodyLen++] = val;
+}
+
+static void put16(uint16_t val) {
+    put8(val & 0xff);
+    put8(val >> 8);
+}
+
+static void putName(char const *name) {
+    int len = (int)strlen(name);
+    put8(len);
+    while (len--)
+        put8(*name++);
+}
+
+static void putIndex(uint16_t idx) {
+    if (idx >= 0x80)
+        put8(0x80 | (idx >> 8));
+    put8(idx & 0xff);
+}
+
+static void putBytes(int n) {
+    while (n-- > 0)
+        put8(rnd(0x100));
+}
+
+static int room(int used) {
+    return MAXBODY - used;
+}
+
+static void writeRec(uint8_t type) {
+    uint8_t hdr[3] = { type, (bodyLen + 1) & 0xff, (bodyLen + 1) >> 8 };
+    uint8_t crc    = hdr[0] + hdr[1] + hdr[2];
+
+    for (int i = 0; i < bodyLen; i++)
+        crc += body[i];
+    crc = -crc;
+    fwrite(hdr, 1, 3, out);
+    fwrite(body, 1, bodyLen, out);
+    fwrite(&crc, 1, 1, out);
+    outPos += bodyLen + 4;
+    bodyLen = 0;
+}
+
+static char const *symName(char kind, int mod, int i) {
+    static char name[32];
+    sprintf(name, "%c%d_%d", kind, mod, i);
+    return name;
+}
+
+static int dataLen() {
+    return maxLen ? 0 : 16 + rnd(200);
+}
+
+/* OMF85, OMF51 and OMF96 share the library records, apart from OMF96's LIBHDR */
+static void libHeader(long namesPos) {
+    put16(modules);
+    put16(namesPos / 128);
+    put16(namesPos % 128);
+    writeRec(format == OMF96 ? 0x2e : format == OMF86 ? 0xa4 : 0x2c);
+}
+
+static void libTrailer() {
+    long namesPos = outPos;
+
+    for (int m = 0; m < modules; m++)
+        putName(symName('M', m, 0));
+    writeRec(format == OMF86 ? 0xa6 : 0x28); /* LIBNAM */
+    for (int m = 0; m < modules; m++) {
+        put16(modPos[m] / 128);
+        put16(modPos[m] % 128);
+    }
+    writeRec(format == OMF86 ? 0xa8 : 0x26); /* LIBLOC */
+    for (int m = 0; m < modules; m++) {
+        for (int i = 0; i < names; i++)
+            putName(symName('P', m, i));
+        put8(0);
+    }
+    writeRec(format == OMF86 ? 0xaa : 0x2a); /* LIBDIC */
+
+    /* now the names location is known, rewrite the header in place */
+    long endPos = outPos;
+    fseek(out, 0, SEEK_SET);
+    libHeader(namesPos);
+    fseek(out, 0, SEEK_END);
+    outPos = endPos;
+}
+
+static void module85(int m) {
+    putName(symName('M', m, 0));
+    put8(1);    /* PL/M-80 */
+    put8(0x40); /* v4.0 */
+    for (int seg = 1; seg <= 2; seg++) {
+        put8(seg);
+        put16(0x8000);
+        put8(2);
+    }
+    writeRec(0x02);
+    put8(1);
+    for (int i = 0; i < names; i++) {
+        put16(rnd(0x8000));
+        putName(symName('P', m, i));
+        put8(0);
+    }
+    writeRec(0x16);
+    for (int i = 0; i < names; i++) {
+        putName(symName('E', m, i));
+        put8(0);
+    }
+    writeRec(0x18);
+    for (int r = 0; r < records; r++) {
+        uint16_t offset = rnd(0x8000);
+        int len         = dataLen();
+        put8(1 + r % 2);
+        put16(offset);
+        putBytes(len ? len : room(3));
+        writeRec(0x06);
+        if (fixups && len) {
+            put8(3);
+            for (int i = 0; i < fixups; i++) {
+                put16(rnd(names));
+                put16(offset + rnd(len - 1));
+            }
+            writeRec(0x20);
+            put8(3);
+            for (int i = 0; i < fixups; i++)
+                put16(offset + rnd(len - 1));
+            writeRec(0x22);
+        }
+        if (r % 16 == 15) {
+            put8(1);
+            for (int i = 0; i < 8; i++) {
+                put16(offset + i * 2);
+                put16(r * 8 + i);
+            }
+            writeRec(0x08);
+        }
+    }
+    put8(1);
+    put8(1);
+    put16(0);
+    writeRec(0x04);
+}
+
+static void module51(int m) {
+    putName(symName('M', m, 0));
+    put8(0xfe); /* PL/M-51 */
+    put8(0);
+    writeRec(0x02);
+    for (int seg = 1; seg <= 2; seg++) {
+        put8(seg);
+        put8(seg == 1 ? 0 : 2); /* CODE, DATA */
+        put8(1);                /* UNIT */
+        put8(0);
+        put16(0);
+        put16(seg == 1 ? 0x8000 : 0x80);
+        putName(seg == 1 ? "?PR?CODE" : "?DT?DATA");
+    }
+    writeRec(0x0e);
+    for (int i = 0; i < names; i++) {
+        put8(2);
+        put8(i);
+        put8(0);
+        put8(0);
+        putName(symName('E', m, i));
+    }
+    writeRec(0x18);
+    for (int i = 0; i < names; i++) {
+        put8(1);
+        put8(0);
+        put16(rnd(0x8000));
+        put8(0);
+        putName(symName('P', m, i));
+    }
+    writeRec(0x16);
+    for (int r = 0; r < records; r++) {
+        uint16_t offset = rnd(0x8000);
+        int len         = dataLen();
+        put8(1);
+        put16(offset);
+        putBytes(len ? len : room(3));
+        writeRec(0x06);
+        if (fixups && len) {
+            for (int i = 0; i < fixups; i++) {
+                put16(offset + rnd(len - 1));
+                put8(4);          /* Word */
+                put8(i % 2 * 2);  /* segment or external */
+                put8(i % 2 ? rnd(names) : 1);
+                put16(rnd(0x100));
+            }
+            writeRec(0x08);
+        }
+    }
+    putName(symName('M', m, 0));
+    put16(0);
+    put8(1);
+    put8(0);
+    writeRec(0x04);
+}
+
+static void module96(int m) {
+    putName(symName('M', m, 0));
+    put8(0x24); /* PL/M-96 */
+    putName("01/01/90");
+    writeRec(0x02);
+    put8(0x80);
+    put8(1);
+    put16(0x8000);
+    put8(0x81);
+    put8(1);
+    put16(0x100);
+    writeRec(0x20);
+    put8(0x80);
+    for (int i = 0; i < names; i++) {
+        putName(symName('E', m, i));
+        putIndex(i % 12);
+    }
+    writeRec(0x18);
+    put8(0x80);
+    for (int i = 0; i < names; i++) {
+        put16(rnd(0x8000));
+        putName(symName('P', m, i));
+        putIndex(i % 12);
+    }
+    writeRec(0x16);
+    for (int r = 0; r < records; r++) {
+        uint16_t offset = rnd(0x8000);
+        int len         = dataLen();
+        put8(0x80);
+        put16(offset);
+        putBytes(len ? len : room(3));
+        writeRec(0x06);
+        if (fixups && len) {
+            for (int i = 0; i < fixups; i++) {
+                uint8_t ftype = 0x01 | (i % 2 ? 0x80 : 0);
+                put8(ftype);
+                put16(offset + rnd(len - 1));
+                if (ftype & 0x80)
+                    put16(rnd(names));
+                else
+                    put8(0x80);
+                put16(rnd(0x100));
+            }
+            writeRec(0x22);
+        }
+    }
+    put8(0);
+    put8(0);
+    writeRec(0x04);
+}
+
+/* LIDATA iterated blocks, nested to depth, with a short content block at the bottom */
+static void iterated86(int level) {
+    put16(2); /* repeat */
+    if (level >= depth) {
+        put16(0);
+        put8(4);
+        putBytes(4);
+    } else {
+        int blocks = level == 1 ? 2 : 1;
+        put16(blocks);
+        while (blocks--)
+            iterated86(level + 1);
+    }
+}
+
+static void module86(int m) {
+    static char const *lnames[] = { "", "CODE", "DATA", "DGROUP", NULL };
+
+    putName(symName('M', m, 0));
+    writeRec(0x80);
+    put8(0);
+    put8(0);
+    putName("genomf");
+    writeRec(0x88);
+    for (int i = 0; lnames[i]; i++)
+        putName(lnames[i]);
+    writeRec(0x96);
+    for (int seg = 1; seg <= 2; seg++) {
+        put8(0x48); /* relocatable, word aligned, public */
+        put16(0xfff0);
+        putIndex(seg + 1);
+        putIndex(seg + 1);
+        putIndex(1);
+        writeRec(0x98);
+    }
+    putIndex(4);
+    put8(0xff);
+    putIndex(2);
+    writeRec(0x9a);
+    for (int i = 0; i < names; i++) {
+        putName(symName('E', m, i));
+        putIndex(0);
+    }
+    writeRec(0x8c);
+    putIndex(0);
+    putIndex(1);
+    for (int i = 0; i < names; i++) {
+        putName(symName('P', m, i));
+        put16(rnd(0x8000));
+        putIndex(0);
+    }
+    writeRec(0x90);
+    for (int r = 0; r < records; r++) {
+        uint16_t offset = rnd(0x8000);
+        int len         = dataLen();
+        if (r % 8 == 7 && !maxLen) {
+            putIndex(2);
+            put16(offset);
+            iterated86(1);
+            writeRec(0xa2);
+            continue;
+        }
+        putIndex(1 + r % 2);
+        put16(offset);
+        putBytes(len ? len : room(3));
+        writeRec(0xa0);
+        if (fixups && len > 2) {
+            for (int i = 0; i < fixups; i++) {
+                uint16_t loc = rnd(len - 2);
+                put8(0xc4 | (loc >> 8)); /* segment relative, offset */
+                put8(loc & 0xff);
+                put8(i % 2 ? 0x56 : 0x54); /* F5, EXTDEF or SEGDEF target, no displacement */
+                putIndex(i % 2 ? 1 + rnd(names) : 1 + r % 2);
+            }
+            writeRec(0x9c);
+        }
+    }
+    put8(0);
+    writeRec(0x8a);
+}
+
+int main(int argc, char **argv) {
+    while (argc > 2 && argv[1][0] == '-') {
+        char opt = argv[1][1];
+        if (opt == 'm') {
+            maxLen = true;
+            argc--, argv++;
+            continue;
+        }
+        int val = atoi(argv[2]);
+        switch (opt) {
+        case 'f':
+            if (val != OMF85 && val != OMF51 && val != OMF96 && val != OMF86)
+                usage("unknown format\n");
+            format = val;
+            break;
+        case 'l':
+            library = true;
+            modules = val;
+            break;
+        case 'r':
+            records = val;
+            break;
+        case 'n':
+            names = val;
+            break;
+        case 'x':
+            fixups = val;
+            break;
+        case 'd':
+            depth = val;
+            break;
+        case 's':
+            seed = val ? val : 1;
+            break;
+        default:
+            usage("unknown option\n");
+        }
+        argc -= 2, argv += 2;
+    }
+    if (argc != 2)
+        usage(NULL);
+    if (modules < 1 || records < 0 || names < 1 || names > 255 || fixups < 0 || depth < 1)
+        usage("invalid count\n");
+    if ((out = fopen(argv[1], "wb")) == NULL) {
+        fprintf(stderr, "%s: can't create\n", argv[1]);
+        return 1;
+    }
+    if (!(modPos = malloc(modules * sizeof(long)))) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        return 1;
+    }
+    if (library)
+        libHeader(0);
+    for (int m = 0; m < modules; m++) {
+        modPos[m] = outPos;
+        switch (format) {
+        case OMF85:
+            module85(m);
+            break;
+        case OMF51:
+            module51(m);
+            break;
+        case OMF96:
+            module96(m);
+            break;
+        case OMF86:
+            module86(m);
+            break;
+        }
+    }
+    if (library)
+        libTrailer();
+    if (format == OMF85 || format == OMF96)
+        writeRec(0x0e); /* EOF */
+    if (fclose(out) != 0) {
+        fprintf(stderr, "%s: write error\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}
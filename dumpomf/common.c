@@ -12,6 +12,7 @@
 #define MINGAP   3  /* min gap between columns */
 #define INDENT   8  /* indent of non record header lines */
 #define LOCWIDTH 13 /* width of start of record inof 'XXXX:XX #nnn '*/
+#define OUTBUFSIZE 0x100000 /* output buffer, only one output file is open at a time */
 
 extern bool malformed;
 
@@ -35,6 +36,20 @@ uint16_t getCol() {
     return cCol;
 }
 
+/* reset record numbering when more than one file is dumped */
+void resetDisplay() {
+    recCnt = 0;
+}
+
+/* write the dump in large blocks rather than a line at a time, unless interactive */
+void setOutputBuffer(FILE *fp) {
+    static char *outBuf;
+
+    if (isatty(fileno(fp)) || (!outBuf && !(outBuf = malloc(OUTBUFSIZE))))
+        return;
+    setvbuf(fp, outBuf, _IOFBF, OUTBUFSIZE);
+}
+
 void startCol(int n) {
     if (nCol != n || n <= 1) {
         displayLine(); /* flush any pending line */
@@ -54,8 +69,12 @@ void startCol(int n) {
             cCol         = 0;
         }
     }
-    if (n == 0 && recCnt++)
+    if (n == 0 && recCnt++) {
+        int phase = setPhase(PH_OUTPUT);
         putc('\n', dst);
+        countBytes(PH_OUTPUT, 1);
+        setPhase(phase);
+    }
     markRecPos();
     curField = -1;
 }
@@ -70,10 +89,14 @@ void fixCol() {
 }
 
 void _add(char const *fmt, va_list args) {
-    pPos += vsprintf(line + pPos, fmt, args);
+    int phase = setPhase(PH_FORMAT);
+    int len   = vsprintf(line + pPos, fmt, args);
+    countBytes(PH_FORMAT, len);
+    pPos += len;
     if (pPos >= cEnd + MAXOVER)
         splitLine();
     cCol = pPos - sPos;
+    setPhase(phase);
 }
 
 void addAt(int col, char const *fmt, ...) {
@@ -120,10 +143,14 @@ void splitLine() {
         int colOff     = pPos - sPos;
         int ch         = line[colSplit];
         line[colSplit] = 0; /* separate off the earlier columns */
-        displayLine();
+        if (line[strspn(line, " |")]) {
+            pPos = colSplit - 2; /* drop the column separator */
+            displayLine();
+        } else
+            sPos = 0;
         line[colSplit] = ch;
-        strcpy(line, line + colSplit); /* move down the original line and '\0' */
-        cCol = colOff;                 /* fixup to insert point */
+        memmove(line, line + colSplit, strlen(line + colSplit) + 1); /* move down the original line and '\0' */
+        pPos = cCol = colOff;          /* fixup to insert point */
     }
 }
 
@@ -132,13 +159,17 @@ void displayLine() {
         pPos--;
     line[pPos] = 0;
     if (*line) {
+        int phase = setPhase(PH_OUTPUT);
+        int len;
         if (nCol)
-            fprintf(dst, "%*s%s\n", INDENT, "", line);
+            len = fprintf(dst, "%*s%s\n", INDENT, "", line);
         else {
-            fprintf(dst, "%04lX:%02lX #%u %s\n", start / 128, start % 128, recCnt, line);
+            len = fprintf(dst, "%04lX:%02lX #%u %s\n", start / 128, start % 128, recCnt, line);
             //nCol = 1;
         }
-            *line = 0;
+        countBytes(PH_OUTPUT, len);
+        setPhase(phase);
+        *line = 0;
     }
     pPos = sPos = 0;
     cCol        = 0;
@@ -148,15 +179,18 @@ void Log(char const *fmt, ...) {
     va_list args;
     va_start(args, fmt);
 
-    char logMsg[512];
+    char logMsg[512] = "";
+    int phase        = setPhase(PH_OUTPUT);
     if (nCol)
         sprintf(logMsg, "%*s", INDENT, "");
     else
-        fprintf(dst, "%04lX:%02lX =%u ", start / 128, start % 128, recCnt);
+        countBytes(PH_OUTPUT, fprintf(dst, "%04lX:%02lX =%u ", start / 128, start % 128, recCnt));
 
     vsprintf(logMsg + strlen(logMsg), fmt, args);
     strcat(logMsg, "\n");
     fputs(logMsg, dst);
+    countBytes(PH_OUTPUT, strlen(logMsg));
+    setPhase(phase);
     if (dst != stdout && !isatty(fileno(dst)))
         fputs(logMsg, stderr);
     va_end(args);
@@ -166,42 +200,119 @@ void invalidRecord(int type) {
     hexDump(0, false);
 }
 
+static char const hexDigits[] = "0123456789ABCDEF";
+
+/* emit val as upper case hex with at least width digits, i.e. %0*X */
+static char *putHex(char *s, uint32_t val, int width) {
+    char tmp[8];
+    int n = 0;
+    do {
+        tmp[n++] = hexDigits[val & 0xf];
+    } while ((val >>= 4));
+    while (n < width)
+        tmp[n++] = '0';
+    while (n)
+        *s++ = tmp[--n];
+    return s;
+}
+
+/* pad to col, always emitting at least one space, mirrors addAt */
+static char *padTo(char *s, char const *base, int col) {
+    do {
+        *s++ = ' ';
+    } while (base + col > s);
+    return s;
+}
+
+/* Intel style hex i.e. %0*XH, with a leading 0 if it would start with a letter */
+char *intelHex(char *s, uint32_t val, int width) {
+    int n = sprintf(s, "%0*XH", width, val);
+    if (s[0] > '9') {
+        memmove(s + 1, s, n + 1);
+        s[0] = '0';
+    }
+    return s;
+}
+
+/* append n bytes as " XX", equivalent to n calls of add(" %02X", c) */
+void addHexBytes(uint8_t const *bytes, int n) {
+    int phase = setPhase(PH_FORMAT);
+    countBytes(PH_FORMAT, n * 3);
+    for (int i = 0; i < n; i++) {
+        line[pPos++] = ' ';
+        line[pPos++] = hexDigits[bytes[i] >> 4];
+        line[pPos++] = hexDigits[bytes[i] & 0xf];
+        if (pPos >= cEnd + MAXOVER)
+            splitLine();
+        cCol = pPos - sPos;
+    }
+    setPhase(phase);
+}
+
+/*
+ * hexDump rows are formatted in one pass and written directly to dst, bypassing the
+ * vsprintf based column logic. The layout is identical to building the row via
+ * add / addAt, including the "at least one space" behaviour of addAt.
+ */
 void hexDump(unsigned addr, bool showLoc) {
     unsigned rowAddr = addr & ~0xf;
     int idx          = addr & 0xf;
-    char ascii[17]; /* 16 chars + '\0' */
-    int i;
-    uint16_t loc = 0;
-    int dataCol  = 0;
+    uint16_t loc     = 0;
+    int dataCol      = 0;
+    uint8_t bytes[16];
+    char row[INDENT + MAXPOS + 1];
+    int phase;
 
     if (addr == 0) /* don't need offsets if address is 0 */
         showLoc = false;
     startCol(1);
+    memset(row, ' ', INDENT);
+    phase = setPhase(PH_FORMAT);
 
     while (!atEndRec()) {
+        char *base = row + INDENT;
+        char *s    = base;
+        int i, end;
+
         if (showLoc) {
-            add("%03X> ", loc);
+            s    = putHex(s, loc, 3);
+            *s++ = '>';
+            *s++ = ' ';
             loc += 16;
         }
-        add("%04X", rowAddr);
+        s = putHex(s, rowAddr, 4);
         if (!dataCol)
-            dataCol = getCol() + 2;
-        for (i = 0; i < 16 && !atEndRec(); i++) {
-            if (i == 8)
-                addAt(dataCol + 8 * HEXWIDTH + 1, "|");
-            if (i >= idx) {
-                uint8_t c = getu8();
+            dataCol = (int)(s - base) + 2;
 
-                addAt(dataCol + i * HEXWIDTH + i / 4 + i / 8, "%02X", c);
-                ascii[i] = ' ' <= c && c < 0x7f ? c : '.';
+        for (end = idx; end < 16 && !atEndRec(); end++)
+            bytes[end] = getu8();
+
+        for (i = 0; i < end; i++) {
+            if (i == 8) {
+                s    = padTo(s, base, dataCol + 8 * HEXWIDTH + 1);
+                *s++ = '|';
+            }
+            if (i >= idx) {
+                s    = padTo(s, base, dataCol + i * HEXWIDTH + i / 4 + i / 8);
+                *s++ = hexDigits[bytes[i] >> 4];
+                *s++ = hexDigits[bytes[i] & 0xf];
             }
         }
-        ascii[i] = 0;
-        addAt(dataCol + ASCIICOL + idx, "|%s|", ascii + idx);
-        displayLine();
+        s    = padTo(s, base, dataCol + ASCIICOL + idx);
+        *s++ = '|';
+        for (i = idx; i < end; i++)
+            *s++ = ' ' <= bytes[i] && bytes[i] < 0x7f ? bytes[i] : '.';
+        *s++ = '|';
+        *s++ = '\n';
+        countBytes(PH_FORMAT, s - row);
+        setPhase(PH_OUTPUT);
+        fwrite(row, 1, s - row, dst);
+        countBytes(PH_OUTPUT, s - row);
+        setPhase(PH_FORMAT);
         rowAddr += 16;
         idx = 0;
     }
+    setPhase(phase);
 }
 
 void oaddHeader(uint8_t cols, ofield_t const *fields) {
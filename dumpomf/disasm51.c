@@ -0,0 +1,396 @@
+/****************************************************************************
+ *  disasm51.c is part of dumpomf                                           *
+ *  Copyright (C) 2022 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+/*
+ * --disasm support for OMF51
+ * CONTENT records for CODE and ABS segments are disassembled using a static
+ * opcode table. Operand formats in the table are
+ *   %d direct address  %b bit address   %i #data   %j #data16
+ *   %l addr16          %a addr11        %r relative
+ * The FIXUP records following a CONTENT record are read ahead into a hash
+ * table keyed on the record relative location, and labels from PUBLICS
+ * and DBGITEM records are kept in a hash table keyed on segment and offset.
+ */
+
+#include "omf.h"
+
+typedef struct {
+    char const *mnemonic;
+    char const *operands;
+    uint8_t len;
+} op51_t;
+
+typedef struct {
+    uint16_t loc;
+    uint8_t refTyp;
+    uint8_t idBlk;
+    uint8_t id;
+    uint16_t offset;
+} fixup51_t;
+
+typedef struct {
+    uint32_t key; /* segId << 24 | offset */
+    char const *name;
+} label51_t;
+
+static op51_t const opTable[256] = {
+    /* 00 */ { "nop", "", 1 }, { "ajmp", "%a", 2 }, { "ljmp", "%l", 3 }, { "rr", "A", 1 },
+    /* 04 */ { "inc", "A", 1 }, { "inc", "%d", 2 }, { "inc", "@R0", 1 }, { "inc", "@R1", 1 },
+    /* 08 */ { "inc", "R0", 1 }, { "inc", "R1", 1 }, { "inc", "R2", 1 }, { "inc", "R3", 1 },
+    /* 0C */ { "inc", "R4", 1 }, { "inc", "R5", 1 }, { "inc", "R6", 1 }, { "inc", "R7", 1 },
+    /* 10 */ { "jbc", "%b,%r", 3 }, { "acall", "%a", 2 }, { "lcall", "%l", 3 }, { "rrc", "A", 1 },
+    /* 14 */ { "dec", "A", 1 }, { "dec", "%d", 2 }, { "dec", "@R0", 1 }, { "dec", "@R1", 1 },
+    /* 18 */ { "dec", "R0", 1 }, { "dec", "R1", 1 }, { "dec", "R2", 1 }, { "dec", "R3", 1 },
+    /* 1C */ { "dec", "R4", 1 }, { "dec", "R5", 1 }, { "dec", "R6", 1 }, { "dec", "R7", 1 },
+    /* 20 */ { "jb", "%b,%r", 3 }, { "ajmp", "%a", 2 }, { "ret", "", 1 }, { "rl", "A", 1 },
+    /* 24 */ { "add", "A,%i", 2 }, { "add", "A,%d", 2 }, { "add", "A,@R0", 1 }, { "add", "A,@R1", 1 },
+    /* 28 */ { "add", "A,R0", 1 }, { "add", "A,R1", 1 }, { "add", "A,R2", 1 }, { "add", "A,R3", 1 },
+    /* 2C */ { "add", "A,R4", 1 }, { "add", "A,R5", 1 }, { "add", "A,R6", 1 }, { "add", "A,R7", 1 },
+    /* 30 */ { "jnb", "%b,%r", 3 }, { "acall", "%a", 2 }, { "reti", "", 1 }, { "rlc", "A", 1 },
+    /* 34 */ { "addc", "A,%i", 2 }, { "addc", "A,%d", 2 }, { "addc", "A,@R0", 1 }, { "addc", "A,@R1", 1 },
+    /* 38 */ { "addc", "A,R0", 1 }, { "addc", "A,R1", 1 }, { "addc", "A,R2", 1 }, { "addc", "A,R3", 1 },
+    /* 3C */ { "addc", "A,R4", 1 }, { "addc", "A,R5", 1 }, { "addc", "A,R6", 1 }, { "addc", "A,R7", 1 },
+    /* 40 */ { "jc", "%r", 2 }, { "ajmp", "%a", 2 }, { "orl", "%d,A", 2 }, { "orl", "%d,%i", 3 },
+    /* 44 */ { "orl", "A,%i", 2 }, { "orl", "A,%d", 2 }, { "orl", "A,@R0", 1 }, { "orl", "A,@R1", 1 },
+    /* 48 */ { "orl", "A,R0", 1 }, { "orl", "A,R1", 1 }, { "orl", "A,R2", 1 }, { "orl", "A,R3", 1 },
+    /* 4C */ { "orl", "A,R4", 1 }, { "orl", "A,R5", 1 }, { "orl", "A,R6", 1 }, { "orl", "A,R7", 1 },
+    /* 50 */ { "jnc", "%r", 2 }, { "acall", "%a", 2 }, { "anl", "%d,A", 2 }, { "anl", "%d,%i", 3 },
+    /* 54 */ { "anl", "A,%i", 2 }, { "anl", "A,%d", 2 }, { "anl", "A,@R0", 1 }, { "anl", "A,@R1", 1 },
+    /* 58 */ { "anl", "A,R0", 1 }, { "anl", "A,R1", 1 }, { "anl", "A,R2", 1 }, { "anl", "A,R3", 1 },
+    /* 5C */ { "anl", "A,R4", 1 }, { "anl", "A,R5", 1 }, { "anl", "A,R6", 1 }, { "anl", "A,R7", 1 },
+    /* 60 */ { "jz", "%r", 2 }, { "ajmp", "%a", 2 }, { "xrl", "%d,A", 2 }, { "xrl", "%d,%i", 3 },
+    /* 64 */ { "xrl", "A,%i", 2 }, { "xrl", "A,%d", 2 }, { "xrl", "A,@R0", 1 }, { "xrl", "A,@R1", 1 },
+    /* 68 */ { "xrl", "A,R0", 1 }, { "xrl", "A,R1", 1 }, { "xrl", "A,R2", 1 }, { "xrl", "A,R3", 1 },
+    /* 6C */ { "xrl", "A,R4", 1 }, { "xrl", "A,R5", 1 }, { "xrl", "A,R6", 1 }, { "xrl", "A,R7", 1 },
+    /* 70 */ { "jnz", "%r", 2 }, { "acall", "%a", 2 }, { "orl", "C,%b", 2 }, { "jmp", "@A+DPTR", 1 },
+    /* 74 */ { "mov", "A,%i", 2 }, { "mov", "%d,%i", 3 }, { "mov", "@R0,%i", 2 }, { "mov", "@R1,%i", 2 },
+    /* 78 */ { "mov", "R0,%i", 2 }, { "mov", "R1,%i", 2 }, { "mov", "R2,%i", 2 }, { "mov", "R3,%i", 2 },
+    /* 7C */ { "mov", "R4,%i", 2 }, { "mov", "R5,%i", 2 }, { "mov", "R6,%i", 2 }, { "mov", "R7,%i", 2 },
+    /* 80 */ { "sjmp", "%r", 2 }, { "ajmp", "%a", 2 }, { "anl", "C,%b", 2 }, { "movc", "A,@A+PC", 1 },
+    /* 84 */ { "div", "AB", 1 }, { "mov", "%d,%d", 3 }, { "mov", "%d,@R0", 2 }, { "mov", "%d,@R1", 2 },
+    /* 88 */ { "mov", "%d,R0", 2 }, { "mov", "%d,R1", 2 }, { "mov", "%d,R2", 2 }, { "mov", "%d,R3", 2 },
+    /* 8C */ { "mov", "%d,R4", 2 }, { "mov", "%d,R5", 2 }, { "mov", "%d,R6", 2 }, { "mov", "%d,R7", 2 },
+    /* 90 */ { "mov", "DPTR,%j", 3 }, { "acall", "%a", 2 }, { "mov", "%b,C", 2 }, { "movc", "A,@A+DPTR", 1 },
+    /* 94 */ { "subb", "A,%i", 2 }, { "subb", "A,%d", 2 }, { "subb", "A,@R0", 1 }, { "subb", "A,@R1", 1 },
+    /* 98 */ { "subb", "A,R0", 1 }, { "subb", "A,R1", 1 }, { "subb", "A,R2", 1 }, { "subb", "A,R3", 1 },
+    /* 9C */ { "subb", "A,R4", 1 }, { "subb", "A,R5", 1 }, { "subb", "A,R6", 1 }, { "subb", "A,R7", 1 },
+    /* A0 */ { "orl", "C,/%b", 2 }, { "ajmp", "%a", 2 }, { "mov", "C,%b", 2 }, { "inc", "DPTR", 1 },
+    /* A4 */ { "mul", "AB", 1 }, { "db", "0A5H", 1 }, { "mov", "@R0,%d", 2 }, { "mov", "@R1,%d", 2 },
+    /* A8 */ { "mov", "R0,%d", 2 }, { "mov", "R1,%d", 2 }, { "mov", "R2,%d", 2 }, { "mov", "R3,%d", 2 },
+    /* AC */ { "mov", "R4,%d", 2 }, { "mov", "R5,%d", 2 }, { "mov", "R6,%d", 2 }, { "mov", "R7,%d", 2 },
+    /* B0 */ { "anl", "C,/%b", 2 }, { "acall", "%a", 2 }, { "cpl", "%b", 2 }, { "cpl", "C", 1 },
+    /* B4 */ { "cjne", "A,%i,%r", 3 }, { "cjne", "A,%d,%r", 3 }, { "cjne", "@R0,%i,%r", 3 }, { "cjne", "@R1,%i,%r", 3 },
+    /* B8 */ { "cjne", "R0,%i,%r", 3 }, { "cjne", "R1,%i,%r", 3 }, { "cjne", "R2,%i,%r", 3 }, { "cjne", "R3,%i,%r", 3 },
+    /* BC */ { "cjne", "R4,%i,%r", 3 }, { "cjne", "R5,%i,%r", 3 }, { "cjne", "R6,%i,%r", 3 }, { "cjne", "R7,%i,%r", 3 },
+    /* C0 */ { "push", "%d", 2 }, { "ajmp", "%a", 2 }, { "clr", "%b", 2 }, { "clr", "C", 1 },
+    /* C4 */ { "swap", "A", 1 }, { "xch", "A,%d", 2 }, { "xch", "A,@R0", 1 }, { "xch", "A,@R1", 1 },
+    /* C8 */ { "xch", "A,R0", 1 }, { "xch", "A,R1", 1 }, { "xch", "A,R2", 1 }, { "xch", "A,R3", 1 },
+    /* CC */ { "xch", "A,R4", 1 }, { "xch", "A,R5", 1 }, { "xch", "A,R6", 1 }, { "xch", "A,R7", 1 },
+    /* D0 */ { "pop", "%d", 2 }, { "acall", "%a", 2 }, { "setb", "%b", 2 }, { "setb", "C", 1 },
+    /* D4 */ { "da", "A", 1 }, { "djnz", "%d,%r", 3 }, { "xchd", "A,@R0", 1 }, { "xchd", "A,@R1", 1 },
+    /* D8 */ { "djnz", "R0,%r", 2 }, { "djnz", "R1,%r", 2 }, { "djnz", "R2,%r", 2 }, { "djnz", "R3,%r", 2 },
+    /* DC */ { "djnz", "R4,%r", 2 }, { "djnz", "R5,%r", 2 }, { "djnz", "R6,%r", 2 }, { "djnz", "R7,%r", 2 },
+    /* E0 */ { "movx", "A,@DPTR", 1 }, { "ajmp", "%a", 2 }, { "movx", "A,@R0", 1 }, { "movx", "A,@R1", 1 },
+    /* E4 */ { "clr", "A", 1 }, { "mov", "A,%d", 2 }, { "mov", "A,@R0", 1 }, { "mov", "A,@R1", 1 },
+    /* E8 */ { "mov", "A,R0", 1 }, { "mov", "A,R1", 1 }, { "mov", "A,R2", 1 }, { "mov", "A,R3", 1 },
+    /* EC */ { "mov", "A,R4", 1 }, { "mov", "A,R5", 1 }, { "mov", "A,R6", 1 }, { "mov", "A,R7", 1 },
+    /* F0 */ { "movx", "@DPTR,A", 1 }, { "acall", "%a", 2 }, { "movx", "@R0,A", 1 }, { "movx", "@R1,A", 1 },
+    /* F4 */ { "cpl", "A", 1 }, { "mov", "%d,A", 2 }, { "mov", "@R0,A", 1 }, { "mov", "@R1,A", 1 },
+    /* F8 */ { "mov", "R0,A", 1 }, { "mov", "R1,A", 1 }, { "mov", "R2,A", 1 }, { "mov", "R3,A", 1 },
+    /* FC */ { "mov", "R4,A", 1 }, { "mov", "R5,A", 1 }, { "mov", "R6,A", 1 }, { "mov", "R7,A", 1 },
+};
+
+/* SFR names for direct addresses 80H-FFH */
+static char const *sfrNames[128] = {
+    [0x00] = "P0",   [0x01] = "SP",   [0x02] = "DPL",  [0x03] = "DPH", [0x07] = "PCON",
+    [0x08] = "TCON", [0x09] = "TMOD", [0x0a] = "TL0",  [0x0b] = "TL1", [0x0c] = "TH0",
+    [0x0d] = "TH1",  [0x10] = "P1",   [0x18] = "SCON", [0x19] = "SBUF", [0x20] = "P2",
+    [0x28] = "IE",   [0x30] = "P3",   [0x38] = "IP",   [0x50] = "PSW", [0x60] = "ACC",
+    [0x70] = "B"
+};
+
+static uint8_t segType[256]; /* low 3 bits of SEGDEF info, 0 is CODE */
+
+static fixup51_t *fixups; /* open addressing, loc 0xffff is empty */
+static uint32_t fixupSize;
+
+static label51_t *labels; /* open addressing, NULL name is empty */
+static uint32_t labelSize;
+static uint32_t labelCnt;
+
+static uint32_t hash32(uint32_t key) {
+    key ^= key >> 16;
+    key *= 0x7feb352d;
+    key ^= key >> 15;
+    return key;
+}
+
+/* called from init51, label names are in the per module name space */
+void resetDisasm51() {
+    if (labelCnt)
+        memset(labels, 0, labelSize * sizeof(label51_t));
+    labelCnt = 0;
+    memset(segType, 0, sizeof(segType));
+}
+
+void setSegType51(uint8_t segId, uint8_t info) {
+    segType[segId] = info & 7;
+}
+
+bool isCodeSeg51(uint8_t segId) {
+    return segType[segId] == 0;
+}
+
+static label51_t *labelSlot(uint32_t key) {
+    uint32_t i = hash32(key) & (labelSize - 1);
+    while (labels[i].name && labels[i].key != key)
+        i = (i + 1) & (labelSize - 1);
+    return &labels[i];
+}
+
+/* the first name seen for an address is kept */
+void addLabel51(uint8_t segId, uint16_t offset, char const *name) {
+    uint32_t key = (uint32_t)segId << 24 | offset;
+
+    if (labelCnt * 2 >= labelSize) { /* grow and rehash */
+        label51_t *old   = labels;
+        uint32_t oldSize = labelSize;
+        labelSize        = labelSize ? labelSize * 2 : 1024;
+        labels           = xcalloc(labelSize, sizeof(label51_t));
+        for (uint32_t i = 0; i < oldSize; i++)
+            if (old[i].name)
+                *labelSlot(old[i].key) = old[i];
+        free(old);
+    }
+    label51_t *slot = labelSlot(key);
+    if (!slot->name) {
+        *slot = (label51_t){ key, name };
+        labelCnt++;
+    }
+}
+
+static char const *findLabel(uint8_t segId, uint16_t offset) {
+    return labelSize ? labelSlot((uint32_t)segId << 24 | offset)->name : NULL;
+}
+
+static fixup51_t *fixupSlot(uint16_t loc) {
+    uint32_t i = hash32(loc) & (fixupSize - 1);
+    while (fixups[i].loc != 0xffff && fixups[i].loc != loc)
+        i = (i + 1) & (fixupSize - 1);
+    return &fixups[i];
+}
+
+static fixup51_t const *findFixup(uint16_t loc) {
+    fixup51_t const *fix = fixupSize ? fixupSlot(loc) : NULL;
+    return fix && fix->loc == loc ? fix : NULL;
+}
+
+/*
+ * read ahead the FIXUP records that follow the current CONTENT record into
+ * the fixup hash table, then reload the CONTENT record
+ */
+static void loadFixups() {
+    uint32_t cnt = 0;
+
+    if (fixupSize)
+        memset(fixups, 0xff, fixupSize * sizeof(fixup51_t));
+    while ((peekNextRecType() & ~1) == 8 && loadRec() >= 0) {
+        uint32_t need = (cnt + (recEndPtr - recPtr) / 7) * 2;
+        if (need > fixupSize) { /* grow, re-adding existing entries */
+            fixup51_t *old   = fixups;
+            uint32_t oldSize = fixupSize;
+            while (fixupSize < need)
+                fixupSize = fixupSize ? fixupSize * 2 : 256;
+            fixups = xrealloc(NULL, fixupSize * sizeof(fixup51_t));
+            memset(fixups, 0xff, fixupSize * sizeof(fixup51_t));
+            for (uint32_t i = 0; i < oldSize; i++)
+                if (old[i].loc != 0xffff)
+                    *fixupSlot(old[i].loc) = old[i];
+            free(old);
+        }
+        while (!atEndRec() && !malformed) {
+            fixup51_t fix;
+            fix.loc    = getu16();
+            fix.refTyp = getu8() & 7;
+            fix.idBlk  = getu8();
+            fix.id     = getu8();
+            fix.offset = getu16();
+            if (!malformed && fix.loc != 0xffff) {
+                fixup51_t *slot = fixupSlot(fix.loc);
+                cnt += slot->loc == 0xffff;
+                *slot = fix;
+            }
+        }
+    }
+    seekInput(start);
+    loadRec();
+}
+
+/* the fixup target as name[+offset], using a label if one matches */
+static char *fixupTarget(char *s, fixup51_t const *fix) {
+    char const *name;
+    uint16_t offset = fix->offset;
+    char hex[12];
+
+    if (fix->idBlk == 2)
+        name = getIndexName(IEXT, fix->id);
+    else if (fix->idBlk < 2) {
+        if (fix->idBlk == 0 && (name = findLabel(fix->id, offset)))
+            offset = 0;
+        else
+            name = getIndexName(ISEG, fix->id);
+    } else {
+        sprintf(hex, "ID%d", fix->idBlk);
+        name = hex;
+    }
+    s += sprintf(s, "%s", name);
+    if (offset >= 0x8000)
+        s += sprintf(s, "-%s", intelHex(hex, 0x10000 - offset, 2));
+    else if (offset)
+        s += sprintf(s, "+%s", intelHex(hex, offset, 2));
+    return s;
+}
+
+static char *fixedOperand(char *s, fixup51_t const *fix) {
+    static char const *wrap[] = { "LOW(", "", "", "HIGH(", "", "", "", "((" };
+
+    s += sprintf(s, "%s", wrap[fix->refTyp]);
+    s = fixupTarget(s, fix);
+    if (fix->refTyp == 7)
+        s += sprintf(s, "-20H)*8)");
+    else if (*wrap[fix->refTyp])
+        *s++ = ')', *s = '\0';
+    return s;
+}
+
+static char *direct(char *s, uint8_t addr) {
+    if (addr >= 0x80 && sfrNames[addr - 0x80])
+        return s + sprintf(s, "%s", sfrNames[addr - 0x80]);
+    return s + strlen(intelHex(s, addr, 2));
+}
+
+static char *bit(char *s, uint8_t addr) {
+    uint8_t byteAddr = addr < 0x80 ? 0x20 + addr / 8 : addr & 0xf8;
+    if (addr < 0x80 || sfrNames[byteAddr - 0x80]) {
+        s = direct(s, byteAddr);
+        return s + sprintf(s, ".%d", addr & 7);
+    }
+    return s + strlen(intelHex(s, addr, 2));
+}
+
+static char *codeAddr(char *s, uint8_t segId, uint16_t addr) {
+    char const *name = findLabel(segId, addr);
+    if (name)
+        return s + sprintf(s, "%s", name);
+    return s + strlen(intelHex(s, addr, 4));
+}
+
+/*
+ * code points to the instruction, at record relative loc and segment offset
+ * pc, returns the formatted operands
+ */
+static void operands(char *s, op51_t const *op, uint8_t const *code, uint16_t loc, uint32_t pc,
+                     uint8_t segId) {
+    int argOff = 1;
+
+    for (char const *fmt = op->operands; *fmt; fmt++) {
+        if (*fmt != '%') {
+            *s++ = *fmt;
+            continue;
+        }
+        int off              = *code == 0x85 ? 3 - argOff : argOff; /* mov dir,dir is src,dst */
+        uint8_t const *arg   = code + off;
+        fixup51_t const *fix = findFixup(loc + off);
+        uint16_t word        = arg[0] * 256 + arg[1];
+
+        switch (*++fmt) {
+        case 'i':
+            *s++ = '#';
+            s    = fix ? fixedOperand(s, fix) : s + strlen(intelHex(s, *arg, 2));
+            break;
+        case 'j':
+            *s++ = '#';
+            s    = fix ? fixedOperand(s, fix) : s + strlen(intelHex(s, word, 4));
+            break;
+        case 'd':
+            s = fix ? fixedOperand(s, fix) : direct(s, *arg);
+            break;
+        case 'b':
+            s = fix ? fixedOperand(s, fix) : bit(s, *arg);
+            break;
+        case 'l':
+            s = fix ? fixedOperand(s, fix) : codeAddr(s, segId, word);
+            break;
+        case 'a': /* the fixup may be recorded against the opcode */
+            if (!fix)
+                fix = findFixup(loc);
+            s = fix ? fixedOperand(s, fix)
+                    : codeAddr(s, segId, ((pc + 2) & 0xf800) | (*code >> 5) << 8 | *arg);
+            break;
+        case 'r':
+            s = fix ? fixedOperand(s, fix)
+                    : codeAddr(s, segId, (uint16_t)(pc + op->len + (int8_t)*arg));
+            break;
+        }
+        argOff += *fmt == 'j' || *fmt == 'l' ? 2 : 1;
+    }
+    *s = '\0';
+}
+
+void disasm51(uint8_t segId, uint32_t addr) {
+    uint16_t dataStart;
+
+    loadFixups();
+    getu8(); /* skip the segId and address again */
+    if (recType & 1)
+        getu24();
+    else
+        getu16();
+    dataStart = getRecPos();
+
+    while (!atEndRec()) {
+        uint8_t const *code = recPtr;
+        op51_t const *op    = &opTable[*code];
+        int len             = op->len;
+        uint16_t loc        = (uint16_t)(code - rec) - dataStart;
+        char operand[128];
+        char const *label;
+
+        if (recEndPtr - code < len) /* instruction split across records */
+            len = 1, op = NULL;
+        if ((label = findLabel(segId, (uint16_t)addr))) {
+            startCol(1);
+            add("%s:", label);
+        }
+        startCol(1);
+        add("%03X> %04X ", loc, addr);
+        addHexBytes(code, len);
+        if (!op)
+            addAt(22, "db      %s", intelHex(operand, *code, 2));
+        else {
+            operands(operand, op, code, loc, addr, segId);
+            addAt(22, "%-7s %s", op->mnemonic, operand);
+        }
+        for (int i = 0; i < len; i++)
+            getu8();
+        addr += len;
+    }
+}
@@ -0,0 +1,321 @@
+/****************************************************************************
+ *  disasm85.c is part of dumpomf                                           *
+ *  Copyright (C) 2022 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+/*
+ * --disasm support for OMF85
+ * CODE and ABS CONTENT records are disassembled using a static opcode table.
+ * The fixup records that follow a CONTENT record are read ahead into an index
+ * sorted by offset, which is then walked in step with the disassembly, so
+ * fixed up operands can be shown symbolically. Labels come from the PUBLICS
+ * and LOCALS records of the module; at the first CONTENT record to be
+ * disassembled the rest of the module is read ahead for them, so labels
+ * defined after the code are also shown.
+ */
+
+#include "omf.h"
+
+enum { FIX_SEG, FIX_EXT };
+
+typedef struct {
+    char const *mnemonic;
+    char const *reg; /* fixed register operand(s), any value follows */
+    uint8_t len;
+} op85_t;
+
+typedef struct {
+    uint16_t offset;
+    uint8_t hilo;
+    uint8_t kind;
+    uint16_t target; /* segId or external index */
+} fixup85_t;
+
+typedef struct {
+    uint8_t segId;
+    uint16_t offset;
+    char const *name;
+} label85_t;
+
+static op85_t const opTable[256] = {
+    /* 00 */ { "nop", "", 1 }, { "lxi", "b,", 3 }, { "stax", "b", 1 }, { "inx", "b", 1 },
+    /* 04 */ { "inr", "b", 1 }, { "dcr", "b", 1 }, { "mvi", "b,", 2 }, { "rlc", "", 1 },
+    /* 08 */ { "db", "08H", 1 }, { "dad", "b", 1 }, { "ldax", "b", 1 }, { "dcx", "b", 1 },
+    /* 0C */ { "inr", "c", 1 }, { "dcr", "c", 1 }, { "mvi", "c,", 2 }, { "rrc", "", 1 },
+    /* 10 */ { "db", "10H", 1 }, { "lxi", "d,", 3 }, { "stax", "d", 1 }, { "inx", "d", 1 },
+    /* 14 */ { "inr", "d", 1 }, { "dcr", "d", 1 }, { "mvi", "d,", 2 }, { "ral", "", 1 },
+    /* 18 */ { "db", "18H", 1 }, { "dad", "d", 1 }, { "ldax", "d", 1 }, { "dcx", "d", 1 },
+    /* 1C */ { "inr", "e", 1 }, { "dcr", "e", 1 }, { "mvi", "e,", 2 }, { "rar", "", 1 },
+    /* 20 */ { "rim", "", 1 }, { "lxi", "h,", 3 }, { "shld", "", 3 }, { "inx", "h", 1 },
+    /* 24 */ { "inr", "h", 1 }, { "dcr", "h", 1 }, { "mvi", "h,", 2 }, { "daa", "", 1 },
+    /* 28 */ { "db", "28H", 1 }, { "dad", "h", 1 }, { "lhld", "", 3 }, { "dcx", "h", 1 },
+    /* 2C */ { "inr", "l", 1 }, { "dcr", "l", 1 }, { "mvi", "l,", 2 }, { "cma", "", 1 },
+    /* 30 */ { "sim", "", 1 }, { "lxi", "sp,", 3 }, { "sta", "", 3 }, { "inx", "sp", 1 },
+    /* 34 */ { "inr", "m", 1 }, { "dcr", "m", 1 }, { "mvi", "m,", 2 }, { "stc", "", 1 },
+    /* 38 */ { "db", "38H", 1 }, { "dad", "sp", 1 }, { "lda", "", 3 }, { "dcx", "sp", 1 },
+    /* 3C */ { "inr", "a", 1 }, { "dcr", "a", 1 }, { "mvi", "a,", 2 }, { "cmc", "", 1 },
+    /* 40 */ { "mov", "b,b", 1 }, { "mov", "b,c", 1 }, { "mov", "b,d", 1 }, { "mov", "b,e", 1 },
+    /* 44 */ { "mov", "b,h", 1 }, { "mov", "b,l", 1 }, { "mov", "b,m", 1 }, { "mov", "b,a", 1 },
+    /* 48 */ { "mov", "c,b", 1 }, { "mov", "c,c", 1 }, { "mov", "c,d", 1 }, { "mov", "c,e", 1 },
+    /* 4C */ { "mov", "c,h", 1 }, { "mov", "c,l", 1 }, { "mov", "c,m", 1 }, { "mov", "c,a", 1 },
+    /* 50 */ { "mov", "d,b", 1 }, { "mov", "d,c", 1 }, { "mov", "d,d", 1 }, { "mov", "d,e", 1 },
+    /* 54 */ { "mov", "d,h", 1 }, { "mov", "d,l", 1 }, { "mov", "d,m", 1 }, { "mov", "d,a", 1 },
+    /* 58 */ { "mov", "e,b", 1 }, { "mov", "e,c", 1 }, { "mov", "e,d", 1 }, { "mov", "e,e", 1 },
+    /* 5C */ { "mov", "e,h", 1 }, { "mov", "e,l", 1 }, { "mov", "e,m", 1 }, { "mov", "e,a", 1 },
+    /* 60 */ { "mov", "h,b", 1 }, { "mov", "h,c", 1 }, { "mov", "h,d", 1 }, { "mov", "h,e", 1 },
+    /* 64 */ { "mov", "h,h", 1 }, { "mov", "h,l", 1 }, { "mov", "h,m", 1 }, { "mov", "h,a", 1 },
+    /* 68 */ { "mov", "l,b", 1 }, { "mov", "l,c", 1 }, { "mov", "l,d", 1 }, { "mov", "l,e", 1 },
+    /* 6C */ { "mov", "l,h", 1 }, { "mov", "l,l", 1 }, { "mov", "l,m", 1 }, { "mov", "l,a", 1 },
+    /* 70 */ { "mov", "m,b", 1 }, { "mov", "m,c", 1 }, { "mov", "m,d", 1 }, { "mov", "m,e", 1 },
+    /* 74 */ { "mov", "m,h", 1 }, { "mov", "m,l", 1 }, { "hlt", "", 1 }, { "mov", "m,a", 1 },
+    /* 78 */ { "mov", "a,b", 1 }, { "mov", "a,c", 1 }, { "mov", "a,d", 1 }, { "mov", "a,e", 1 },
+    /* 7C */ { "mov", "a,h", 1 }, { "mov", "a,l", 1 }, { "mov", "a,m", 1 }, { "mov", "a,a", 1 },
+    /* 80 */ { "add", "b", 1 }, { "add", "c", 1 }, { "add", "d", 1 }, { "add", "e", 1 },
+    /* 84 */ { "add", "h", 1 }, { "add", "l", 1 }, { "add", "m", 1 }, { "add", "a", 1 },
+    /* 88 */ { "adc", "b", 1 }, { "adc", "c", 1 }, { "adc", "d", 1 }, { "adc", "e", 1 },
+    /* 8C */ { "adc", "h", 1 }, { "adc", "l", 1 }, { "adc", "m", 1 }, { "adc", "a", 1 },
+    /* 90 */ { "sub", "b", 1 }, { "sub", "c", 1 }, { "sub", "d", 1 }, { "sub", "e", 1 },
+    /* 94 */ { "sub", "h", 1 }, { "sub", "l", 1 }, { "sub", "m", 1 }, { "sub", "a", 1 },
+    /* 98 */ { "sbb", "b", 1 }, { "sbb", "c", 1 }, { "sbb", "d", 1 }, { "sbb", "e", 1 },
+    /* 9C */ { "sbb", "h", 1 }, { "sbb", "l", 1 }, { "sbb", "m", 1 }, { "sbb", "a", 1 },
+    /* A0 */ { "ana", "b", 1 }, { "ana", "c", 1 }, { "ana", "d", 1 }, { "ana", "e", 1 },
+    /* A4 */ { "ana", "h", 1 }, { "ana", "l", 1 }, { "ana", "m", 1 }, { "ana", "a", 1 },
+    /* A8 */ { "xra", "b", 1 }, { "xra", "c", 1 }, { "xra", "d", 1 }, { "xra", "e", 1 },
+    /* AC */ { "xra", "h", 1 }, { "xra", "l", 1 }, { "xra", "m", 1 }, { "xra", "a", 1 },
+    /* B0 */ { "ora", "b", 1 }, { "ora", "c", 1 }, { "ora", "d", 1 }, { "ora", "e", 1 },
+    /* B4 */ { "ora", "h", 1 }, { "ora", "l", 1 }, { "ora", "m", 1 }, { "ora", "a", 1 },
+    /* B8 */ { "cmp", "b", 1 }, { "cmp", "c", 1 }, { "cmp", "d", 1 }, { "cmp", "e", 1 },
+    /* BC */ { "cmp", "h", 1 }, { "cmp", "l", 1 }, { "cmp", "m", 1 }, { "cmp", "a", 1 },
+    /* C0 */ { "rnz", "", 1 }, { "pop", "b", 1 }, { "jnz", "", 3 }, { "jmp", "", 3 },
+    /* C4 */ { "cnz", "", 3 }, { "push", "b", 1 }, { "adi", "", 2 }, { "rst", "0", 1 },
+    /* C8 */ { "rz", "", 1 }, { "ret", "", 1 }, { "jz", "", 3 }, { "db", "0CBH", 1 },
+    /* CC */ { "cz", "", 3 }, { "call", "", 3 }, { "aci", "", 2 }, { "rst", "1", 1 },
+    /* D0 */ { "rnc", "", 1 }, { "pop", "d", 1 }, { "jnc", "", 3 }, { "out", "", 2 },
+    /* D4 */ { "cnc", "", 3 }, { "push", "d", 1 }, { "sui", "", 2 }, { "rst", "2", 1 },
+    /* D8 */ { "rc", "", 1 }, { "db", "0D9H", 1 }, { "jc", "", 3 }, { "in", "", 2 },
+    /* DC */ { "cc", "", 3 }, { "db", "0DDH", 1 }, { "sbi", "", 2 }, { "rst", "3", 1 },
+    /* E0 */ { "rpo", "", 1 }, { "pop", "h", 1 }, { "jpo", "", 3 }, { "xthl", "", 1 },
+    /* E4 */ { "cpo", "", 3 }, { "push", "h", 1 }, { "ani", "", 2 }, { "rst", "4", 1 },
+    /* E8 */ { "rpe", "", 1 }, { "pchl", "", 1 }, { "jpe", "", 3 }, { "xchg", "", 1 },
+    /* EC */ { "cpe", "", 3 }, { "db", "0EDH", 1 }, { "xri", "", 2 }, { "rst", "5", 1 },
+    /* F0 */ { "rp", "", 1 }, { "pop", "psw", 1 }, { "jp", "", 3 }, { "di", "", 1 },
+    /* F4 */ { "cp", "", 3 }, { "push", "psw", 1 }, { "ori", "", 2 }, { "rst", "6", 1 },
+    /* F8 */ { "rm", "", 1 }, { "sphl", "", 1 }, { "jm", "", 3 }, { "ei", "", 1 },
+    /* FC */ { "cm", "", 3 }, { "db", "0FDH", 1 }, { "cpi", "", 2 }, { "rst", "7", 1 },
+};
+
+static fixup85_t *fixups;
+static int fixupCnt;
+static int fixupSize;
+
+static label85_t *labels;
+static int labelCnt;
+static int labelSize;
+static bool labelsSorted;
+static bool labelsLoaded; /* the rest of the module has been read ahead for labels */
+
+static void *growTable(void *table, int *size, size_t itemSize) {
+    *size = *size ? *size * 2 : 256;
+    return xrealloc(table, *size * itemSize);
+}
+
+/* called from init85, label names are in the per module name space */
+void resetLabels85() {
+    labelCnt     = 0;
+    labelsLoaded = false;
+}
+
+void addLabel85(uint8_t segId, uint16_t offset, char const *name) {
+    if (labelsLoaded) /* already added by loadLabels */
+        return;
+    if (labelCnt >= labelSize)
+        labels = growTable(labels, &labelSize, sizeof(label85_t));
+    labels[labelCnt++] = (label85_t){ segId, offset, name };
+    labelsSorted       = false;
+}
+
+static int cmpLabel(void const *a, void const *b) {
+    label85_t const *la = a;
+    label85_t const *lb = b;
+    if (la->segId != lb->segId)
+        return la->segId - lb->segId;
+    return la->offset - lb->offset;
+}
+
+/* returns the first label at segId:offset or NULL */
+static label85_t const *findLabel(uint8_t segId, uint16_t offset) {
+    int lo = 0;
+    int hi = labelCnt;
+
+    if (!labelsSorted && labelCnt) {
+        qsort(labels, labelCnt, sizeof(label85_t), cmpLabel);
+        labelsSorted = true;
+    }
+    while (lo < hi) { /* lower bound */
+        int mid = (lo + hi) / 2;
+        if (labels[mid].segId < segId || (labels[mid].segId == segId && labels[mid].offset < offset))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo < labelCnt && labels[lo].segId == segId && labels[lo].offset == offset ? &labels[lo]
+                                                                                    : NULL;
+}
+
+static void addFixup(uint16_t offset, uint8_t hilo, uint8_t kind, uint16_t target) {
+    if (fixupCnt >= fixupSize)
+        fixups = growTable(fixups, &fixupSize, sizeof(fixup85_t));
+    fixups[fixupCnt++] = (fixup85_t){ offset, hilo, kind, target };
+}
+
+static int cmpFixup(void const *a, void const *b) {
+    return ((fixup85_t const *)a)->offset - ((fixup85_t const *)b)->offset;
+}
+
+/*
+ * read ahead the EXTFIX, FIXUP and SEGFIX records that follow the current
+ * CONTENT record, then reload the CONTENT record. If a pipe can't be read
+ * ahead that far, the fixups beyond are only dumped as records
+ */
+static void loadFixups(uint8_t segId) {
+    uint8_t type;
+
+    fixupCnt = 0;
+    while (((type = peekNextRecType()) == 0x20 || type == 0x22 || type == 0x24) && canReadAhead(start) &&
+           loadRec() >= 0) {
+        uint8_t fixSeg = recType == 0x24 ? getu8() : segId;
+        uint8_t hilo   = getu8() & 3;
+        while (!atEndRec() && !malformed) {
+            if (recType == 0x20) {
+                uint16_t eIdx = getu16();
+                addFixup(getu16(), hilo, FIX_EXT, eIdx);
+            } else
+                addFixup(getu16(), hilo, FIX_SEG, fixSeg);
+        }
+    }
+    if (fixupCnt)
+        qsort(fixups, fixupCnt, sizeof(fixup85_t), cmpFixup);
+    seekInput(start);
+    loadRec();
+}
+
+/*
+ * read ahead the PUBLICS and LOCALS records up to the end of the module, then
+ * reload the CONTENT record. If a pipe can't be read ahead that far, the labels
+ * found are dropped and labels are again added as their records are dumped
+ */
+static void loadLabels() {
+    int oldCnt = labelCnt;
+    uint8_t type;
+
+    while ((type = peekNextRecType()) && type != 4 && type != 0xe && canReadAhead(start) &&
+           loadRec() >= 0) {
+        if (recType != 0x12 && recType != 0x16)
+            continue;
+        uint8_t segId = getu8();
+        while (!atEndRec() && !malformed) {
+            uint16_t offset  = getu16();
+            char const *name = getName();
+            getu8(); /* trailing 0 */
+            if (!malformed)
+                addLabel85(segId, offset, name);
+        }
+    }
+    if (type == 4 || type == 0xe || type == 0)
+        labelsLoaded = true;
+    else
+        labelCnt = oldCnt;
+    seekInput(start);
+    loadRec();
+}
+
+static void fixedOperand(char *s, fixup85_t const *fix, uint16_t val) {
+    char addend[8];
+    uint16_t value = fix->hilo == 2 ? val << 8 : val;
+
+    if (fix->hilo == 1)
+        s += sprintf(s, "LOW(");
+    else if (fix->hilo == 2)
+        s += sprintf(s, "HIGH(");
+    if (fix->kind == FIX_EXT)
+        s += sprintf(s, "%s", getIndexName(IEXT, fix->target));
+    else {
+        label85_t const *label = fix->hilo == 3 ? findLabel(fix->target, value) : NULL;
+        if (label) {
+            s += sprintf(s, "%s", label->name);
+            value = 0;
+        } else
+            s += sprintf(s, "%s", getIndexName(ISEG, fix->target));
+    }
+    if (value)
+        s += sprintf(s, "+%s", intelHex(addend, value, 2));
+    if (fix->hilo != 3)
+        strcpy(s, ")");
+}
+
+void disasm85(uint8_t segId, uint16_t addr) {
+    int fi = 0;
+
+    if (!labelsLoaded)
+        loadLabels();
+    loadFixups(segId);
+    getu8(); /* skip the segId and address again */
+    getu16();
+
+    while (!atEndRec()) {
+        uint8_t const *code = recPtr;
+        op85_t const *op    = &opTable[*code];
+        int len             = op->len;
+        char operand[80];
+
+        if (recEndPtr - code < len) /* instruction split across records */
+            len = 1, op = NULL;
+
+        for (label85_t const *label = findLabel(segId, addr);
+             label && label < labels + labelCnt && label->segId == segId && label->offset == addr;
+             label++) {
+            startCol(1);
+            add("%s:", label->name);
+        }
+        while (fi < fixupCnt && fixups[fi].offset <= addr)
+            fi++;
+        fixup85_t const *fix = len > 1 && fi < fixupCnt && fixups[fi].offset == addr + 1
+                                   ? &fixups[fi]
+                                   : NULL;
+
+        startCol(1);
+        add("%04X ", addr);
+        addHexBytes(code, len);
+        if (!op)
+            addAt(17, "db      %s", intelHex(operand, *code, 2));
+        else {
+            uint16_t val = len == 3 ? code[1] + code[2] * 256 : code[1];
+            if (len == 1)
+                *operand = '\0';
+            else if (fix)
+                fixedOperand(operand, fix, val);
+            else
+                intelHex(operand, val, len == 3 ? 4 : 2);
+            addAt(17, "%-7s %s%s", op->mnemonic, op->reg, operand);
+        }
+        for (int i = 0; i < len; i++)
+            getu8();
+        addr += len;
+    }
+}
@@ -0,0 +1,166 @@
+/****************************************************************************
+ *  fixups.c is part of dumpomf                                             *
+ *  Copyright (C) 2022 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+/*
+ * --fixups support for OMF86
+ * As FIXUPP records are decoded, each explicit fixup is added to a table for
+ * the module, with its location converted to segment:offset using the
+ * preceding data record and any THREAD frame and target resolved.
+ * At MODEND the table is sorted on segment:offset with an LSD radix sort and
+ * reported as a per segment summary followed by the fixups in address order.
+ * If -a offset is given, only fixups whose location includes it are listed.
+ * For LIDATA the location is the data record offset plus the offset in the
+ * record, i.e. iterated blocks are not expanded.
+ */
+
+#include "omf.h"
+
+typedef struct {
+    fixup86_t fix;
+    char const *locName;
+} entry_t;
+
+static entry_t *entries;
+static entry_t *sorted;
+static uint32_t entryCnt;
+static uint32_t entrySize;
+
+static uint32_t *segLens;
+static uint16_t segSize;
+
+void resetFixups86() {
+    entryCnt = 0;
+    if (segSize)
+        memset(segLens, 0, segSize * sizeof(uint32_t));
+}
+
+void setSegLen86(uint16_t seg, uint32_t len) {
+    if (!fixupsMode)
+        return;
+    if (seg >= segSize) {
+        uint16_t oldSize = segSize;
+        while (seg >= segSize)
+            segSize = segSize ? segSize * 2 : 64;
+        segLens = xrealloc(segLens, segSize * sizeof(uint32_t));
+        memset(segLens + oldSize, 0, (segSize - oldSize) * sizeof(uint32_t));
+    }
+    segLens[seg] = len;
+}
+
+void addFixup86(fixup86_t const *fix, char const *locName) {
+    if (entryCnt >= entrySize) {
+        entrySize = entrySize ? entrySize * 2 : 1024;
+        entries   = xrealloc(entries, entrySize * sizeof(entry_t));
+        sorted    = xrealloc(sorted, entrySize * sizeof(entry_t));
+    }
+    entries[entryCnt++] = (entry_t){ *fix, locName };
+}
+
+static uint64_t sortKey(entry_t const *e) {
+    return ((uint64_t)e->fix.seg << 32) | e->fix.offset;
+}
+
+/* stable LSD radix sort on segment:offset, a byte at a time, skipping bytes that are all the same */
+static entry_t *radixSort() {
+    entry_t *from = entries;
+    entry_t *to   = sorted;
+    uint32_t count[256];
+
+    for (int shift = 0; shift < 48; shift += 8) {
+        memset(count, 0, sizeof(count));
+        for (uint32_t i = 0; i < entryCnt; i++)
+            count[(sortKey(&from[i]) >> shift) & 0xff]++;
+        if (count[(sortKey(&from[0]) >> shift) & 0xff] == entryCnt)
+            continue;
+        for (uint32_t i = 0, total = 0; i < 256; i++) {
+            uint32_t n = count[i];
+            count[i]   = total;
+            total += n;
+        }
+        for (uint32_t i = 0; i < entryCnt; i++)
+            to[count[(sortKey(&from[i]) >> shift) & 0xff]++] = from[i];
+        entry_t *tmp = from;
+        from         = to;
+        to           = tmp;
+    }
+    return from;
+}
+
+static uint8_t locSize(uint8_t loc) {
+    static uint8_t const sizes[16] = { 1, 2, 2, 4, 1, 2, 6, 1, 1, 4, 1, 6, 1, 4, 1, 1 };
+    return sizes[loc & 0xf];
+}
+
+static bool touches(fixup86_t const *fix) {
+    return fixupAddr < 0 ||
+           (fix->offset <= (uint32_t)fixupAddr && (uint32_t)fixupAddr < fix->offset + locSize(fix->loc));
+}
+
+void fixupReport86() {
+    static ofield_t const summary[] = {
+        { 0, "Segment" }, { 40, "Len" }, { 50, "Fixups" }, { 60, "Per KB" }, { 0, NULL }
+    };
+    static ofield_t const detail[] = { { 0, "Location" }, { 40, "Mode" },  { 46, "Type" },
+                                       { 58, "Frame" },   { 75, "Target(,displacement)" },
+                                       { 0, NULL } };
+    if (entryCnt == 0)
+        return;
+    entry_t *list = radixSort();
+
+    startCol(1);
+    add("Fixup summary");
+    oaddHeader(1, summary);
+    for (uint32_t i = 0, n; i < entryCnt; i += n) {
+        uint16_t seg = list[i].fix.seg;
+        for (n = 1; i + n < entryCnt && list[i + n].fix.seg == seg; n++)
+            ;
+        uint32_t len = seg < segSize ? segLens[seg] : 0;
+        startCol(1);
+        add("%s", seg ? getIndexName(ISEG, seg) : "Absolute");
+        addAt(40, "%04X", len);
+        addAt(50, "%u", n);
+        if (len)
+            addAt(60, "%.1f", n * 1024.0 / len);
+    }
+
+    startCol(1);
+    if (fixupAddr >= 0)
+        add("Fixups at offset %04lX", fixupAddr);
+    else
+        add("Fixups by location");
+    oaddHeader(1, detail);
+    for (uint32_t i = 0; i < entryCnt; i++) {
+        fixup86_t const *fix = &list[i].fix;
+        if (!touches(fix))
+            continue;
+        startCol(1);
+        add("%s:%04X", fix->seg ? getIndexName(ISEG, fix->seg) : "Absolute", fix->offset);
+        addAt(40, "%s", fix->self ? "Self" : "Seg");
+        addAt(46, "%s", list[i].locName);
+        addAt(58, "");
+        addFrame86(&fix->frame);
+        addAt(75, "");
+        addTarget86(&fix->target);
+        if (fix->hasDisp)
+            add(",%04X", fix->disp);
+    }
+    displayLine();
+}
@@ -0,0 +1,473 @@
+/****************************************************************************
+ *  image.c is part of dumpomf                                              *
+ *  Copyright (C) 2022 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+/*
+ * --image support for OMF86
+ * The data records are expanded into a sparse memory image per segment.
+ * L/R records with a segment index go to that segment's image, P records
+ * and R records with an explicit frame go to a per module absolute image.
+ * Iterated data is expanded without recursion; each block is expanded once
+ * and then repeated by doubling bulk copies. Writes beyond the end of a
+ * segment are discarded, so the work done is bounded by the record size
+ * and the segment sizes, however deep the nesting or large the repeat counts.
+ * The total image size is also capped, as a 32 bit segment can be 4GB.
+ */
+
+#include "omf.h"
+
+#define PAGESHIFT 12
+#define PAGESIZE  (1 << PAGESHIFT)
+#define PAGEMASK  (PAGESIZE - 1)
+#define ABSLIMIT  0x110000  /* highest 8086 physical address + 1, with wrap room */
+#define MAXLIMIT  0x100000000ULL
+#define MAXPAGES  16384     /* limit of 64MB of image data, 128MB including the set maps */
+#define FILLBYTE  0xff      /* unset bytes in binary output, as an unprogrammed EPROM */
+
+typedef struct {
+    uint8_t data[PAGESIZE];
+    uint8_t set[PAGESIZE]; /* non zero if the byte has been written */
+} page_t;
+
+typedef struct {
+    char *module;
+    char *name;
+    uint64_t limit; /* segment length */
+    uint64_t high;  /* highest address stored + 1 */
+    bool overflow;  /* data was discarded beyond the segment end */
+    bool truncated; /* data was discarded as MAXPAGES was reached */
+    page_t **pages;
+    uint32_t pageCnt;
+} image_t;
+
+typedef struct {
+    uint32_t blocksLeft;
+    uint32_t repeat;
+    uint64_t start;
+    bool write; /* false if this or an enclosing block has a 0 repeat count */
+} iframe_t;
+
+static image_t *images;
+static int imageCnt;
+static int imageSize;
+static int moduleCnt;
+static int pagesUsed;
+
+static int *segImage; /* image for each segment index of the current module */
+static int segImageSize;
+static int absImage;  /* absolute image of the current module, -1 if none */
+static char *curModule;
+static int lnameIdx;
+static int segIdx;
+
+static int newImage(char const *name, uint64_t limit) {
+    if (imageCnt >= imageSize) {
+        imageSize = imageSize ? imageSize * 2 : 32;
+        images    = xrealloc(images, imageSize * sizeof(image_t));
+    }
+    images[imageCnt] = (image_t){ curModule, xstrdup(name), limit, 0, false, false, NULL, 0 };
+    return imageCnt++;
+}
+
+/* returns NULL if the page would exceed MAXPAGES */
+static page_t *getPage(image_t *img, uint64_t addr) {
+    uint32_t pageNo = (uint32_t)(addr >> PAGESHIFT);
+    if (pageNo >= img->pageCnt) {
+        uint32_t newCnt = img->pageCnt ? img->pageCnt : 16;
+        while (newCnt <= pageNo)
+            newCnt *= 2;
+        img->pages = xrealloc(img->pages, newCnt * sizeof(page_t *));
+        memset(img->pages + img->pageCnt, 0, (newCnt - img->pageCnt) * sizeof(page_t *));
+        img->pageCnt = newCnt;
+    }
+    if (!img->pages[pageNo]) {
+        if (pagesUsed >= MAXPAGES) {
+            img->truncated = true;
+            return NULL;
+        }
+        img->pages[pageNo] = xcalloc(1, sizeof(page_t));
+        pagesUsed++;
+    }
+    return img->pages[pageNo];
+}
+
+/* trims len so that [addr, addr + len) is within the segment */
+static uint64_t clip(image_t *img, uint64_t addr, uint64_t len) {
+    if (addr + len > img->limit) {
+        img->overflow = true;
+        len           = addr >= img->limit ? 0 : img->limit - addr;
+    }
+    return len;
+}
+
+static void putBytes(image_t *img, uint64_t addr, uint8_t const *bytes, uint64_t len) {
+    len = clip(img, addr, len);
+    while (len) {
+        page_t *page   = getPage(img, addr);
+        uint32_t off   = addr & PAGEMASK;
+        uint32_t chunk = len < PAGESIZE - off ? (uint32_t)len : PAGESIZE - off;
+        if (page) {
+            memcpy(page->data + off, bytes, chunk);
+            memset(page->set + off, 1, chunk);
+            if (addr + chunk > img->high)
+                img->high = addr + chunk;
+        }
+        bytes += chunk;
+        addr += chunk;
+        len -= chunk;
+    }
+}
+
+/* copy within the image, the ranges must not overlap */
+static void copyBytes(image_t *img, uint64_t to, uint64_t from, uint64_t len) {
+    len = clip(img, to, len);
+    while (len) {
+        uint32_t fromOff = from & PAGEMASK;
+        uint32_t toOff   = to & PAGEMASK;
+        uint64_t chunk   = PAGESIZE - (fromOff > toOff ? fromOff : toOff);
+        if (chunk > len)
+            chunk = len;
+        uint32_t fromPage = (uint32_t)(from >> PAGESHIFT);
+        if (fromPage < img->pageCnt && img->pages[fromPage]) {
+            page_t *src = img->pages[fromPage];
+            page_t *dst = getPage(img, to);
+            if (dst) {
+                memcpy(dst->data + toOff, src->data + fromOff, chunk);
+                memcpy(dst->set + toOff, src->set + fromOff, chunk);
+                if (to + chunk > img->high)
+                    img->high = to + chunk;
+            }
+        }
+        from += chunk;
+        to += chunk;
+        len -= chunk;
+    }
+}
+
+/*
+ * the block of size bytes at start has been written once, repeat it to give
+ * repeat copies in total, returns the address following the last copy
+ */
+static uint64_t repeatBlock(image_t *img, uint64_t start, uint64_t size, uint32_t repeat) {
+    if (size == 0 || repeat == 0)
+        return start;
+    uint64_t total = repeat > (MAXLIMIT - start) / size ? MAXLIMIT - start : size * repeat;
+    uint64_t avail = start >= img->limit ? 0 : img->limit - start;
+    uint64_t done  = size;
+    uint64_t todo  = total < avail ? total : avail;
+
+    if (total > avail)
+        img->overflow = true;
+    while (done < todo) {
+        uint64_t chunk = done < todo - done ? done : todo - done;
+        copyBytes(img, start + done, start, chunk);
+        done += chunk;
+    }
+    return start + total;
+}
+
+/* expand the iterated data at the current record position */
+static void expandIData(image_t *img, uint64_t addr, bool is32) {
+    static iframe_t *stack;
+    static int stackSize;
+    int sp = 0;
+
+    if (!stackSize)
+        stack = xrealloc(NULL, (stackSize = 64) * sizeof(iframe_t));
+    stack[0] = (iframe_t){ UINT32_MAX, 1, addr, true }; /* the record level */
+
+    while (!malformed) {
+        iframe_t *frame = &stack[sp];
+        if (frame->blocksLeft == 0 || (sp == 0 && atEndRec())) {
+            if (sp-- == 0)
+                break;
+            addr = repeatBlock(img, frame->start, addr - frame->start, frame->repeat);
+            stack[sp].blocksLeft--;
+            continue;
+        }
+        uint32_t repeat   = is32 ? getu32() : getu16();
+        uint16_t blockCnt = getu16();
+        bool write        = frame->write && repeat != 0;
+        if (blockCnt) {
+            if (++sp == stackSize)
+                stack = xrealloc(stack, (stackSize *= 2) * sizeof(iframe_t));
+            stack[sp] = (iframe_t){ blockCnt, repeat, addr, write };
+        } else {
+            uint8_t len = getu8();
+            uint8_t const *data = recPtr;
+            for (int i = 0; i < len; i++) /* validates the length */
+                getu8();
+            if (malformed)
+                break;
+            if (write) {
+                putBytes(img, addr, data, len);
+                addr = repeatBlock(img, addr, len, repeat);
+            }
+            frame->blocksLeft--;
+        }
+    }
+}
+
+static void enumData(image_t *img, uint64_t addr) {
+    if (!atEndRec())
+        putBytes(img, addr, recPtr, recEndPtr - recPtr);
+}
+
+static image_t *segmentImage(uint16_t idx) {
+    if (idx < segImageSize && segImage[idx] >= 0)
+        return &images[segImage[idx]];
+    return NULL;
+}
+
+static image_t *absoluteImage() {
+    if (absImage < 0)
+        absImage = newImage("Absolute", ABSLIMIT);
+    return &images[absImage];
+}
+
+static void startModule(char const *name) {
+    curModule = xstrdup(name);
+    for (int i = 0; i < segImageSize; i++)
+        segImage[i] = -1;
+    absImage  = -1;
+    lnameIdx  = 1;
+    segIdx    = 1;
+    moduleCnt++;
+}
+
+static void segDef() {
+    uint8_t segAttr = getu8();
+    uint8_t a       = segAttr >> 5;
+    uint8_t c       = (segAttr >> 2) & 7;
+    char name[MAXNAME * 2 + 2] = "*Unnamed*";
+
+    if (omfFlavour == ANY && (a == 6 || c == 1 || c == 3))
+        omfFlavour = INTEL;
+    if (a == 0 || (a == 5 && omfFlavour == INTEL))
+        getu24();
+    else if (a == 6)
+        getu8(), getu32();
+    uint64_t segLen = recType & 1 ? getu32() : getu16();
+    if (segAttr & 2)
+        segLen = recType & 1 ? MAXLIMIT : 0x10000;
+    if (a != 5 || omfFlavour != INTEL) {
+        char const *segName = getIndexName(INAME, getIndex());
+        char const *clsName = getIndexName(INAME, getIndex());
+        if (*segName)
+            sprintf(name, *clsName ? "%s:%s" : "%s", segName, clsName);
+    }
+    if (malformed)
+        return;
+    if (segIdx >= segImageSize) {
+        int oldSize  = segImageSize;
+        segImageSize = segImageSize ? segImageSize * 2 : 64;
+        segImage     = xrealloc(segImage, segImageSize * sizeof(int));
+        for (int i = oldSize; i < segImageSize; i++)
+            segImage[i] = -1;
+    }
+    segImage[segIdx++] = newImage(name, segLen);
+}
+
+/*
+ * REDATA / RIDATA base, NULL if the segment is not known
+ * the frame number is present whenever the segment index is 0, including
+ * for a group base, as that is the only way the group's frame is known
+ */
+static image_t *base(uint64_t *addr) {
+    getIndex(); /* group */
+    uint16_t idx = getIndex();
+    if (idx) {
+        *addr = getu16();
+        return segmentImage(idx);
+    }
+    *addr = getu16() * 16;
+    *addr += getu16();
+    return absoluteImage();
+}
+
+static void imageRecord() {
+    image_t *img;
+    uint64_t addr;
+
+    resolveFlavour();
+    switch (recType) {
+    case 0x6e: // RHEADR
+    case 0x80: // THEADR
+    case 0x82: // LHEADR
+        dispatchTable[OMF86].init();
+        startModule(getName());
+        break;
+    case 0x96: // LNAMES
+    case 0xca: // LLNAMES
+        while (!atEndRec() && !malformed)
+            setIndex(INAME, lnameIdx++, getName());
+        break;
+    case 0x98: // SEGDEF
+    case 0x99:
+        segDef();
+        break;
+    case 0xa0: // LEDATA
+    case 0xa1:
+    case 0xa2: // LIDATA
+    case 0xa3:
+        img  = segmentImage(getIndex());
+        addr = recType & 1 ? getu32() : getu16();
+        if (img && !malformed) {
+            if (recType & 2)
+                expandIData(img, addr, recType & 1);
+            else
+                enumData(img, addr);
+        }
+        break;
+    case 0x72: // REDATA
+    case 0x74: // RIDATA
+        img = base(&addr);
+        if (img && !malformed) {
+            if (recType == 0x74)
+                expandIData(img, addr, false);
+            else
+                enumData(img, addr);
+        }
+        break;
+    case 0x84: // PEDATA
+    case 0x86: // PIDATA
+        addr = getu16() * 16;
+        addr += getu8();
+        if (!malformed) {
+            if (recType == 0x86)
+                expandIData(absoluteImage(), addr, false);
+            else
+                enumData(absoluteImage(), addr);
+        }
+        break;
+    }
+}
+
+static bool isSet(image_t *img, uint64_t addr, uint8_t *c) {
+    uint32_t pageNo = (uint32_t)(addr >> PAGESHIFT);
+    page_t *page    = pageNo < img->pageCnt ? img->pages[pageNo] : NULL;
+    if (!page || !page->set[addr & PAGEMASK])
+        return false;
+    *c = page->data[addr & PAGEMASK];
+    return true;
+}
+
+/* rows with no data set are omitted */
+static void hexImage(image_t *img) {
+    fprintf(dst, "\n%s%s%s length %0*llX\n", moduleCnt > 1 ? img->module : "",
+            moduleCnt > 1 ? "." : "", img->name, img->limit > 0x10000 ? 6 : 4,
+            (unsigned long long)img->limit);
+    if (img->overflow)
+        fprintf(dst, "-- Warning data beyond end of segment discarded --\n");
+    if (img->truncated)
+        fprintf(dst, "-- Warning image size limit reached, data discarded --\n");
+    for (uint64_t row = 0; row < img->high; row += 16) {
+        uint32_t pageNo = (uint32_t)(row >> PAGESHIFT);
+        if (pageNo >= img->pageCnt || !img->pages[pageNo]) {
+            row = ((uint64_t)pageNo << PAGESHIFT) + PAGESIZE - 16;
+            continue;
+        }
+        char hex[16 * 3 + 2];
+        char ascii[17];
+        bool any = false;
+        for (int i = 0; i < 16; i++) {
+            uint8_t c;
+            char *s = hex + i * 3 + (i >= 8);
+            if (i == 8)
+                s[-1] = ' ';
+            if (isSet(img, row + i, &c)) {
+                sprintf(s, " %02X", c);
+                ascii[i] = ' ' <= c && c <= '~' ? c : '.';
+                any      = true;
+            } else {
+                strcpy(s, " --");
+                ascii[i] = ' ';
+            }
+        }
+        ascii[16] = '\0';
+        if (any)
+            fprintf(dst, "%0*llX %s  |%s|\n", img->limit > 0x10000 ? 6 : 4,
+                    (unsigned long long)row, hex, ascii);
+    }
+}
+
+/* binary is written up to the highest address set, unset bytes are FILLBYTE */
+static void binImage(image_t *img, char const *prefix) {
+    char *fname = xrealloc(NULL, strlen(prefix) + strlen(img->module) + strlen(img->name) + 8);
+    char *s;
+    FILE *fp;
+
+    if (moduleCnt > 1)
+        sprintf(fname, "%s.%s.%s.bin", prefix, img->module, img->name);
+    else
+        sprintf(fname, "%s.%s.bin", prefix, img->name);
+    for (s = fname + strlen(prefix) + 1; *s; s++) /* keep the names file system safe */
+        if (!isalnum(*s) && *s != '.' && *s != '_' && *s != '$' && *s != '@' && *s != '?')
+            *s = '_';
+
+    if ((fp = fopen(fname, "wb")) == NULL)
+        fprintf(stderr, "%s: can't create\n", fname);
+    else {
+        uint8_t fill[PAGESIZE];
+        memset(fill, FILLBYTE, sizeof(fill));
+        for (uint64_t addr = 0; addr < img->high; addr += PAGESIZE) {
+            uint32_t pageNo = (uint32_t)(addr >> PAGESHIFT);
+            size_t len = img->high - addr < PAGESIZE ? (size_t)(img->high - addr) : PAGESIZE;
+            page_t *page = pageNo < img->pageCnt ? img->pages[pageNo] : NULL;
+            if (page) {
+                uint8_t buf[PAGESIZE];
+                for (size_t i = 0; i < len; i++)
+                    buf[i] = page->set[i] ? page->data[i] : FILLBYTE;
+                fwrite(buf, 1, len, fp);
+            } else
+                fwrite(fill, 1, len, fp);
+        }
+        if (fclose(fp) != 0)
+            fprintf(stderr, "%s: error writing\n", fname);
+        if (img->overflow)
+            fprintf(stderr, "%s: data beyond end of segment discarded\n", fname);
+        if (img->truncated)
+            fprintf(stderr, "%s: image size limit reached, data discarded\n", fname);
+    }
+    free(fname);
+}
+
+/* binPrefix NULL for hex output to dst */
+void imageFile(int spec, char const *binPrefix) {
+    int status;
+    if (spec != OMF86) {
+        fprintf(stderr, "--image is only supported for OMF86 files\n");
+        return;
+    }
+    curModule = xstrdup("");
+    absImage  = -1;
+    lnameIdx  = segIdx = 1;
+    dispatchTable[OMF86].init();
+    while ((status = getrec()) >= 0)
+        imageRecord();
+
+    for (int i = 0; i < imageCnt; i++)
+        if (images[i].high) {
+            if (binPrefix)
+                binImage(&images[i], binPrefix);
+            else
+                hexImage(&images[i]);
+        }
+}
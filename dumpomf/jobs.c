@@ -0,0 +1,168 @@
+/****************************************************************************
+ *  jobs.c is part of dumpomf                                               *
+ *  Copyright (C) 2022 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+
+/*
+ * support shared by --batch and --split
+ * Each file or module is dumped by a job. The decoders keep their state in
+ * globals, so rather than threads each job runs in its own forked worker
+ * process, with up to -j workers running at once. A crash on a badly corrupt
+ * input only loses that job. Where fork is not available the jobs run in turn.
+ * Manifests, used to skip unchanged inputs on a rerun, are text files of one
+ * entry per line; the callers parse and format the entries, the reading,
+ * writing and safe replacement of the file is done here.
+ */
+
+#include "omf.h"
+#include <errno.h>
+#ifndef _MSC_VER
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+char *joinPath(char const *dir, char const *name) {
+    size_t len = strlen(dir);
+    char *path = xrealloc(NULL, len + strlen(name) + 2);
+    strcpy(path, dir);
+    if (len && dir[len - 1] != '/' && dir[len - 1] != '\\')
+        path[len++] = '/';
+    strcpy(path + len, name);
+    return path;
+}
+
+bool hasSuffix(char const *s, char const *suffix) {
+    size_t len    = strlen(s);
+    size_t sufLen = strlen(suffix);
+    return len >= sufLen && strcmp(s + len - sufLen, suffix) == 0;
+}
+
+/* calls addEntry for each line of the manifest that isn't a comment, a missing manifest is empty */
+void readManifest(char const *manifest, void (*addEntry)(char const *line)) {
+    FILE *fp;
+    char line[4096];
+
+    if ((fp = fopen(manifest, "r")) == NULL)
+        return;
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (*line != '#')
+            addEntry(line);
+    }
+    fclose(fp);
+}
+
+/* the entries are written to manifest.tmp, which then replaces the manifest */
+void writeManifest(char const *manifest, char const *tag, void (*putEntries)(FILE *fp)) {
+    FILE *fp;
+    char *tmpName = xrealloc(NULL, strlen(manifest) + 5);
+
+    strcat(strcpy(tmpName, manifest), ".tmp");
+    if ((fp = fopen(tmpName, "w")) == NULL)
+        fprintf(stderr, "%s: can't create manifest\n", manifest);
+    else {
+        fprintf(fp, "%s\n", tag);
+        putEntries(fp);
+        if (fclose(fp) == 0) {
+            remove(manifest); /* rename won't replace on Windows */
+            if (rename(tmpName, manifest) != 0)
+                fprintf(stderr, "%s: can't update manifest\n", manifest);
+        } else
+            fprintf(stderr, "%s: error writing manifest\n", manifest);
+    }
+    free(tmpName);
+}
+
+static int defaultWorkers() {
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#else
+    return 1;
+#endif
+}
+
+/*
+ * runs each pending job on up to workers processes, 0 is one per cpu.
+ * A worker's exit code is the job status, one that exits with crashed or
+ * more, or is killed, has status crashed
+ */
+void runJobs(jobs_t const *jobs, int workers) {
+    if (workers <= 0)
+        workers = defaultWorkers();
+#ifdef _MSC_VER
+    for (int i = 0; i < jobs->cnt; i++)
+        if (jobs->pending(i))
+            jobs->finish(i, jobs->run(i));
+    if (jobs->progress)
+        jobs->progress();
+#else
+    pid_t *pids  = xrealloc(NULL, workers * sizeof(pid_t));
+    int *slotJob = xrealloc(NULL, workers * sizeof(int));
+    int running  = 0;
+    int next     = 0;
+
+    while (next < jobs->cnt || running) {
+        while (running < workers && next < jobs->cnt) {
+            if (!jobs->pending(next)) {
+                next++;
+                continue;
+            }
+            fflush(NULL); /* don't let the worker inherit pending output */
+            pid_t pid = fork();
+            if (pid == 0)
+                exit(jobs->run(next));
+            if (pid < 0)
+                jobs->finish(next, jobs->run(next));
+            else {
+                pids[running]      = pid;
+                slotJob[running++] = next;
+            }
+            next++;
+        }
+        if (running) {
+            int wstatus;
+            pid_t pid = wait(&wstatus);
+            int slot;
+            if (pid < 0) {
+                if (errno == EINTR)
+                    continue;
+                /* ECHILD, none of the workers can be reaped so treat them as failed */
+                while (running)
+                    jobs->finish(slotJob[--running], jobs->crashed);
+                continue;
+            }
+            for (slot = 0; slot < running && pids[slot] != pid; slot++)
+                ;
+            if (slot == running) /* not one of ours */
+                continue;
+            jobs->finish(slotJob[slot], WIFEXITED(wstatus) && WEXITSTATUS(wstatus) < jobs->crashed
+                                            ? WEXITSTATUS(wstatus)
+                                            : jobs->crashed);
+            pids[slot]    = pids[--running];
+            slotJob[slot] = slotJob[running];
+        }
+        if (jobs->progress)
+            jobs->progress();
+    }
+    free(pids);
+    free(slotJob);
+#endif
+}
@@ -44,6 +44,9 @@ bool malformed;
 int detectOMF();
 enum flavour_e omfFlavour = ANY;
 bool rawMode              = false;
+bool disasmMode           = false;
+bool fixupsMode           = false;
+long fixupAddr            = -1;
 
 
 FILE *src;
@@ -52,7 +55,14 @@ FILE *dst;
 _Noreturn void usage(char const *s) {
     if (s && *s)
         fputs(s, stderr);
-    fprintf(stderr, "usage: %s -v | -V | [-r] objfile [outputfile]\n", invoke);
+    fprintf(stderr,
+            "usage: %s -v | -V | [-T] [-r | --disasm] [--fixups [-a offset]] objfile [outputfile]\n"
+            "       %s --stats objfile...\n"
+            "       %s --image [-b binprefix] objfile [outputfile]\n"
+            "       %s --batch [-r] [-j n] [-m manifest] [-o combinedfile] (dir | objfile | @filelist)...\n"
+            "       %s [-r | --disasm] [--fixups] [-j n] --split dir libfile\n"
+            "       %s [-x indexfile] (--where symbol | --unresolved) libfile\n",
+            invoke, invoke, invoke, invoke, invoke, invoke);
     exit(1);
 }
 
@@ -84,37 +94,48 @@ decodeSpec_t omfUknDecode[] = {
 void initUkn() {
 }
 
-void displayFile(int spec) {
+/* see if we can resolve flavour of OMF86 from the current record type */
+void resolveFlavour() {
+    if (omfFlavour == ANY) {
+        if (recType < 0x80 || recType == 0x84 || recType == 0x86)
+            omfFlavour = INTEL;
+        else if (recType > 0xaa || is32bit)
+            omfFlavour = MS;
+    }
+}
+
+decodeSpec_t const *lookupDecode(int spec, int type) {
     omfDispatch_t *dispatch = &dispatchTable[spec];
-    int status;
 
-    dispatch->init();
+    int idx = dispatch->low <= type && type <= dispatch->high ? (type - dispatch->low) / 2 + 1 : 0;
+    if (!dispatch->decodeTable[idx].name || !isValidRec(spec, type))
+        idx = 0;
+    return &dispatch->decodeTable[idx];
+}
 
-    while ((status = getrec()) >= 0) {
+/* display the records before file position end, or to the end of file if end < 0 */
+void displayRecords(int spec, long end) {
+    int status = Ok;
+
+    while ((end < 0 || tellInput() < end) && (status = getrec()) >= 0) {
         startCol(0);
         if (status == BadCRC)
             Log("-- Warning CRC error --");
 
-        if (omfFlavour == ANY) { // see if we can resolve flavour of OMF86
-            if (recType < 0x80 || recType == 0x84 || recType == 0x86)
-                omfFlavour = INTEL;
-            else if (recType > 0xaa || is32bit)
-                omfFlavour = MS;
-        }
-
-        int idx = dispatch->low <= recType && recType <= dispatch->high
-                      ? (recType - dispatch->low) / 2 + 1
-                      : 0;
-        if (!dispatch->decodeTable[idx].name || !isValidRec(spec))
-            idx = 0;
+        resolveFlavour();
+        decodeSpec_t const *decode = lookupDecode(spec, recType);
 
-        add("%s(%s): ", dispatch->decodeTable[idx].name, hexStr(recType));
+        add("%s(%s): ", decode->name, hexStr(recType));
         fixCol();
+        countRecord(recType, (uint16_t)(recEndPtr - rec + 1));
+        int phase = setPhase(PH_DECODE);
         if (rawMode)
             invalidRecord(recType);
         else
-            dispatch->decodeTable[idx].handler(recType);
+            decode->handler(recType);
+        setPhase(phase);
         if (malformed || !atEndRec()) {
+            countMalformed();
             if (malformed)
                 undoCol();
             else
@@ -127,34 +148,129 @@ void displayFile(int spec) {
             (spec == OMF85 || spec == OMF96)) // for OMF85/OMF96 type 0xe is EOF
             break;
     }
+    if (fixupsMode && spec == OMF86) /* no MODEND */
+        fixupReport86();
     if (status == Junk) {
         startCol(0);
         Log("Unexpected data at end of file\n");
     }
 }
 
+void displayFile(int spec) {
+    dispatchTable[spec].init();
+    displayRecords(spec, -1);
+}
+
 
 int main(int argc, char **argv) {
     int spec;
+    bool statsMode        = false;
+    bool batchMode        = false;
+    bool imageMode        = false;
+    char const *binPrefix = NULL;
+    int workers           = 0;
+    char const *combined  = NULL;
+    char const *manifest  = NULL;
+    char const *where     = NULL;
+    bool unresolved       = false;
+    char const *idxFile   = NULL;
+    char const *splitDir  = NULL;
 
     invoke = argv[0];
     CHK_SHOW_VERSION(argc, argv);
 
-    if (argc > 1 && strcmp(argv[1], "-r") == 0) {
+    while (argc > 1 && argv[1][0] == '-' && argv[1][1]) {
+        if (strcmp(argv[1], "-r") == 0)
+            rawMode = true;
+        else if (strcmp(argv[1], "-T") == 0)
+            timingMode = true;
+        else if (strcmp(argv[1], "--disasm") == 0)
+            disasmMode = true;
+        else if (strcmp(argv[1], "--fixups") == 0)
+            fixupsMode = true;
+        else if (strcmp(argv[1], "-a") == 0 && argc > 2)
+            fixupAddr = strtol(argv[2], NULL, 16), argc--, argv++;
+        else if (strcmp(argv[1], "--stats") == 0)
+            statsMode = true;
+        else if (strcmp(argv[1], "--image") == 0)
+            imageMode = true;
+        else if (strcmp(argv[1], "-b") == 0 && argc > 2)
+            binPrefix = argv[2], argc--, argv++;
+        else if (strcmp(argv[1], "--batch") == 0)
+            batchMode = true;
+        else if (strcmp(argv[1], "--split") == 0 && argc > 2)
+            splitDir = argv[2], argc--, argv++;
+        else if (strcmp(argv[1], "-j") == 0 && argc > 2 && (workers = atoi(argv[2])) > 0)
+            argc--, argv++;
+        else if (strcmp(argv[1], "-m") == 0 && argc > 2)
+            manifest = argv[2], argc--, argv++;
+        else if (strcmp(argv[1], "-o") == 0 && argc > 2)
+            combined = argv[2], argc--, argv++;
+        else if (strcmp(argv[1], "--where") == 0 && argc > 2)
+            where = argv[2], argc--, argv++;
+        else if (strcmp(argv[1], "--unresolved") == 0)
+            unresolved = true;
+        else if (strcmp(argv[1], "-x") == 0 && argc > 2)
+            idxFile = argv[2], argc--, argv++;
+        else
+            usage("unknown option\n");
         argc--, argv++;
-        rawMode = true;
     }
 
-    if (argc < 2 || (src = fopen(argv[1], "rb")) == NULL)
+    if (timingMode && (statsMode || batchMode || splitDir || where || unresolved))
+        usage("-T is not valid with --stats, --batch, --split, --where or --unresolved\n");
+    if (statsMode) {
+        if (argc < 2)
+            usage("no input files\n");
+        dst = stdout;
+        for (int i = 1; i < argc; i++)
+            statsFile(argv[i]);
+        return 0;
+    }
+    if (where || unresolved) {
+        if (argc != 2 || (where && unresolved))
+            usage("--where and --unresolved need a single library file and are exclusive\n");
+        return symbolQuery(argv[1], idxFile, where);
+    }
+    if (idxFile)
+        usage("-x is only valid with --where or --unresolved\n");
+    if (batchMode) {
+        if (argc < 2)
+            usage("no input files\n");
+        return batchDump(argc - 1, argv + 1, workers, combined,
+                         manifest ? manifest : "dumpomf.manifest");
+    }
+    if (combined || manifest)
+        usage("-o and -m are only valid with --batch\n");
+    if (splitDir) {
+        if (argc != 2)
+            usage("--split needs a single library file\n");
+        return splitDump(argv[1], splitDir, workers);
+    }
+    if (workers)
+        usage("-j is only valid with --batch or --split\n");
+    if (binPrefix && !imageMode)
+        usage("-b is only valid with --image\n");
+    if (fixupAddr >= 0 && !fixupsMode)
+        usage("-a is only valid with --fixups\n");
+
+    startTiming();
+    if (argc < 2 || openInput(argv[1]) == NULL)
         usage("can't open input file\n");
 
     if (argc != 3 || (dst = fopen(argv[2], "w")) == NULL)
         dst = stdout;
+    setOutputBuffer(dst);
 
     if ((spec = detectOMF()) == OMFUKN)
         fprintf(stderr, "%s cannot determine OMF spec\n", argv[1]);
-    displayFile(spec);
+    if (imageMode)
+        imageFile(spec, binPrefix);
+    else
+        displayFile(spec);
+    setPhase(PH_OUTPUT);
     fclose(dst);
     fclose(src);
+    timingReport(spec);
     return 0;
 }
@@ -23,7 +23,7 @@
 #include "omf.h"
 /* string storage */
 #define STRCHUNK   8192
-#define INDEXCHUNK 256
+#define INDEXCHUNK 256 /* initial size of an index table */
 
 typedef struct str {
     struct str *next;
@@ -31,19 +31,41 @@ typedef struct str {
     char buf[STRCHUNK];
 } str_t;
 
-typedef struct _index {
-    struct _index *next;
-    char const *names[INDEXCHUNK];
+/*
+ * index tables are directly indexed arrays, grown on demand
+ * an entry is only valid if its generation matches the current one
+ * so resetNames just bumps the generation rather than clearing the tables
+ */
+typedef struct {
+    char const *name;
+    uint32_t generation;
+} ientry_t;
+
+typedef struct {
+    uint32_t size;
+    ientry_t *names;
 } index_t;
 
 int extIndex;
 int segIndex;
 
-static index_t *itable[INDEXTABLES] = { 0 };
+static index_t itable[INDEXTABLES];
+static uint32_t generation = 1;
 static str_t strings;
+static str_t *curStr = &strings; /* chunk currently being filled */
+
+/* allocation wrappers shared by all the modules, running out of memory is fatal */
+void *xrealloc(void *old, size_t size) {
+    void *p = realloc(old, size);
+    if (!p) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(1);
+    }
+    return p;
+}
 
-static void *alloc(size_t size) {
-    void *p = malloc(size);
+void *xcalloc(size_t n, size_t size) {
+    void *p = calloc(n, size);
     if (!p) {
         fprintf(stderr, "Fatal: out of memory\n");
         exit(1);
@@ -51,36 +73,48 @@ static void *alloc(size_t size) {
     return p;
 }
 
+char *xstrdup(char const *s) {
+    return strcpy(xrealloc(NULL, strlen(s) + 1), s);
+}
+
 static char *allocStrSpace(size_t len) {
-    str_t *p;
-    for (p = &strings; len + p->pos > STRCHUNK; p = p->next)
-        if (!p->next) {
-            p->next       = alloc(sizeof(str_t));
-            p->next->next = NULL;
-            p->next->pos  = 0;
+    while (len + curStr->pos > STRCHUNK) {
+        if (!curStr->next) {
+            curStr->next       = xrealloc(NULL, sizeof(str_t));
+            curStr->next->next = NULL;
         }
-    char *s = p->buf + p->pos;
-    p->pos += len;
+        curStr      = curStr->next;
+        curStr->pos = 0; /* chunks after the first are recycled lazily */
+    }
+    char *s = curStr->buf + curStr->pos;
+    curStr->pos += len;
     return s;
 }
 
-static index_t *newIndexBlock() {
-    index_t *p = alloc(sizeof(index_t));
-    memset(p, 0, sizeof(*p));
-    return p;
+static ientry_t *indexEntry(uint8_t tableIdx, uint16_t idx) {
+    index_t *p = &itable[tableIdx];
+    if (idx >= p->size) {
+        uint32_t newSize = p->size ? p->size : INDEXCHUNK;
+        while (idx >= newSize)
+            newSize *= 2;
+        ientry_t *names = xrealloc(p->names, newSize * sizeof(ientry_t));
+        memset(names + p->size, 0, (newSize - p->size) * sizeof(ientry_t));
+        p->names = names;
+        p->size  = newSize;
+    }
+    return &p->names[idx];
 }
 
 void resetNames() {
-    for (str_t *p = &strings; p; p = p->next)
-        p->pos = 0;
-    for (int i = 0; i < INDEXTABLES; i++)
-        for (index_t *p = itable[i]; p; p = p->next)
-            memset((void *)p->names, 0, sizeof(p->names));
+    curStr      = &strings;
+    strings.pos = 0;
+    generation++;
 }
 
 char const *pstrdup(uint16_t len, char const *s) {
     if (len == 0)
         return "";
+    countInterned();
     char *newstr = allocStrSpace(len + 1);
     memcpy(newstr, s, len);
     newstr[len] = 0;
@@ -90,41 +124,28 @@ char const *pstrdup(uint16_t len, char const *s) {
 void setIndex(uint8_t tableIdx, uint16_t idx, char const *name) {
     if (tableIdx >= INDEXTABLES)
         return;
-    if (!itable[tableIdx])
-        itable[tableIdx] = newIndexBlock();
-
-    index_t *p;
-    for (p = itable[tableIdx]; idx >= INDEXCHUNK; idx -= INDEXCHUNK) {
-        if (!p->next)
-            p->next = newIndexBlock();
-        p = p->next;
-    }
+    ientry_t *p   = indexEntry(tableIdx, idx);
+    p->generation = generation;
     if (strlen(name) <= MAXNAME)
-        p->names[idx] = name;
+        p->name = name;
     else {
-        p->names[idx] = pstrdup(MAXNAME, name);
+        p->name = pstrdup(MAXNAME, name);
         /* rewrite end of truncated name, note requires removing const */
         char ending[9];
-        strcpy((char *)p->names[idx] + MAXNAME - sprintf(ending, "..@%d", idx), ending);
+        strcpy((char *)p->name + MAXNAME - sprintf(ending, "..@%d", idx), ending);
     }
 }
 
 char const *getIndexName(uint8_t tableIdx, uint16_t idx) {
     if (tableIdx >= INDEXTABLES)
         return "Bad Index";
-    index_t *p = itable[tableIdx];
-    uint16_t i = idx;
-    while (p && i >= INDEXCHUNK) {
-        if (!p->next)
-            p->next = newIndexBlock();
-        p = p->next;
-        i -= INDEXCHUNK;
-    }
-    if (!p->names[i]) {
+    ientry_t *p = indexEntry(tableIdx, idx);
+    if (p->generation != generation) {
         char tmp[7];
-        int len     = sprintf(tmp, "@%d", idx);
-        p->names[i] = pstrdup(len, tmp);
+        int len       = sprintf(tmp, "@%d", idx);
+        p->name       = pstrdup(len, tmp);
+        p->generation = generation;
     }
 
-    return p->names[i];
+    return p->name;
 }
@@ -61,6 +61,7 @@ extern bool atEnd;
 extern uint8_t rec[MAXREC];
 extern int recType;
 extern uint8_t *recPtr;
+extern uint8_t *recEndPtr;
 extern bool malformed;
 
 enum { Junk = -2, Eof = -1, BadCRC = 0, Ok = 1 };
@@ -69,6 +70,10 @@ enum omf_e { OMFUKN = 0, OMF85, OMF51, OMF51K, OMF96, OMF86};
 enum flavour_e { ANY, INTEL, MS, IBM, PHARLAP};
 
 extern enum flavour_e omfFlavour;
+extern bool rawMode;
+extern bool disasmMode;
+extern bool fixupsMode;
+extern long fixupAddr;
 
 typedef struct {
     char const *name; /* starts with + if odd record number is supported */
@@ -83,6 +88,8 @@ typedef struct _omfDispatch {
     decodeSpec_t *decodeTable;
 } omfDispatch_t;
 
+extern omfDispatch_t dispatchTable[];
+
 typedef struct {
     uint16_t len;
     uint32_t ival;
@@ -99,10 +106,25 @@ typedef struct field {
     uint16_t width;
 } field_t;
 
+typedef struct {
+    uint8_t method;
+    uint16_t datum; /* index or frame number */
+} fixRef86_t;
+
+typedef struct {
+    uint16_t seg;    /* segment index of the data record, 0 if absolute */
+    uint32_t offset; /* offset of the location in the segment */
+    uint8_t loc;
+    bool self;
+    bool hasDisp;
+    fixRef86_t frame; /* with any THREAD resolved */
+    fixRef86_t target;
+    uint32_t disp;
+} fixup86_t;
+
 
 
 extern long start;
-#define INDEXCHUNK 256
 
 #define FIXED      0
 #define REPEAT     1
@@ -119,6 +141,9 @@ void Log(char const *fmt, ...);
 enum { ISEG = 0, IEXT, INAME, ITYPEDEF, IOVERLAY, IGROUP , IBLOCK, ICOMDAT, INDEXTABLES};
 
     /* mem.c */
+void *xrealloc(void *old, size_t size);
+void *xcalloc(size_t n, size_t size);
+char *xstrdup(char const *s);
 void resetNames(void);
 char const *pstrdup(uint16_t len, char const *s);
 char const *concat(char *s, ...);
@@ -127,6 +152,13 @@ char const *getIndexName(uint8_t tableIdx, uint16_t idx);
 
 /* main.c */
 _Noreturn void usage(char const *s);
+FILE *openInput(char const *fname);
+void seekInput(long pos);
+long tellInput(void);
+bool canReadAhead(long pos);
+int loadRecHdr(void);
+int loadRecBody(uint16_t len);
+void skipRecBody(uint16_t len);
 int loadRec(void);
 int getrec(void);
 bool atEndRec(void);
@@ -144,8 +176,11 @@ uint16_t getIndex(void);
 char const *getName(void);
 int detectOMF(void);
 int main(int argc, char **argv);
+void resolveFlavour(void);
+decodeSpec_t const *lookupDecode(int spec, int type);
 
 /* common.c */
+void resetDisplay(void);
 void startCol(int n);
 void _add(char const *fmt, va_list args);
 void addAt(int col, char const *fmt, ...);
@@ -155,11 +190,86 @@ void splitLine(void);
 void displayLine(void);
 void Log(char const *fmt, ...);
 void invalidRecord(int type);
+void displayRecords(int spec, long end);
 void displayFile(int spec);
 void hexDump(unsigned addr, bool showLoc);
+void addHexBytes(uint8_t const *bytes, int n);
+char *intelHex(char *s, uint32_t val, int width);
+void setOutputBuffer(FILE *fp);
 
 void oaddHeader(uint8_t cols, ofield_t const *fields);
 
+/* batch.c */
+int batchDump(int argc, char **argv, int workers, char const *combinedFile, char const *manifest);
+
+/* disasm51.c */
+void resetDisasm51(void);
+void setSegType51(uint8_t segId, uint8_t info);
+bool isCodeSeg51(uint8_t segId);
+void addLabel51(uint8_t segId, uint16_t offset, char const *name);
+void disasm51(uint8_t segId, uint32_t addr);
+
+/* disasm85.c */
+void resetLabels85(void);
+void addLabel85(uint8_t segId, uint16_t offset, char const *name);
+void disasm85(uint8_t segId, uint16_t addr);
+
+/* fixups.c */
+void resetFixups86(void);
+void setSegLen86(uint16_t seg, uint32_t len);
+void addFixup86(fixup86_t const *fix, char const *locName);
+void fixupReport86(void);
+
+/* image.c */
+void imageFile(int spec, char const *binPrefix);
+
+/* jobs.c */
+typedef struct {
+    int cnt;                          /* jobs are numbered 0 to cnt - 1 */
+    int crashed;                      /* status of a job whose worker failed */
+    bool (*pending)(int i);           /* false if the job is to be skipped */
+    int (*run)(int i);                /* returns the job status, run in the worker */
+    void (*finish)(int i, int status); /* records the status, run in the parent */
+    void (*progress)(void);           /* optional, called as jobs complete */
+} jobs_t;
+
+char *joinPath(char const *dir, char const *name);
+bool hasSuffix(char const *s, char const *suffix);
+void readManifest(char const *manifest, void (*addEntry)(char const *line));
+void writeManifest(char const *manifest, char const *tag, void (*putEntries)(FILE *fp));
+void runJobs(jobs_t const *jobs, int workers);
+
+/* split.c */
+int splitDump(char const *fname, char const *dir, int workers);
+
+/* stats.c */
+void statsFile(char const *fname);
+
+/* symidx.c */
+int symbolQuery(char const *fname, char const *idxFile, char const *where);
+
+/* omf86.c */
+void addFrame86(fixRef86_t const *ref);
+void addTarget86(fixRef86_t const *ref);
+void fixupDat(fixup86_t *fix);
+
+/* timing.c */
+enum { PH_OTHER = 0, PH_READ, PH_DECODE, PH_FORMAT, PH_OUTPUT, PH_COUNT };
+extern bool timingMode;
+void startTiming(void);
+int setPhase(int phase);
+void countBytes(int phase, size_t n);
+void countRecord(int type, uint16_t len);
+void countMalformed(void);
+void countInterned(void);
+void timingReport(int spec);
+
+/* typedef86.c */
+void resetTypes86(void);
+char const *typeStr86(uint16_t typeIdx);
+void addTypeStr86(uint16_t typeIdx);
+void descriptor86(uint16_t typeIdx);
+
 void omf85_06(int type);
 void omfLINNUM();
 void omfLIBLOC(int type);
@@ -169,12 +279,12 @@ void omfLIBHDR(int type);
 void undoCol();
 uint16_t getCol();
 
-bool isValidRec(int spec);
+bool isValidRec(int spec, int type);
 uint16_t getRecPos();
 void setRecPos(uint16_t pos);
 
-void base86();
-void descriptor86();
+uint16_t base86();
+int communalLen();
 void fixCol();
 uint8_t peekNextRecType();
 void flagMalformed();
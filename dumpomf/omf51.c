@@ -104,6 +104,7 @@ void init51() {
     resetNames();
     setIndex(ISEG, 0, "ABS");
     extIndex = segIndex = 0;
+    resetDisasm51();
 }
 
 void segInfo51(uint8_t n) { // Max width = 5 + 6 + 11 = 22
@@ -176,8 +177,13 @@ void omf51_04(int type) {
 }
 
 void omf51_06(int type) {
-    add("Seg[%s]", getIndexName(ISEG, getu8()));
-    hexDump(type == 6 ? getu16() : getu24(), peekNextRecType() == 8);
+    uint8_t segId = getu8();
+    add("Seg[%s]", getIndexName(ISEG, segId));
+    uint32_t addr = type == 6 ? getu16() : getu24();
+    if (disasmMode && isCodeSeg51(segId))
+        disasm51(segId, addr);
+    else
+        hexDump(addr, peekNextRecType() == 8);
 }
 
 void omf51_08(int type) {
@@ -252,6 +258,8 @@ void omf51_0E(int type) {
         char const *segName = getName();
         if (segId)
             setIndex(ISEG, segId, segName);
+        if (disasmMode)
+            setSegType51(segId, segInfo);
         addField("@%d", segId);
         addField("%s", *segName ? segName : "*Unnamed*");
         if (pad != (type & 1))
@@ -314,7 +322,10 @@ void omf51_12(int type) {
             uint32_t offset = getu16();
             uint8_t ti      = getu8();
 
-            addField("%s", getName());
+            char const *name = getName();
+            addField("%s", name);
+            if (disasmMode && defTyp < 2 && (info & 7) == 0 && !malformed)
+                addLabel51(segId, offset, name);
             if (type == 0x22 && segId == 0 && info == 2 && offset && (offset < 8 || offset == 0x82)) {
                 addField("Reg: ");
                 if (offset == 1)
@@ -360,8 +371,11 @@ void omf51_16(int type) {
         uint32_t offset = type & 1 ? getu24() : getu16();
         getu8();
 
-        addField("%s", getName()); // name
+        char const *name = getName();
+        addField("%s", name); // name
         addField("%s:%04X", getIndexName(ISEG, segId), offset);
+        if (disasmMode && (symInfo & 7) == 0 && !malformed)
+            addLabel51(segId, (uint16_t)offset, name);
         symInfo51(symInfo, type & 1);
     }
 }
@@ -85,6 +85,7 @@ void init85() {
     setIndex(ISEG, 5, "RESERVED");
     setIndex(ISEG, 255, "COMMON");
     extIndex = 0;
+    resetLabels85();
 }
 
 void loadCommonNames() {
@@ -102,7 +103,7 @@ void loadCommonNames() {
         if (malformed)
             break;
     }
-    fseek(src, where, SEEK_SET);
+    seekInput(where);
     loadRec();
 }
 
@@ -141,9 +142,12 @@ void omf85_04(int type) {
 }
 
 void omf85_06(int type) {
-    add("Seg[%s] ", getIndexName(ISEG, getu8()));
-    /* dump the content, adding offset info if fixup follows */
-    hexDump(getu16(), false);
+    uint8_t segId = getu8();
+    add("Seg[%s] ", getIndexName(ISEG, segId));
+    if (disasmMode && segId <= 1) /* ABS or CODE */
+        disasm85(segId, getu16());
+    else /* dump the content, adding offset info if fixup follows */
+        hexDump(getu16(), false);
 }
 
 void omf85_08(int type) { // LINNUM
@@ -172,13 +176,18 @@ void omf85_10(int type) {
 void omf85_12_16(int type) {
     static field_t const header[] = { { "Offset" }, { "Name", WNAME }, { NULL } };
 
-    add("Seg[%s]", getIndexName(ISEG, getu8()));
+    uint8_t segId = getu8();
+    add("Seg[%s]", getIndexName(ISEG, segId));
     int cols = addReptHeader(header);
     while (!atEndRec()) {
         startCol(cols);
-        addField("%04X", getu16()); // offset
-        addField("%s", getName());  // name
+        uint16_t offset  = getu16();
+        char const *name = getName();
+        addField("%04X", offset); // offset
+        addField("%s", name);     // name
         getu8(); // trailing 0
+        if (disasmMode && !malformed)
+            addLabel85(segId, offset, name);
     }
 }
 
@@ -113,12 +113,12 @@ decodeSpec_t omf86Decode[] = {
 
 };
 
-bool isValidRec(int spec) {
-    if ((recType & 1) == 0)
+bool isValidRec(int spec, int type) {
+    if ((type & 1) == 0)
         return true;
     if (spec == OMF51K)
-        return strchr("\x7\xf\x17\x19\x23", recType);
-    return strchr("\x8b\x91\x95\x99\xa1\xa3\xb3\xb5\xb7\xc3\xc5\xc9", recType);
+        return strchr("\x7\xf\x17\x19\x23", type);
+    return strchr("\x8b\x91\x95\x99\xa1\xa3\xb3\xb5\xb7\xc3\xc5\xc9", type);
 }
 
 int nameIndex;
@@ -128,6 +128,13 @@ int blkIndex;
 extern int typeIndex;
 uint16_t iDataBlock;
 
+/* THREAD state, resolved into the fixups that use it */
+static fixRef86_t frameThreads[4];
+static fixRef86_t targetThreads[4];
+/* base of the last data record, used to locate its fixups */
+static uint16_t dataSeg;
+static uint32_t dataOffset;
+
 char const *enumModDat86[5] = { "ModDat", "ABSOLUTE", "RELOCATABLE", "PIC", "LTL" };
 
 void init86() {
@@ -141,32 +148,62 @@ void init86() {
     grpIndex  = 1;
     blkIndex  = 1;
     typeIndex = 1;
+    resetTypes86();
+    memset(frameThreads, 0, sizeof(frameThreads));
+    memset(targetThreads, 0, sizeof(targetThreads));
+    dataSeg    = 0;
+    dataOffset = 0;
+    resetFixups86();
 }
 
-void base86() {
+/* returns the segment index, 0 if a frame number is used */
+uint16_t base86() {
     uint16_t grpIdx = getIndex();
     uint16_t segIdx = getIndex();
-    if (grpIdx)
+    if (grpIdx && segIdx)
         add("Grp[%s].Seg[%s]", getIndexName(IGROUP, grpIdx), getIndexName(ISEG, segIdx));
     else if (segIdx)
         add("Seg[%s]", getIndexName(ISEG, segIdx));
+    else if (grpIdx)
+        add("Grp[%s].Frame: %04X", getIndexName(IGROUP, grpIdx), getu16());
     else
         add("Frame: %04X", getu16());
+    return segIdx;
+}
+
+static void setDataBase(uint16_t seg, uint32_t offset) {
+    dataSeg    = seg;
+    dataOffset = offset;
 }
 
-static void doFrame(uint8_t frame) {
-    switch (frame) {
+static fixRef86_t getFrame(uint8_t frame) {
+    fixRef86_t ref = { frame, 0 };
+    if (frame <= F_EXT)
+        ref.datum = getIndex();
+    else if (frame == F_ABS)
+        ref.datum = getu16();
+    return ref;
+}
+
+static fixRef86_t getTarget(uint8_t target) {
+    fixRef86_t ref = { target & 0x03, 0 };
+    ref.datum      = ref.method == T_ABSWD ? getu16() : getIndex();
+    return ref;
+}
+
+void addFrame86(fixRef86_t const *ref) {
+    switch (ref->method) {
     case F_SEG:
-        add("SI[%s]", getIndexName(ISEG, getIndex()));
+        add("SI[%s]", getIndexName(ISEG, ref->datum));
         break;
     case F_GRP:
-        add("GI[%s]", getIndexName(IGROUP, getIndex()));
+        add("GI[%s]", getIndexName(IGROUP, ref->datum));
         break;
     case F_EXT:
-        add("EI[%s]", getIndexName(IEXT, getIndex()));
+        add("EI[%s]", getIndexName(IEXT, ref->datum));
         break;
     case F_ABS:
-        add("%04X", getu16());
+        add("%04X", ref->datum);
         break;
     case F_LOC:
         add("LOCATION");
@@ -178,47 +215,52 @@ static void doFrame(uint8_t frame) {
         add("NONE    ");
         break;
     default:
-        add("Unknown frame(%d)", frame);
+        add("Unknown frame(%d)", ref->method);
         break;
     }
 }
 
-static void doTarget(uint8_t target) {
-    switch (target & 0x03) {
+void addTarget86(fixRef86_t const *ref) {
+    switch (ref->method) {
     case T_SEGWD:
-        add("Seg[%s]", getIndexName(ISEG, getIndex()));
+        add("Seg[%s]", getIndexName(ISEG, ref->datum));
         break;
     case T_GRPWD:
-        add("Grp[%s]", getIndexName(IGROUP, getIndex()));
+        add("Grp[%s]", getIndexName(IGROUP, ref->datum));
         break;
     case T_EXTWD:
-        add("Ext[%s]", getIndexName(IEXT, getIndex()));
+        add("Ext[%s]", getIndexName(IEXT, ref->datum));
         break;
     case T_ABSWD:
-        add("Frame %04X", getu16());
+        add("Frame %04X", ref->datum);
         break;
     }
 }
 
-void fixupDat() {
+void fixupDat(fixup86_t *fix) {
     uint8_t typ       = getu8();
     uint8_t frame     = (typ >> 4) & 0x07;
 
     uint16_t startCol = getCol();
 
+    fix->frame        = typ & FIXDAT_FTHREAD ? frameThreads[frame & 3] : getFrame(frame);
+    fix->target       = typ & FIXDAT_TTHREAD ? targetThreads[typ & 3] : getTarget(typ & 3);
+    fix->hasDisp      = !(typ & FIXDAT_PBIT);
+    fix->disp         = !fix->hasDisp ? 0 : is32bit ? getu32() : getu16();
+
     if (typ & FIXDAT_FTHREAD)
         add("THREAD(%d)", frame & 3);
     else
-        doFrame(frame);
+        addFrame86(&fix->frame);
 
     addAt(startCol + 17, "");
     if (typ & FIXDAT_TTHREAD)
         add("THREAD(%d)", typ & 3);
     else
-        doTarget(typ & 3);
+        addTarget86(&fix->target);
 
-    if (!(typ & 0x04))
-        add(",%04X", is32bit ? getu32() : getu16());
+    if (fix->hasDisp)
+        add(",%04X", fix->disp);
 }
 
 static void explicitFixup(uint8_t typ) {
@@ -228,9 +270,10 @@ static void explicitFixup(uint8_t typ) {
                                        "Undefined12", "rOffset32",  "Undefined14", "Undefined15" };
     uint8_t loc;
     uint16_t offset = ((typ & 0x03) * 256) + getu8();
+    fixup86_t fix;
 
     add("%03X>", offset);
-    addAt(6, typ & FIXDAT_MBIT ? "Self" : "Seg");
+    addAt(6, typ & FIXDAT_MBIT ? "Seg" : "Self");
     loc = ((typ >> 2) & 0x0f);
     if (omfFlavour == ANY && loc >= LOC_MS_LINK_OFFSET)
         omfFlavour = MS;
@@ -239,7 +282,14 @@ static void explicitFixup(uint8_t typ) {
 
     addAt(19, "%s", locations[loc]);
     addAt(31, "");
-    fixupDat();
+    fixupDat(&fix);
+    if (fixupsMode && !malformed) {
+        fix.seg    = dataSeg;
+        fix.offset = dataOffset + offset;
+        fix.loc    = loc;
+        fix.self   = (typ & FIXDAT_MBIT) == 0;
+        addFixup86(&fix, locations[loc]);
+    }
 }
 
 void threadFixup(uint8_t typ) {
@@ -247,11 +297,13 @@ void threadFixup(uint8_t typ) {
     uint8_t method = (typ >> 2) & 7;
 
     if ((typ & 0x40)) {
+        frameThreads[thred] = getFrame(method);
         add("Thread FRAME(%d)  =", thred);
-        doFrame(method);
+        addFrame86(&frameThreads[thred]);
     } else {
+        targetThreads[thred] = getTarget(method);
         add("Thread TARGET(%d) =", thred);
-        doTarget(method);
+        addTarget86(&targetThreads[thred]);
     }
 }
 
@@ -261,22 +313,27 @@ uint32_t blockContent86(uint32_t addr) {
     uint8_t offset    = 0;
     uint8_t addrWidth = addr > 0x10000 ? 6 : 4;
 
+    uint8_t bytes[16];
     char ascii[17];
     uint8_t i = 0;
-    while (len-- && !malformed) {
-        if (i == 16 || (i > 8 && getCol() > ASCIICOL + addrWidth - 3)) {
+    while (len && !malformed) {
+        if (i) { /* previous row full */
             ascii[i] = '\0';
             addAt(ASCIICOL, "|%s|", ascii);
-            i = 0;
             startCol(1);
             add("%04X ", addr + offset);
         }
-        if (i == 0)
-            addAt(indent, "%03X>", getRecPos() - iDataBlock);
-        uint8_t c = getu8();
-        offset++;
-        add(" %02X", c);
-        ascii[i++] = ' ' <= c && c <= '~' ? c : '.';
+        addAt(indent, "%03X>", getRecPos() - iDataBlock);
+        /* collect a row's worth of bytes, each takes HEXWIDTH columns */
+        uint16_t col = getCol();
+        for (i = 0; len && !malformed && i < 16 &&
+                    (i <= 8 || col + i * HEXWIDTH <= ASCIICOL + addrWidth - 3);
+             i++, len--) {
+            uint8_t c = bytes[i] = getu8();
+            ascii[i]             = ' ' <= c && c <= '~' ? c : '.';
+        }
+        offset += i;
+        addHexBytes(bytes, i);
     }
     if (i) {
         ascii[i] = '\0';
@@ -467,6 +524,7 @@ void omf86_6E(int type) { // RHEADR
 
 void omf86_70(int type) { // REGINT
     char const *regs[] = { "CS,IP", "SS,SP", "DS", "ES" };
+    fixup86_t fix;
 
     while (!atEndRec()) {
         startCol(3);
@@ -474,7 +532,7 @@ void omf86_70(int type) { // REGINT
         add(regs[regTyp >> 6]);
         addAt(6, "");
         if (regTyp & 1)
-            fixupDat();
+            fixupDat(&fix);
         else {
             base86();
             if ((regTyp >> 6) <= 1)
@@ -483,12 +541,16 @@ void omf86_70(int type) { // REGINT
     }
 }
 void omf86_72(int type) { // REDATA
-    base86();
-    hexDump(getu16(), strchr("\x9c\x9d", peekNextRecType()) != NULL);
+    uint16_t segIdx = base86();
+    uint16_t offset = getu16();
+    setDataBase(segIdx, offset);
+    hexDump(offset, strchr("\x9c\x9d", peekNextRecType()) != NULL);
 }
 void omf86_74(int type) { // RIDATA
-    base86();
-    iData86(getu16());
+    uint16_t segIdx = base86();
+    uint16_t offset = getu16();
+    setDataBase(segIdx, offset);
+    iData86(offset);
 }
 void omf86_76(int type) { // OVLDEF
     char const *name = getName();
@@ -538,8 +600,11 @@ void omf86_7A(int type) { // BLKDEF
     addAt(header[4].tabStop, "%04X   %04X ", offset, length);
     if (pi & 0x80)
         add("[BP+%X]", getu16());
-    if (*name)
-        addAt(header[7].tabStop, "#%d", getIndex());
+    if (*name) {
+        uint16_t tindex = getIndex();
+        addAt(header[7].tabStop, "#%d", tindex);
+        addTypeStr86(tindex);
+    }
 }
 void omf86_7C(int type) { // BLKEND
 }
@@ -590,6 +655,7 @@ void omf86_7E(int type) { // DEBSYM
             break;
         }
         addField("@%d", tindex);
+        addTypeStr86(tindex);
     }
 }
 void omf86_80(int type) { // THEADR
@@ -602,13 +668,18 @@ void omf86_82(int type) { // LHEADR
 
 void omf86_84(int type) { // PEDATA
     uint16_t frame = getu16();
+    uint8_t offset = getu8();
     add("Frame:%04X", frame);
-    hexDump(getu8(), strchr("\x9c\x9d", peekNextRecType()) != NULL);
+    setDataBase(0, frame * 16 + offset);
+    hexDump(offset, strchr("\x9c\x9d", peekNextRecType()) != NULL);
 }
 
 void omf86_86(int type) { // PIDATA
-    add("Frame:%04X", getu16());
-    iData86(getu8());
+    uint16_t frame = getu16();
+    uint8_t offset = getu8();
+    add("Frame:%04X", frame);
+    setDataBase(0, frame * 16 + offset);
+    iData86(offset);
 }
 void omf86_88(int type) { // COMENT
     static ofield_t const headerA7[] = { { 0, "Segment" }, { 0, NULL } };
@@ -728,13 +799,18 @@ void omf86_8A(int type) { // MODEND
         add("Main Module");
     if (modTyp & 0x40) {
         add(" CS,%s = ", is32bit ? "EIP" : "IP");
-        if (modTyp & 1)
-            fixupDat();
-        else {
+        if (modTyp & 1) {
+            fixup86_t fix;
+            fixupDat(&fix);
+        } else {
             add("%04X", getu16());
             add(",%04X", getu16());
         }
     }
+    if (fixupsMode) {
+        displayLine();
+        fixupReport86();
+    }
     init86();
 }
 void omf86Ext(int type) { // EXTDEF
@@ -746,13 +822,15 @@ void omf86Ext(int type) { // EXTDEF
         setIndex(IEXT, extIndex, name);
         addField("@%d", extIndex++);
         addField("%s", name);
-        addField("@%d", getIndex()); // external type
+        uint16_t tindex = getIndex();
+        addField("@%d", tindex); // external type
+        addTypeStr86(tindex);
     }
 }
 void omf86_8E(int type) { // TYPDEF
     add("%s", getName());
-    add("#%d ", typeIndex++);
-    descriptor86();
+    add("#%d ", typeIndex);
+    descriptor86(typeIndex++);
 }
 
 void omf86PubLoc(int type) { // PUBDEF / LOCSYM
@@ -764,9 +842,11 @@ void omf86PubLoc(int type) { // PUBDEF / LOCSYM
     while (!atEndRec()) {
         startCol(cols);
         char const *name = getName();
-        addField("%04X", getu16());  // offset
-        addField("@%d", getIndex()); // index
-        addField("%s", name);        // name
+        addField("%04X", getu16()); // offset
+        uint16_t tindex = getIndex();
+        addField("@%d", tindex);    // index
+        addField("%s", name);       // name
+        addTypeStr86(tindex);
     }
 }
 
@@ -849,6 +929,7 @@ void omf86_98(int type) { // SEGDEF
     oaddHeader(1, header);
     startCol(1);
 
+    setSegLen86(segIndex, segLen);
     add("#%-3d %s", segIndex++, fullName);
     if ((type & 1) && segAttr & 2)
         addAt(header[2].tabStop, "100000000");
@@ -936,13 +1017,19 @@ void omf86_9C(int type) { // FIXUPP
     }
 }
 void omf86_A0(int type) { // LEDATA
-    add("%s", getIndexName(ISEG, getIndex()));
-    hexDump(type & 1 ? getu32() : getu16(), strchr("\x9c\x9d", peekNextRecType()) != NULL);
+    uint16_t segIdx = getIndex();
+    uint32_t offset = type & 1 ? getu32() : getu16();
+    add("%s", getIndexName(ISEG, segIdx));
+    setDataBase(segIdx, offset);
+    hexDump(offset, strchr("\x9c\x9d", peekNextRecType()) != NULL);
 }
 
 void omf86_A2(int type) { // LIDATA
-    add("%s", getIndexName(ISEG, getIndex()));
-    iData86(type & 1 ? getu32() : getu16());
+    uint16_t segIdx = getIndex();
+    uint32_t offset = type & 1 ? getu32() : getu16();
+    add("%s", getIndexName(ISEG, segIdx));
+    setDataBase(segIdx, offset);
+    iData86(offset);
 }
 
 int communalLen() {
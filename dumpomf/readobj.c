@@ -1,4 +1,8 @@
 #include "omf.h"
+#ifdef _MSC_VER
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 long start; // file start position of current record
 
@@ -8,17 +12,104 @@ uint8_t *recPtr;
 uint8_t *recEndPtr;
 uint8_t *recMark;
 
-int loadRec() {
-    unsigned char hdr[3];
-    uint16_t len;
-    uint8_t crc;
+static uint8_t hdr[3];
+
+/*
+ * Input is read through a ring buffer so that a pipe can be used as well as a
+ * file. The buffer holds the most recently read bytes, which allows the
+ * record look-ahead used for CRC recovery, COMNAM and fixup loading, to seek
+ * back to the current record. A file can also seek outside the buffer.
+ * RINGCHUNK is the most read at once, so RINGSIZE - RINGCHUNK bytes before
+ * the read position are always available.
+ */
+#define RINGSIZE  0x100000 /* must be a power of 2 */
+#define RINGCHUNK 0x10000
+
+static uint8_t ring[RINGSIZE];
+static long ringStart; /* file positions of the buffered bytes */
+static long ringEnd;
+static long inPos;
+static bool seekable;
+
+/* opens the object file, - is stdin */
+FILE *openInput(char const *fname) {
+    if (strcmp(fname, "-") == 0) {
+#ifdef _MSC_VER
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        src      = stdin;
+        seekable = false;
+    } else if ((src = fopen(fname, "rb")))
+        seekable = true;
+    ringStart = ringEnd = inPos = 0;
+    return src;
+}
+
+static bool fillRing() {
+    size_t len = fread(ring + (ringEnd & (RINGSIZE - 1)), 1,
+                       RINGCHUNK - (ringEnd & (RINGCHUNK - 1)), src);
+    ringEnd += (long)len;
+    if (ringEnd - ringStart > RINGSIZE)
+        ringStart = ringEnd - RINGSIZE;
+    return len != 0;
+}
+
+static int readInput(uint8_t *buf, int len) {
+    int got = 0;
+    while (got < len && (inPos < ringEnd || fillRing())) {
+        int chunk = len - got;
+        if (chunk > ringEnd - inPos)
+            chunk = (int)(ringEnd - inPos);
+        if (chunk > RINGSIZE - (inPos & (RINGSIZE - 1)))
+            chunk = RINGSIZE - (inPos & (RINGSIZE - 1));
+        memcpy(buf + got, ring + (inPos & (RINGSIZE - 1)), chunk);
+        got += chunk;
+        inPos += chunk;
+    }
+    return got;
+}
+
+/* positions the input, a pipe can only go back as far as the ring buffer holds */
+void seekInput(long pos) {
+    if (ringStart <= pos && pos <= ringEnd)
+        inPos = pos;
+    else if (seekable && fseek(src, pos, SEEK_SET) == 0)
+        ringStart = ringEnd = inPos = pos;
+    else if (pos > ringEnd) { /* skip forward on a pipe */
+        inPos = ringEnd;
+        while (inPos < pos && fillRing())
+            inPos = ringEnd < pos ? ringEnd : pos;
+    } else {
+        fprintf(stderr, "Fatal: look-ahead exceeds the input buffer\n");
+        exit(1);
+    }
+}
 
-    if ((len = (uint16_t)fread(hdr, 1, 3, src)) != 3)
+long tellInput() {
+    return inPos;
+}
+
+/* true if another record can be read ahead and the input still seek back to pos */
+bool canReadAhead(long pos) {
+    return seekable || inPos + 3 + 0xffff + RINGCHUNK - pos <= RINGSIZE;
+}
+
+/* reads just the record header, returns the record length or Eof / Junk */
+int loadRecHdr() {
+    int len;
+
+    if ((len = readInput(hdr, 3)) != 3)
         return len == 0 ? Eof : Junk;
 
     recType = hdr[0];
-    len     = hdr[1] + hdr[2] * 256;
-    if (fread(rec, 1, len, src) != len)
+    return hdr[1] + hdr[2] * 256;
+}
+
+/* reads the body of the record whose header has just been read */
+int loadRecBody(uint16_t len) {
+    uint8_t crc;
+
+    if (readInput(rec, len) != len)
         return Junk;
 
     crc = hdr[0] + hdr[1] + hdr[2];
@@ -30,17 +121,30 @@ int loadRec() {
     return crc == 0 ? Ok : BadCRC;
 }
 
+/* skips the body of the record whose header has just been read */
+void skipRecBody(uint16_t len) {
+    seekInput(inPos + len);
+}
+
+int loadRec() {
+    int len = loadRecHdr();
+    return len < 0 ? len : loadRecBody(len);
+}
+
 int getrec() {
     int status;
+    int phase = setPhase(PH_READ);
 
-    start = ftell(src);
+    start = inPos;
 
     if ((status = loadRec()) == BadCRC) {
         if (loadRec() != Ok) /* see if the next record is ok */
             status = Junk;
-        fseek(src, start, SEEK_SET); /* reload the record with a bad CRC */
+        seekInput(start); /* reload the record with a bad CRC */
         loadRec();
     }
+    countBytes(PH_READ, inPos - start);
+    setPhase(phase);
     return status;
 }
 
@@ -75,9 +179,9 @@ uint8_t getu8() {
 }
 
 uint8_t peekNextRecType() {
-    int c = getc(src);
-    ungetc(c, src);
-    return c == EOF ? 0 : c;
+    if (inPos == ringEnd && !fillRing())
+        return 0;
+    return ring[inPos & (RINGSIZE - 1)];
 }
 
 uint16_t getu16() {
@@ -155,7 +259,7 @@ int detectOMF() {
         status = getrec();
         lib    = true;
     }
-    rewind(src); /* rewind the file so next getrec gets the first record */
+    seekInput(0); /* rewind the file so next getrec gets the first record */
     if (status < 0)
         return OMFUKN;
     
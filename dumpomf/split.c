@@ -0,0 +1,345 @@
+/****************************************************************************
+ *  split.c is part of dumpomf                                              *
+ *  Copyright (C) 2022 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+/*
+ * --split support
+ * The file is scanned once to find each module, i.e. the records from MODHDR,
+ * or for OMF86 THEADR, LHEADR or RHEADR, up to and including MODEND, and
+ * each module is dumped to DIR/module.dump. Any other records, e.g. the
+ * library header, names, locations and dictionary, are dumped in order to
+ * DIR/@library.dump. Duplicate module names have .2, .3 etc. appended.
+ * As with --batch, the dumps are written by workers from jobs.c, each with its
+ * own input buffer and decoder state.
+ * A manifest in DIR records a hash of each module's bytes, along with the
+ * decoder version and options, so unchanged modules are skipped on a rerun.
+ */
+
+#include "omf.h"
+#include "_version.h"
+#include <sys/stat.h>
+#ifdef _MSC_VER
+#include <direct.h>
+#endif
+
+#define DUMPEXT     ".dump"
+#define LIBPART     "@library"
+#define MANIFEST    "dumpomf.manifest"
+#define MANIFESTTAG "# dumpomf split manifest"
+
+enum { PART_OK = 0, PART_NOWRITE, PART_CRASHED, PART_PENDING, PART_UNCHANGED };
+
+typedef struct {
+    long start;
+    long end;
+    int part; /* owning part */
+} range_t;
+
+typedef struct {
+    char *name; /* output file name, without DUMPEXT */
+    uint64_t hash;
+    int status;
+} part_t;
+
+typedef struct {
+    char *name;
+    uint64_t hash;
+} manifest_t;
+
+static range_t *ranges;
+static int rangeCnt;
+static int rangeSize;
+
+static part_t *parts;
+static int partCnt;
+static int partSize;
+static int libPart = -1;
+
+static manifest_t *entries;
+static int entryCnt;
+static int entrySize;
+
+static int inSpec;
+static char const *inFile;
+static char const *outDir;
+static char version[32];
+
+static char *outName(char const *name, char const *ext) {
+    char *path = joinPath(outDir, name);
+    return strcat(xrealloc(path, strlen(path) + strlen(ext) + 1), ext);
+}
+
+/* FNV-1a, 64 bit */
+static uint64_t hashBytes(uint64_t hash, uint8_t const *s, size_t len) {
+    while (len--)
+        hash = (hash ^ *s++) * 1099511628211ull;
+    return hash;
+}
+
+static int addPart(char const *name) {
+    if (partCnt >= partSize) {
+        partSize = partSize ? partSize * 2 : 256;
+        parts    = xrealloc(parts, partSize * sizeof(part_t));
+    }
+    parts[partCnt] = (part_t){ xstrdup(name), 14695981039346656037ull, PART_PENDING };
+    return partCnt++;
+}
+
+static void addRange(int part, long start, long end) {
+    if (rangeCnt && ranges[rangeCnt - 1].part == part && ranges[rangeCnt - 1].end == start)
+        ranges[rangeCnt - 1].end = end; /* extend the previous range */
+    else {
+        if (rangeCnt >= rangeSize) {
+            rangeSize = rangeSize ? rangeSize * 2 : 256;
+            ranges    = xrealloc(ranges, rangeSize * sizeof(range_t));
+        }
+        ranges[rangeCnt++] = (range_t){ start, end, part };
+    }
+}
+
+/* module names are used as file names, so anything unusual is replaced by _ */
+static char const *safeName(uint8_t const *name, int len) {
+    static char safe[256];
+    int i;
+
+    for (i = 0; i < len; i++)
+        safe[i] = isalnum(name[i]) || strchr("_$?@-.", name[i]) ? name[i] : '_';
+    safe[i] = '\0';
+    if (i == 0 || strcmp(safe, ".") == 0 || strcmp(safe, "..") == 0)
+        sprintf(safe, "@module%d", partCnt);
+    return safe;
+}
+
+static bool isModuleStart(int spec) {
+    if (spec == OMF86)
+        return recType == 0x80 || recType == 0x82 || recType == 0x6e;
+    return recType == 2;
+}
+
+static bool isModuleEnd(int spec) {
+    if (spec == OMF86)
+        return recType == 0x8a || recType == 0x8b;
+    return recType == 4;
+}
+
+static void scanModules(int spec) {
+    int len;
+    int part = -1; /* current module */
+    long pos = 0;
+    long next;
+
+    while ((len = loadRecHdr()) >= 0) {
+        if (loadRecBody(len) < 0)
+            break;
+        next = pos + len + 3;
+        if (part < 0 && isModuleStart(spec))
+            part = addPart(safeName(rec + 1, len > 1 && rec[0] < len ? rec[0] : 0));
+        else if (part < 0 && libPart < 0)
+            libPart = addPart(LIBPART);
+        int owner = part >= 0 ? part : libPart;
+        uint8_t hdr[3] = { recType, len % 256, len / 256 };
+        parts[owner].hash = hashBytes(hashBytes(parts[owner].hash, hdr, 3), rec, len);
+        addRange(owner, pos, next);
+        if (isModuleEnd(spec))
+            part = -1;
+        pos = next;
+        if (recType == 0xe && (spec == OMF85 || spec == OMF96)) /* EOF */
+            break;
+    }
+}
+
+static int cmpPartName(void const *a, void const *b) {
+    int ia = *(int const *)a;
+    int ib = *(int const *)b;
+    int cmp = strcmp(parts[ia].name, parts[ib].name);
+    return cmp ? cmp : ia - ib;
+}
+
+/* later modules with the same name as an earlier one get .2, .3 etc. */
+static void uniqueNames() {
+    int *order = xrealloc(NULL, partCnt * sizeof(int));
+
+    for (int i = 0; i < partCnt; i++)
+        order[i] = i;
+    qsort(order, partCnt, sizeof(int), cmpPartName);
+    for (int i = 1, dup = 1; i < partCnt; i++) {
+        if (strcmp(parts[order[i]].name, parts[order[i - dup]].name) == 0) {
+            char *name = xrealloc(NULL, strlen(parts[order[i]].name) + 12);
+            sprintf(name, "%s.%d", parts[order[i]].name, ++dup);
+            free(parts[order[i]].name);
+            parts[order[i]].name = name;
+        } else
+            dup = 1;
+    }
+    free(order);
+}
+
+static int cmpEntry(void const *a, void const *b) {
+    return strcmp(((manifest_t const *)a)->name, ((manifest_t const *)b)->name);
+}
+
+/* entries made with a different decoder version or options are dropped */
+static void addManifestEntry(char const *line) {
+    unsigned long long hash;
+    char ver[sizeof(version)];
+    int pos;
+
+    if (sscanf(line, "%llx %31s %n", &hash, ver, &pos) == 2 && line[pos] &&
+        strcmp(ver, version) == 0) {
+        if (entryCnt >= entrySize) {
+            entrySize = entrySize ? entrySize * 2 : 256;
+            entries   = xrealloc(entries, entrySize * sizeof(manifest_t));
+        }
+        entries[entryCnt++] = (manifest_t){ xstrdup(line + pos), hash };
+    }
+}
+
+static void loadManifest() {
+    char *name = outName(MANIFEST, "");
+
+    readManifest(name, addManifestEntry);
+    if (entryCnt)
+        qsort(entries, entryCnt, sizeof(manifest_t), cmpEntry);
+    free(name);
+}
+
+/* the manifest only lists the parts of the current file */
+static void putManifestEntries(FILE *fp) {
+    for (int i = 0; i < partCnt; i++)
+        if (parts[i].status == PART_OK || parts[i].status == PART_UNCHANGED)
+            fprintf(fp, "%016llx %s %s\n", (unsigned long long)parts[i].hash, version,
+                    parts[i].name);
+}
+
+static void saveManifest() {
+    char *name = outName(MANIFEST, "");
+
+    writeManifest(name, MANIFESTTAG, putManifestEntries);
+    free(name);
+}
+
+/* remove dumps of modules that are no longer in the file */
+static void removeStale() {
+    manifest_t *current = xrealloc(NULL, (partCnt + 1) * sizeof(manifest_t));
+
+    for (int i = 0; i < partCnt; i++)
+        current[i] = (manifest_t){ parts[i].name, parts[i].hash };
+    qsort(current, partCnt, sizeof(manifest_t), cmpEntry);
+    for (int i = 0; i < entryCnt; i++)
+        if (!bsearch(&entries[i], current, partCnt, sizeof(manifest_t), cmpEntry)) {
+            char *name = outName(entries[i].name, DUMPEXT);
+            remove(name);
+            free(name);
+        }
+    free(current);
+}
+
+static bool isUnchanged(int i) {
+    manifest_t key = { parts[i].name, 0 };
+    manifest_t *entry;
+    char *name = outName(parts[i].name, DUMPEXT);
+    struct stat st;
+    bool unchanged;
+
+    entry     = entryCnt ? bsearch(&key, entries, entryCnt, sizeof(manifest_t), cmpEntry) : NULL;
+    unchanged = entry && entry->hash == parts[i].hash && stat(name, &st) == 0;
+    free(name);
+    return unchanged;
+}
+
+static bool isPending(int i) {
+    return parts[i].status == PART_PENDING;
+}
+
+static int runPart(int i) {
+    char *name = outName(parts[i].name, DUMPEXT);
+    int status = PART_OK;
+
+    if (openInput(inFile) == NULL || (dst = fopen(name, "w")) == NULL)
+        status = PART_NOWRITE;
+    else {
+        setOutputBuffer(dst);
+        resetDisplay();
+        omfFlavour = ANY;
+        dispatchTable[inSpec].init();
+        for (int j = 0; j < rangeCnt; j++)
+            if (ranges[j].part == i) {
+                seekInput(ranges[j].start);
+                displayRecords(inSpec, ranges[j].end);
+            }
+        if (fclose(dst) != 0)
+            status = PART_NOWRITE;
+    }
+    if (src)
+        fclose(src);
+    free(name);
+    return status;
+}
+
+static void finishPart(int i, int status) {
+    parts[i].status = status;
+    if (status == PART_NOWRITE)
+        fprintf(stderr, "%s: can't write %s" DUMPEXT "\n", outDir, parts[i].name);
+    else if (status == PART_CRASHED)
+        fprintf(stderr, "%s: decoder failed on %s\n", inFile, parts[i].name);
+}
+
+int splitDump(char const *fname, char const *dir, int workers) {
+    int counts[PART_UNCHANGED + 1] = { 0 };
+
+    inFile = fname;
+    outDir = dir;
+    sprintf(version, "%.20s%s%s%s", GIT_VERSION, rawMode ? "-r" : "", disasmMode ? "-d" : "",
+            fixupsMode ? "-f" : "");
+    if (strcmp(fname, "-") == 0)
+        usage("--split needs a library file, not stdin\n");
+    if (openInput(fname) == NULL)
+        usage("can't open input file\n");
+    if ((inSpec = detectOMF()) == OMFUKN) {
+        fprintf(stderr, "%s cannot determine OMF spec\n", fname);
+        fclose(src);
+        return 1;
+    }
+    scanModules(inSpec);
+    fclose(src);
+    src = NULL;
+
+#ifdef _MSC_VER
+    _mkdir(dir);
+#else
+    mkdir(dir, 0777);
+#endif
+    uniqueNames();
+    loadManifest();
+    for (int i = 0; i < partCnt; i++)
+        if (isUnchanged(i))
+            parts[i].status = PART_UNCHANGED;
+
+    jobs_t pool = { partCnt, PART_CRASHED, isPending, runPart, finishPart, NULL };
+    runJobs(&pool, workers);
+
+    removeStale();
+    saveManifest();
+    for (int i = 0; i < partCnt; i++)
+        counts[parts[i].status]++;
+    fprintf(stderr, "%d dumped, %d unchanged, %d failed\n", counts[PART_OK], counts[PART_UNCHANGED],
+            counts[PART_NOWRITE] + counts[PART_CRASHED]);
+    return counts[PART_NOWRITE] + counts[PART_CRASHED] ? 1 : 0;
+}
@@ -0,0 +1,392 @@
+/****************************************************************************
+ *  stats.c is part of dumpomf                                              *
+ *  Copyright (C) 2022 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+/*
+ * --stats support
+ * Only the record headers are read for most records, the few records that
+ * contribute to the summary are loaded and just the fields needed are decoded.
+ * No column formatting is done.
+ */
+
+#include "omf.h"
+
+#define MAXTOP 10 /* modules listed in the most fixups summary */
+
+typedef struct {
+    char *name;
+    uint32_t fixups;
+} modStat_t;
+
+static char const *specNames[] = { "Unknown", "OMF85", "OMF51", "OMF51 (Keil)", "OMF96", "OMF86" };
+
+static uint32_t recCount[256];
+static uint32_t recBytes[256];
+
+static modStat_t *mods;
+static int modCnt;
+static int modSize;
+
+static char const *modName;
+static bool inModule;
+static uint32_t nPublics;
+static uint32_t nExternals;
+static uint32_t nFixups;
+static char segInfo[MAXPOS * 4];
+static int lnameIndex;
+
+static void startModule(char const *name) {
+    modName  = name;
+    inModule = true;
+    nPublics = nExternals = nFixups = 0;
+    *segInfo                        = '\0';
+}
+
+static void addSeg(char const *name, uint32_t size) {
+    size_t len = strlen(segInfo);
+    if (len + strlen(name) + 12 < sizeof(segInfo))
+        sprintf(segInfo + len, "%s%s:%04X", len ? " " : "", *name ? name : "*Unnamed*", size);
+}
+
+static void endModule() {
+    if (!inModule)
+        return;
+    fprintf(dst, "  %-*s %7u %9u %7u  %s\n", MAXNAME, *modName ? modName : "*Unnamed*", nPublics,
+            nExternals, nFixups, segInfo);
+    if (modCnt >= modSize) {
+        modSize = modSize ? modSize * 2 : 64;
+        mods    = xrealloc(mods, modSize * sizeof(modStat_t));
+    }
+    mods[modCnt].name     = xstrdup(*modName ? modName : "*Unnamed*");
+    mods[modCnt++].fixups = nFixups;
+    inModule              = false;
+}
+
+static void skipBytes(int n) {
+    while (n-- > 0)
+        getu8();
+}
+
+static void skipName() {
+    skipBytes(getu8());
+}
+
+/* OMF85, OMF51 and OMF96 */
+static void stats85(int spec) {
+    switch (recType) {
+    case 2: // MODHDR
+        dispatchTable[spec].init();
+        startModule(getName());
+        if (spec == OMF85) {
+            getu16(); // trn & version
+            while (!atEndRec() && !malformed) {
+                char const *name = getIndexName(ISEG, getu8());
+                addSeg(name, getu16());
+                getu8(); // align
+            }
+        }
+        break;
+    case 4: // MODEND
+        endModule();
+        break;
+    case 0x16: // PUBLICS
+    case 0x17:
+        if (spec == OMF85) {
+            getu8();
+            while (!atEndRec() && !malformed) {
+                skipBytes(2);
+                skipName();
+                getu8();
+                nPublics++;
+            }
+        } else if (spec == OMF96) {
+            getu8();
+            while (!atEndRec() && !malformed) {
+                skipBytes(2);
+                skipName();
+                getIndex();
+                nPublics++;
+            }
+        } else {
+            while (!atEndRec() && !malformed) {
+                skipBytes(recType & 1 ? 6 : 5);
+                skipName();
+                nPublics++;
+            }
+        }
+        break;
+    case 0x18: // EXTDEF
+    case 0x19:
+        if (spec == OMF85) {
+            while (!atEndRec() && !malformed) {
+                skipName();
+                getu8();
+                nExternals++;
+            }
+        } else if (spec == OMF96) {
+            getu8();
+            while (!atEndRec() && !malformed) {
+                skipName();
+                getIndex();
+                nExternals++;
+            }
+        } else {
+            while (!atEndRec() && !malformed) {
+                skipBytes(recType & 1 ? 5 : 4);
+                skipName();
+                nExternals++;
+            }
+        }
+        break;
+    case 6: // CONTENT
+        break;
+    case 8: // OMF51 FIXUP
+        if (spec != OMF85 && spec != OMF96)
+            while (!atEndRec() && !malformed) {
+                skipBytes(7);
+                nFixups++;
+            }
+        break;
+    case 0xe: // OMF51 SEGDEF
+    case 0xf:
+        if (spec == OMF51 || spec == OMF51K)
+            while (!atEndRec() && !malformed) {
+                skipBytes(recType == 0xe ? 6 : 7);
+                uint16_t size = getu16();
+                addSeg(getName(), size);
+            }
+        break;
+    case 0x20:
+        if (spec == OMF85) { // EXTFIX
+            getu8();
+            while (!atEndRec() && !malformed) {
+                skipBytes(4);
+                nFixups++;
+            }
+        } else if (spec == OMF96) { // SEGDEF
+            while (!atEndRec() && !malformed) {
+                uint8_t segId = getu8();
+                skipBytes(segId & 0x80 ? 1 : 2);
+                addSeg(getIndexName(ISEG, segId & 7), getu16());
+            }
+        }
+        break;
+    case 0x22: // FIXUP
+        if (spec == OMF85) {
+            getu8();
+            while (!atEndRec() && !malformed) {
+                skipBytes(2);
+                nFixups++;
+            }
+        } else if (spec == OMF96) {
+            while (!atEndRec() && !malformed) {
+                uint8_t ftype = getu8();
+                skipBytes(2 + (ftype & 0x80 ? 2 : 1) + (ftype & 0x40 ? 0 : 2));
+                nFixups++;
+            }
+        }
+        break;
+    case 0x24: // SEGFIX
+        if (spec == OMF85) {
+            skipBytes(2);
+            while (!atEndRec() && !malformed) {
+                skipBytes(2);
+                nFixups++;
+            }
+        }
+        break;
+    }
+}
+
+/* skip a FIXUPP frame or target specifier */
+static void skipMethod86(uint8_t method) {
+    if (method < 3)
+        getIndex();
+    else if (method == 3)
+        getu16();
+}
+
+static void stats86() {
+    resolveFlavour();
+    switch (recType) {
+    case 0x6e: // RHEADR
+    case 0x80: // THEADR
+    case 0x82: // LHEADR
+        if (inModule)
+            endModule();
+        dispatchTable[OMF86].init();
+        lnameIndex = 1;
+        startModule(getName());
+        break;
+    case 0x8a: // MODEND
+    case 0x8b:
+        endModule();
+        break;
+    case 0x96: // LNAMES
+    case 0xca: // LLNAMES
+        while (!atEndRec() && !malformed)
+            setIndex(INAME, lnameIndex++, getName());
+        break;
+    case 0x98: // SEGDEF
+    case 0x99:
+        {
+            uint8_t segAttr = getu8();
+            uint8_t a       = segAttr >> 5;
+            uint8_t c       = (segAttr >> 2) & 7;
+            if (omfFlavour == ANY && (a == 6 || c == 1 || c == 3))
+                omfFlavour = INTEL;
+            if (a == 0 || (a == 5 && omfFlavour == INTEL))
+                skipBytes(3);
+            else if (a == 6)
+                skipBytes(5);
+            uint32_t segLen = recType & 1 ? getu32() : getu16();
+            if ((segAttr & 2) && !(recType & 1))
+                segLen = 0x10000;
+            char const *segName = "";
+            if (a != 5 || omfFlavour != INTEL)
+                segName = getIndexName(INAME, getIndex());
+            addSeg(segName, segLen);
+        }
+        break;
+    case 0x90: // PUBDEF
+    case 0x91:
+    case 0xb6: // LPUBDEF
+    case 0xb7:
+        {
+            getIndex(); /* group */
+            if (getIndex() == 0) /* a frame follows a segment index of 0, even with a group */
+                getu16();
+            while (!atEndRec() && !malformed) {
+                skipName();
+                skipBytes(recType & 1 ? 4 : 2);
+                getIndex();
+                nPublics++;
+            }
+        }
+        break;
+    case 0x8c: // EXTDEF
+    case 0xb4: // LEXTDEF
+    case 0xb5:
+        while (!atEndRec() && !malformed) {
+            skipName();
+            getIndex();
+            nExternals++;
+        }
+        break;
+    case 0xbc: // CEXTDEF
+        while (!atEndRec() && !malformed) {
+            getIndex();
+            getIndex();
+            nExternals++;
+        }
+        break;
+    case 0x9c: // FIXUPP
+    case 0x9d:
+        while (!atEndRec() && !malformed) {
+            uint8_t typ = getu8();
+            if (typ & 0x80) { // explicit fixup
+                getu8();
+                uint8_t fixDat = getu8();
+                if (!(fixDat & 0x80))
+                    skipMethod86((fixDat >> 4) & 7);
+                if (!(fixDat & 0x08))
+                    skipMethod86(fixDat & 3);
+                if (!(fixDat & 0x04))
+                    skipBytes(recType & 1 ? 4 : 2);
+                nFixups++;
+            } else
+                skipMethod86(typ & 0x40 ? (typ >> 2) & 7 : (typ >> 2) & 3);
+        }
+        break;
+    }
+}
+
+static bool isStatsRec(int spec) {
+    if (spec == OMF86)
+        return strchr("\x6e\x80\x82\x8a\x8b\x96\xca\x98\x99\x90\x91\xb6\xb7\x8c\xb4\xb5\xbc\x9c\x9d",
+                      recType) != NULL;
+    return recType != 6 && recType < 0x26;
+}
+
+static int cmpFixups(void const *a, void const *b) {
+    uint32_t fa = ((modStat_t const *)a)->fixups;
+    uint32_t fb = ((modStat_t const *)b)->fixups;
+    return fa < fb ? 1 : fa > fb ? -1 : 0;
+}
+
+void statsFile(char const *fname) {
+    int spec;
+    int len;
+    long fileSize = 0;
+
+    if (openInput(fname) == NULL) {
+        fprintf(stderr, "%s: can't open\n", fname);
+        return;
+    }
+    spec = detectOMF();
+    memset(recCount, 0, sizeof(recCount));
+    memset(recBytes, 0, sizeof(recBytes));
+    modCnt     = 0;
+    inModule   = false;
+    omfFlavour = ANY;
+    dispatchTable[spec].init();
+
+    fprintf(dst, "%s: %s\n", fname, specNames[spec]);
+    fprintf(dst, "  %-*s %7s %9s %7s  %s\n", MAXNAME, "Module", "Publics", "Externals", "Fixups",
+            "Segments");
+    while ((len = loadRecHdr()) >= 0) {
+        recCount[recType]++;
+        recBytes[recType] += len + 3;
+        fileSize += len + 3;
+        if (spec != OMFUKN && isStatsRec(spec)) {
+            if (loadRecBody(len) < 0)
+                break;
+            if (spec == OMF86)
+                stats86();
+            else
+                stats85(spec);
+        } else
+            skipRecBody(len);
+        if (recType == 0xe && (spec == OMF85 || spec == OMF96))
+            break;
+    }
+    endModule();
+    fclose(src);
+
+    fprintf(dst, "  %-*s %7s %10s\n", MAXNAME, "Record", "Count", "Bytes");
+    for (int i = 0; i < 256; i++)
+        if (recCount[i]) {
+            char label[MAXNAME + 1];
+            sprintf(label, "%.*s(%02X)", MAXNAME - 4, lookupDecode(spec, i)->name, i);
+            fprintf(dst, "  %-*s %7u %10u\n", MAXNAME, label, recCount[i], recBytes[i]);
+        }
+    fprintf(dst, "  %-*s %7d %10ld\n", MAXNAME, "Modules / Total", modCnt, fileSize);
+
+    if (modCnt > 1) {
+        qsort(mods, modCnt, sizeof(modStat_t), cmpFixups);
+        fprintf(dst, "  Most fixups:");
+        for (int i = 0; i < modCnt && i < MAXTOP && mods[i].fixups; i++)
+            fprintf(dst, " %s(%u)", mods[i].name, mods[i].fixups);
+        putc('\n', dst);
+    }
+    for (int i = 0; i < modCnt; i++)
+        free(mods[i].name);
+    putc('\n', dst);
+}
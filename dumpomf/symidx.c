@@ -0,0 +1,488 @@
+/****************************************************************************
+ *  symidx.c is part of dumpomf                                             *
+ *  Copyright (C) 2022 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+/*
+ * --where and --unresolved support
+ * The library is scanned once, reading only the bodies of the records that
+ * define modules, segments, publics and externals, to build a table of
+ * symbols held in a single string pool. A hash of symbol names chains all
+ * the entries for a name in file order.
+ * Optionally the table is saved to an index file, which is used in place of
+ * the scan while the library's size and modification time are unchanged.
+ * OMF86 COMDAT and CEXTDEF records are not indexed.
+ */
+
+#include "omf.h"
+#include "_version.h"
+#include <sys/stat.h>
+
+#define NONE     0xffffffffu
+#define IDXMAGIC "DUMPOMF-IDX1"
+
+enum { SYM_PUBLIC = 0, SYM_LOCAL, SYM_COMMON, SYM_EXTERN, SYM_LEXTERN };
+
+static char const *kindNames[] = { "Public", "Local", "Common", "Extern", "Extern (local)" };
+
+typedef struct {
+    uint32_t name; /* pool offsets */
+    uint32_t seg;
+    uint32_t offset;
+    uint16_t module;
+    uint8_t kind;
+    uint8_t pad;
+} sym_t;
+
+typedef struct {
+    char magic[sizeof(IDXMAGIC)];
+    char version[32];
+    long long size;
+    long long mtime;
+    uint32_t poolLen;
+    uint32_t modCnt;
+    uint32_t symCnt;
+} idxHdr_t;
+
+static char *pool;
+static uint32_t poolLen;
+static uint32_t poolSize;
+
+static uint32_t *mods; /* pool offset of module names */
+static uint32_t modCnt;
+static uint32_t modSize;
+
+static sym_t *syms;
+static uint32_t symCnt;
+static uint32_t symSize;
+
+static uint32_t *heads; /* first symbol for each hash, chained through next */
+static uint32_t *next;
+static uint32_t hashSize;
+
+static uint32_t *segNames; /* pool offset of each segment name for current module */
+static uint32_t segSize;
+static uint16_t segIndex86;
+static uint16_t nameIndex86;
+
+static uint32_t poolAdd(char const *s) {
+    uint32_t len = (uint32_t)strlen(s) + 1;
+    if (poolLen + len > poolSize) {
+        while (poolLen + len > poolSize)
+            poolSize = poolSize ? poolSize * 2 : 0x10000;
+        pool = xrealloc(pool, poolSize);
+    }
+    memcpy(pool + poolLen, s, len);
+    poolLen += len;
+    return poolLen - len;
+}
+
+/* FNV-1a */
+static uint32_t hashName(char const *s) {
+    uint32_t hash = 2166136261u;
+    while (*s)
+        hash = (hash ^ (uint8_t)*s++) * 16777619u;
+    return hash;
+}
+
+static void buildHash() {
+    for (hashSize = 1024; hashSize < symCnt; hashSize *= 2)
+        ;
+    heads = xrealloc(heads, hashSize * sizeof(uint32_t));
+    next  = xrealloc(next, (symCnt ? symCnt : 1) * sizeof(uint32_t));
+    memset(heads, 0xff, hashSize * sizeof(uint32_t));
+    for (uint32_t i = symCnt; i-- > 0;) { /* reverse so chains are in file order */
+        uint32_t h = hashName(pool + syms[i].name) & (hashSize - 1);
+        next[i]    = heads[h];
+        heads[h]   = i;
+    }
+}
+
+static void startModule(char const *name) {
+    if (modCnt >= modSize) {
+        modSize = modSize ? modSize * 2 : 256;
+        mods    = xrealloc(mods, modSize * sizeof(uint32_t));
+    }
+    mods[modCnt++] = poolAdd(*name ? name : "*Unnamed*");
+    if (segSize)
+        memset(segNames, 0xff, segSize * sizeof(uint32_t));
+}
+
+/* segment names are added to the pool the first time a module uses them */
+static uint32_t segName(uint16_t segIdx) {
+    if (segIdx >= segSize) {
+        uint32_t oldSize = segSize;
+        while (segIdx >= segSize)
+            segSize = segSize ? segSize * 2 : 256;
+        segNames = xrealloc(segNames, segSize * sizeof(uint32_t));
+        memset(segNames + oldSize, 0xff, (segSize - oldSize) * sizeof(uint32_t));
+    }
+    if (segNames[segIdx] == NONE)
+        segNames[segIdx] = poolAdd(getIndexName(ISEG, segIdx));
+    return segNames[segIdx];
+}
+
+static void addSym(char const *name, uint8_t kind, uint32_t seg, uint32_t offset) {
+    if (malformed || modCnt == 0)
+        return;
+    if (symCnt >= symSize) {
+        symSize = symSize ? symSize * 2 : 1024;
+        syms    = xrealloc(syms, symSize * sizeof(sym_t));
+    }
+    syms[symCnt++] = (sym_t){ poolAdd(name), seg, offset, (uint16_t)(modCnt - 1), kind, 0 };
+}
+
+static void skipBytes(int n) {
+    while (n-- > 0)
+        getu8();
+}
+
+/* OMF85 and OMF51 */
+static void index85(int spec) {
+    switch (recType) {
+    case 2: // MODHDR
+        dispatchTable[spec].init();
+        startModule(getName());
+        break;
+    case 0xe: // OMF51 SEGDEF
+    case 0xf:
+        while (spec != OMF85 && !atEndRec() && !malformed) {
+            uint8_t segId = getu8();
+            skipBytes(recType == 0xe ? 5 : 6);
+            getu16(); // size
+            char const *name = getName();
+            if (segId && !malformed)
+                setIndex(ISEG, segId, name);
+        }
+        break;
+    case 0x16: // PUBLICS
+    case 0x17:
+        if (spec == OMF85) {
+            uint32_t seg = segName(getu8());
+            while (!atEndRec() && !malformed) {
+                uint16_t offset = getu16();
+                addSym(getName(), SYM_PUBLIC, seg, offset);
+                getu8();
+            }
+        } else
+            while (!atEndRec() && !malformed) {
+                uint8_t segId   = getu8();
+                getu8();        // symInfo
+                uint32_t offset = recType & 1 ? getu24() : getu16();
+                getu8();
+                addSym(getName(), SYM_PUBLIC, segName(segId), offset);
+            }
+        break;
+    case 0x18: // EXTDEF
+    case 0x19:
+        while (!atEndRec() && !malformed) {
+            if (spec != OMF85)
+                skipBytes(recType & 1 ? 5 : 4);
+            addSym(getName(), SYM_EXTERN, NONE, 0);
+            if (spec == OMF85)
+                getu8();
+        }
+        break;
+    case 0x2e: // OMF85 COMNAM
+        while (spec == OMF85 && !atEndRec() && !malformed) {
+            uint8_t segId    = getu8();
+            char const *name = getName();
+            if (!malformed)
+                setIndex(ISEG, segId, name);
+        }
+        break;
+    }
+}
+
+static void index86() {
+    resolveFlavour();
+    switch (recType) {
+    case 0x6e: // RHEADR
+    case 0x80: // THEADR
+    case 0x82: // LHEADR
+        dispatchTable[OMF86].init();
+        nameIndex86 = segIndex86 = 1;
+        startModule(getName());
+        break;
+    case 0x96: // LNAMES
+    case 0xca: // LLNAMES
+        while (!atEndRec() && !malformed)
+            setIndex(INAME, nameIndex86++, getName());
+        break;
+    case 0x98: // SEGDEF
+    case 0x99:
+        {
+            uint8_t segAttr = getu8();
+            uint8_t a       = segAttr >> 5;
+            uint8_t c       = (segAttr >> 2) & 7;
+            if (omfFlavour == ANY && (a == 6 || c == 1 || c == 3))
+                omfFlavour = INTEL;
+            if (a == 0 || (a == 5 && omfFlavour == INTEL))
+                skipBytes(3);
+            else if (a == 6)
+                skipBytes(5);
+            skipBytes(recType & 1 ? 4 : 2);
+            if (a != 5 || omfFlavour != INTEL)
+                setIndex(ISEG, segIndex86, getIndexName(INAME, getIndex()));
+            segIndex86++;
+        }
+        break;
+    case 0x90: // PUBDEF
+    case 0x91:
+    case 0xb6: // LPUBDEF
+    case 0xb7:
+        {
+            uint8_t kind    = recType >= 0xb6 ? SYM_LOCAL : SYM_PUBLIC;
+            getIndex(); /* group */
+            uint16_t segIdx = getIndex();
+            uint32_t seg;
+            if (segIdx)
+                seg = segName(segIdx);
+            else { /* as base86, the frame is present whenever the segment index is 0 */
+                char frame[12];
+                sprintf(frame, "Frame %04X", getu16());
+                seg = poolAdd(frame);
+            }
+            while (!atEndRec() && !malformed) {
+                char const *name = getName();
+                uint32_t offset  = recType & 1 ? getu32() : getu16();
+                getIndex();
+                addSym(name, kind, seg, offset);
+            }
+        }
+        break;
+    case 0x8c: // EXTDEF
+    case 0xb4: // LEXTDEF
+    case 0xb5:
+        while (!atEndRec() && !malformed) {
+            char const *name = getName();
+            getIndex();
+            addSym(name, recType == 0x8c ? SYM_EXTERN : SYM_LEXTERN, NONE, 0);
+        }
+        break;
+    case 0xb0: // COMDEF
+    case 0xb8: // LCOMDEF
+        while (!atEndRec() && !malformed) {
+            char const *name = getName();
+            getIndex();
+            uint8_t dataType = getu8();
+            if (dataType == 0x61) // FAR has count and size
+                communalLen();
+            if (dataType == 0x61 || dataType == 0x62)
+                communalLen();
+            addSym(name, recType == 0xb0 ? SYM_COMMON : SYM_LOCAL, NONE, 0);
+        }
+        break;
+    }
+}
+
+static bool isIndexRec(int spec) {
+    if (spec == OMF86)
+        return strchr("\x6e\x80\x82\x96\xca\x98\x99\x90\x91\xb6\xb7\x8c\xb4\xb5\xb0\xb8", recType) !=
+               NULL;
+    return strchr("\x02\x0e\x0f\x16\x17\x18\x19\x2e", recType) != NULL;
+}
+
+static bool scanLibrary(char const *fname) {
+    int spec;
+    int len;
+
+    if (openInput(fname) == NULL) {
+        fprintf(stderr, "%s: can't open\n", fname);
+        return false;
+    }
+    if ((spec = detectOMF()) == OMFUKN || spec == OMF96) {
+        fprintf(stderr, "%s: only OMF85, OMF51 and OMF86 files can be indexed\n", fname);
+        fclose(src);
+        return false;
+    }
+    omfFlavour = ANY;
+    dispatchTable[spec].init();
+    while ((len = loadRecHdr()) >= 0) {
+        if (isIndexRec(spec)) {
+            if (loadRecBody(len) < 0)
+                break;
+            if (spec == OMF86)
+                index86();
+            else
+                index85(spec);
+        } else
+            skipRecBody(len);
+        if (recType == 0xe && spec == OMF85)
+            break;
+    }
+    fclose(src);
+    return true;
+}
+
+static bool readIndex(char const *idxFile, idxHdr_t const *want) {
+    FILE *fp;
+    idxHdr_t hdr;
+    bool ok = false;
+
+    if ((fp = fopen(idxFile, "rb")) == NULL)
+        return false;
+    if (fread(&hdr, sizeof(hdr), 1, fp) == 1 && memcmp(hdr.magic, want->magic, sizeof(hdr.magic)) == 0 &&
+        strcmp(hdr.version, want->version) == 0 && hdr.size == want->size &&
+        hdr.mtime == want->mtime) {
+        poolLen = poolSize = hdr.poolLen;
+        modCnt = modSize = hdr.modCnt;
+        symCnt = symSize = hdr.symCnt;
+        pool             = xrealloc(pool, poolSize + 1);
+        mods             = xrealloc(mods, (modSize + 1) * sizeof(uint32_t));
+        syms             = xrealloc(syms, (symSize + 1) * sizeof(sym_t));
+        ok = fread(pool, 1, poolLen, fp) == poolLen &&
+             fread(mods, sizeof(uint32_t), modCnt, fp) == modCnt &&
+             fread(syms, sizeof(sym_t), symCnt, fp) == symCnt;
+        for (uint32_t i = 0; ok && i < symCnt; i++) /* guard against a damaged index */
+            ok = syms[i].name < poolLen && syms[i].module < modCnt &&
+                 (syms[i].seg == NONE || syms[i].seg < poolLen) && syms[i].kind <= SYM_LEXTERN;
+        ok = ok && (poolLen == 0 || pool[poolLen - 1] == '\0');
+    }
+    fclose(fp);
+    if (!ok)
+        poolLen = modCnt = symCnt = 0;
+    return ok;
+}
+
+static void writeIndex(char const *idxFile, idxHdr_t *hdr) {
+    FILE *fp;
+    char *tmpName = xrealloc(NULL, strlen(idxFile) + 5);
+
+    hdr->poolLen = poolLen;
+    hdr->modCnt  = modCnt;
+    hdr->symCnt  = symCnt;
+    strcat(strcpy(tmpName, idxFile), ".tmp");
+    if ((fp = fopen(tmpName, "wb")) == NULL)
+        fprintf(stderr, "%s: can't create index\n", idxFile);
+    else {
+        fwrite(hdr, sizeof(*hdr), 1, fp);
+        fwrite(pool, 1, poolLen, fp);
+        fwrite(mods, sizeof(uint32_t), modCnt, fp);
+        fwrite(syms, sizeof(sym_t), symCnt, fp);
+        if (fclose(fp) == 0) {
+            remove(idxFile); /* rename won't replace on Windows */
+            if (rename(tmpName, idxFile) != 0)
+                fprintf(stderr, "%s: can't update index\n", idxFile);
+        } else
+            fprintf(stderr, "%s: error writing index\n", idxFile);
+    }
+    free(tmpName);
+}
+
+static bool loadIndex(char const *fname, char const *idxFile) {
+    struct stat st;
+    idxHdr_t hdr;
+
+    if (strcmp(fname, "-") == 0) /* stdin can't be indexed */
+        idxFile = NULL;
+    else if (stat(fname, &st) != 0) {
+        fprintf(stderr, "%s: can't access\n", fname);
+        return false;
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    strcpy(hdr.magic, IDXMAGIC);
+    strncpy(hdr.version, GIT_VERSION, sizeof(hdr.version) - 1);
+    if (idxFile) {
+        hdr.size  = (long long)st.st_size;
+        hdr.mtime = (long long)st.st_mtime;
+    }
+
+    if (!idxFile || !readIndex(idxFile, &hdr)) {
+        if (!scanLibrary(fname))
+            return false;
+        if (idxFile)
+            writeIndex(idxFile, &hdr);
+    }
+    buildHash();
+    return true;
+}
+
+static void showSym(sym_t const *sym) {
+    fprintf(dst, "  %-*s ", MAXNAME, pool + mods[sym->module]);
+    if (sym->seg != NONE)
+        fprintf(dst, "%-14s %s:%04X\n", kindNames[sym->kind], pool + sym->seg, sym->offset);
+    else
+        fprintf(dst, "%s\n", kindNames[sym->kind]);
+}
+
+static bool isDefinition(sym_t const *sym) {
+    return sym->kind <= SYM_COMMON;
+}
+
+/* an external is resolved by a public or common definition, or for a
+ * local external, by a local definition in the same module
+ */
+static bool isResolved(uint32_t ext) {
+    char const *name = pool + syms[ext].name;
+    for (uint32_t i = heads[hashName(name) & (hashSize - 1)]; i != NONE; i = next[i])
+        if (isDefinition(&syms[i]) && strcmp(pool + syms[i].name, name) == 0 &&
+            (syms[i].kind != SYM_LOCAL ||
+             (syms[ext].kind == SYM_LEXTERN && syms[i].module == syms[ext].module)))
+            return true;
+    return false;
+}
+
+static int cmpUnresolved(void const *a, void const *b) {
+    uint32_t ia = *(uint32_t const *)a;
+    uint32_t ib = *(uint32_t const *)b;
+    int cmp     = strcmp(pool + syms[ia].name, pool + syms[ib].name);
+    return cmp ? cmp : ia < ib ? -1 : ia > ib;
+}
+
+/* returns the exit code, 0 if the symbol was found or all externals are resolved */
+int symbolQuery(char const *fname, char const *idxFile, char const *where) {
+    int found = 0;
+
+    if (!loadIndex(fname, idxFile))
+        return 2;
+    dst = stdout;
+    if (where) {
+        fprintf(dst, "%s:\n", where);
+        for (uint32_t i = heads[hashName(where) & (hashSize - 1)]; i != NONE; i = next[i])
+            if (strcmp(pool + syms[i].name, where) == 0) {
+                showSym(&syms[i]);
+                found++;
+            }
+        if (!found)
+            fprintf(dst, "  not found\n");
+        return found ? 0 : 1;
+    }
+
+    uint32_t *unresolved = xrealloc(NULL, (symCnt ? symCnt : 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < symCnt; i++)
+        if (!isDefinition(&syms[i]) && !isResolved(i))
+            unresolved[found++] = i;
+    qsort(unresolved, found, sizeof(uint32_t), cmpUnresolved);
+    int names = 0;
+    for (int i = 0; i < found; i++)
+        if (i == 0 || strcmp(pool + syms[unresolved[i]].name, pool + syms[unresolved[i - 1]].name))
+            names++;
+    fprintf(dst, "%s: %d unresolved external%s\n", fname, names, names == 1 ? "" : "s");
+    for (int i = 0; i < found; i++) {
+        char const *name = pool + syms[unresolved[i]].name;
+        if (i == 0 || strcmp(name, pool + syms[unresolved[i - 1]].name) != 0)
+            fprintf(dst, "%s  %-*s", i ? "\n" : "", MAXNAME, name);
+        fprintf(dst, " %s", pool + mods[syms[unresolved[i]].module]);
+    }
+    if (found)
+        putc('\n', dst);
+    free(unresolved);
+    return found ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+/****************************************************************************
+ *  timing.c is part of dumpomf                                             *
+ *  Copyright (C) 2022 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+/*
+ * -T support
+ * Wall time is attributed to the current phase, which callers switch with
+ * setPhase, restoring the previous phase when done, so formatting and output
+ * done from within a decoder are not counted as decode time. Decode time is
+ * further split by the record type being decoded.
+ * When -T is not given, setPhase returns immediately.
+ */
+
+#include "omf.h"
+#include <time.h>
+
+bool timingMode;
+
+static char const *phaseNames[] = { "other", "read/CRC", "decode", "format", "output" };
+
+static int curPhase;
+static int curType;
+static double phaseTime[PH_COUNT];
+static uint64_t phaseBytes[PH_COUNT];
+static double typeTime[256];
+static uint32_t typeCnt[256];
+static uint64_t typeBytes[256];
+static uint32_t malformedCnt;
+static uint32_t internedCnt;
+static double startTime;
+static double lastTime;
+
+static double now() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void startTiming() {
+    if (timingMode)
+        startTime = lastTime = now();
+}
+
+int setPhase(int phase) {
+    if (!timingMode)
+        return PH_OTHER;
+    int oldPhase  = curPhase;
+    double t      = now();
+    phaseTime[curPhase] += t - lastTime;
+    if (curPhase == PH_DECODE)
+        typeTime[curType] += t - lastTime;
+    lastTime = t;
+    curPhase = phase;
+    return oldPhase;
+}
+
+void countBytes(int phase, size_t n) {
+    phaseBytes[phase] += n;
+}
+
+/* records are counted as they are dispatched, this also sets the type decode time is charged to */
+void countRecord(int type, uint16_t len) {
+    curType = type;
+    typeCnt[type]++;
+    typeBytes[type] += len + 3;
+    phaseBytes[PH_DECODE] += len + 3;
+}
+
+void countMalformed() {
+    malformedCnt++;
+}
+
+void countInterned() {
+    internedCnt++;
+}
+
+static void showTime(char const *label, double t, uint64_t bytes) {
+    fprintf(stderr, "%-12s %10.3f %12llu", label, t * 1000, (unsigned long long)bytes);
+    if (t > 0 && bytes)
+        fprintf(stderr, " %10.1f", bytes / t / (1024 * 1024));
+    putc('\n', stderr);
+}
+
+void timingReport(int spec) {
+    uint32_t records = 0;
+
+    if (!timingMode)
+        return;
+    setPhase(PH_OTHER);
+    for (int i = 0; i < 256; i++)
+        records += typeCnt[i];
+
+    fprintf(stderr, "%-12s %10s %12s %10s\n", "Phase", "ms", "Bytes", "MB/s");
+    for (int i = 0; i < PH_COUNT; i++)
+        showTime(phaseNames[i], phaseTime[i], phaseBytes[i]);
+    showTime("total", lastTime - startTime, 0);
+    fprintf(stderr, "\nRecords %u, malformed %u, names interned %u\n", records, malformedCnt,
+            internedCnt);
+    if (records == 0)
+        return;
+    fprintf(stderr, "\n%-12s %4s %8s %10s %12s\n", "Decode", "Type", "Count", "ms", "Bytes");
+    for (int i = 0; i < 256; i++)
+        if (typeCnt[i])
+            fprintf(stderr, "%-12s  %02X %8u %10.3f %12llu\n", lookupDecode(spec, i)->name, i,
+                    typeCnt[i], typeTime[i] * 1000, (unsigned long long)typeBytes[i]);
+}
@@ -114,13 +114,183 @@ char const *structLabels[] = { "bits: ", " members: ", " types: ", " names: ", N
 char const *arrayLabels[]  = { "bits: ", " type: ", NULL };
 char const * noLabels[] = { NULL };
 
-void descriptor86() {
+/*
+ * each TYPDEF's leaves are kept for the current module so that type indexes
+ * used by EXTDEF, PUBDEF, LOCSYM, BLKDEF and DEBSYM can be shown resolved.
+ * A type is rendered the first time it is used, with any type indexes it
+ * references replaced by their rendered form, and the string is cached in the
+ * module's name space, so each later use costs O(1).
+ * Rendering walks the type graph with an explicit stack, a reference back to
+ * a type still being rendered is shown as @n, which handles recursive types.
+ */
+#define MAXTYPESTR 80     /* keeps a rendered type within the line buffer */
+#define MAXTYPEIDX 0x7fff /* largest OMF86 index */
+
+typedef struct {
+    uint8_t leaf;
+    bool predef;
+    int32_t val;
+    char const *str;
+} leaf86_t;
+
+enum { UNRESOLVED = 0, RENDERING, RESOLVED };
+
+typedef struct {
+    uint32_t first; /* index into leaves */
+    uint16_t count;
+    uint8_t state;
+    char const *str;
+} type86_t;
+
+typedef struct {
+    uint16_t typeIdx;
+    uint16_t next; /* next leaf to check for a reference */
+} frame86_t;
+
+static leaf86_t *leaves;
+static uint32_t leafCnt;
+static uint32_t leafSize;
+static type86_t *types;
+static uint32_t typeCnt;
+static uint32_t typeSize;
+static frame86_t *stack;
+static uint32_t stackSize;
+
+void resetTypes86() {
+    leafCnt = 0;
+    typeCnt = 0;
+}
+
+static char const *fmtLeaf(char *buf, leaf86_t const *l) {
+    if (l->predef)
+        return leaf86Names[l->leaf - FAR];
+    if (l->leaf < 128 || l->leaf == 129 || l->leaf == 132)
+        sprintf(buf, "%u", (uint32_t)l->val);
+    else
+        switch (l->leaf) {
+        case 128:
+            return "nil";
+        case 130:
+            sprintf(buf, "'%s'", l->str);
+            break;
+        case 131:
+            sprintf(buf, "@%u", (uint32_t)l->val);
+            break;
+        case 133:
+            return "*";
+        case 134:
+        case 135:
+        case 136:
+            sprintf(buf, "%d", l->val);
+            break;
+        default:
+            sprintf(buf, "leaf %d", l->leaf);
+            break;
+        }
+    return buf;
+}
+
+static void addLeaf(uint16_t typeIdx, leaf86_t const *l) {
+    if (typeIdx == 0 || typeIdx > MAXTYPEIDX)
+        return;
+    if (typeIdx >= typeSize) {
+        uint32_t oldSize = typeSize;
+        while (typeIdx >= typeSize)
+            typeSize = typeSize ? typeSize * 2 : 256;
+        types = xrealloc(types, typeSize * sizeof(type86_t));
+        memset(types + oldSize, 0, (typeSize - oldSize) * sizeof(type86_t));
+    }
+    if (typeIdx >= typeCnt) { /* first leaf of a new type */
+        while (typeCnt <= typeIdx)
+            types[typeCnt++] = (type86_t){ leafCnt, 0, UNRESOLVED, NULL };
+    }
+    if (leafCnt >= leafSize) {
+        leafSize = leafSize ? leafSize * 2 : 1024;
+        leaves   = xrealloc(leaves, leafSize * sizeof(leaf86_t));
+    }
+    leaves[leafCnt++] = *l;
+    types[typeIdx].count++;
+}
+
+static bool isTypeRef(leaf86_t const *l) {
+    return l->leaf == 131 && !l->predef && 0 < l->val && l->val < typeCnt && types[l->val].count;
+}
+
+static void appendStr(char *buf, int *len, char const *s) {
+    while (*s && *len < MAXTYPESTR)
+        buf[(*len)++] = *s++;
+    if (*s)
+        strcpy(buf + MAXTYPESTR - 3, "..."), *len = MAXTYPESTR;
+}
+
+static void renderType(uint16_t typeIdx) {
+    type86_t *t = &types[typeIdx];
+    char buf[MAXTYPESTR + 1];
+    char tmp[260];
+    int len = 0;
+
+    for (uint32_t i = t->first; i < t->first + t->count; i++) {
+        if (len)
+            appendStr(buf, &len, " ");
+        if (isTypeRef(&leaves[i]) && types[leaves[i].val].state == RESOLVED) {
+            appendStr(buf, &len, "(");
+            appendStr(buf, &len, types[leaves[i].val].str);
+            appendStr(buf, &len, ")");
+        } else
+            appendStr(buf, &len, fmtLeaf(tmp, &leaves[i]));
+    }
+    t->str   = pstrdup(len, buf);
+    t->state = RESOLVED;
+}
+
+/* returns the rendered type or NULL if the type index is not defined */
+char const *typeStr86(uint16_t typeIdx) {
+    if (typeIdx == 0 || typeIdx >= typeCnt || types[typeIdx].count == 0)
+        return NULL;
+    if (types[typeIdx].state == RESOLVED)
+        return types[typeIdx].str;
+
+    uint32_t sp = 0;
+    if (stackSize < typeCnt) {
+        stackSize = typeCnt;
+        stack     = xrealloc(stack, stackSize * sizeof(frame86_t));
+    }
+    stack[sp++]            = (frame86_t){ typeIdx, 0 };
+    types[typeIdx].state   = RENDERING;
+    while (sp) {
+        frame86_t *f = &stack[sp - 1];
+        type86_t *t  = &types[f->typeIdx];
+        while (f->next < t->count) {
+            leaf86_t const *l = &leaves[t->first + f->next++];
+            if (isTypeRef(l) && types[l->val].state == UNRESOLVED) {
+                types[l->val].state = RENDERING;
+                stack[sp++]         = (frame86_t){ (uint16_t)l->val, 0 };
+                break;
+            }
+        }
+        if (f == &stack[sp - 1]) { /* all references resolved */
+            renderType(f->typeIdx);
+            sp--;
+        }
+    }
+    return types[typeIdx].str;
+}
+
+/* if known, add the resolved type after the @n shown in the record */
+void addTypeStr86(uint16_t typeIdx) {
+    char const *str = typeStr86(typeIdx);
+    if (str)
+        add(" {%s}", str);
+}
+
+void descriptor86(uint16_t typeIdx) {
     char const **labels = noLabels;
     uint8_t labelIndex  = 0;
     uint8_t pattern     = 0;
     uint8_t patBit      = 0;
     bool isFirst        = true;
-    uint16_t val;
+    leaf86_t l;
+    char tmp[260];
 
     uint8_t en;
     uint8_t enMsk = 0;
@@ -171,47 +341,34 @@ void descriptor86() {
                 isFirst = false;
             }
         }
-        if (FAR <= leaf && leaf <= LIST && !(pattern & patBit))
-            add("%s", leaf86Names[leaf - FAR]);
-        else if (leaf < 128)
-            add("%u", leaf);
-        else
+        l = (leaf86_t){ leaf, FAR <= leaf && leaf <= LIST && !(pattern & patBit), leaf, NULL };
+        if (!l.predef && leaf >= 128)
             switch (leaf) {
-            case 128:
-                add("nil");
-                break;
             case 129:
-                add("%u", getu16());
+                l.val = getu16();
                 break;
             case 130:
-                add("'%s'", getName());
+                l.str = getName();
                 break;
             case 131:
-                val = getIndex();
-                if (val < 10)
-                    add("@%u", val);
-                else
-                    add("@%u", val);
+                l.val = getIndex();
                 break;
             case 132:
-                add("%u", getu24());
-                break;
-            case 133:
-                add("*");
+                l.val = getu24();
                 break;
             case 134:
-                add("%d", geti8());
+                l.val = geti8();
                 break;
             case 135:
-                add("%d", geti16());
+                l.val = geti16();
                 break;
             case 136:
-                add("%d", geti32());
-                break;
-            default:
-                add("leaf %d", leaf);
+                l.val = geti32();
                 break;
             }
+        add("%s", fmtLeaf(tmp, &l));
+        if (!malformed)
+            addLeaf(typeIdx, &l);
         patBit >>= 1;
         add(" ");
     }
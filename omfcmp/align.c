@@ -0,0 +1,387 @@
+/****************************************************************************
+ *                                                                          *
+ *  omfcmp: compare two omf85 files                                         *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+/*
+ * -a and -A support
+ * Comparing content by address reports every byte after an insertion or
+ * deletion as different. Instead the content of each segment is taken as a
+ * byte stream in address order and the streams are aligned using Myers'
+ * O(ND) difference algorithm, so only the bytes inserted, deleted or changed
+ * are reported. Fixups are compared after mapping the left locations through
+ * the alignment, so those that move with the content are not reported either.
+ * With -A the fixups of the two segments are aligned first, see matchAnchors,
+ * and the streams are split at the locations of matching fixups, which keeps
+ * each alignment small and stops unrelated bytes that happen to match from
+ * pulling the alignment out of step.
+ * If the streams are too different to align cheaply the caller falls back to
+ * comparing by address.
+ */
+
+#include "omfcmp.h"
+#include <limits.h>
+
+#define MAXEDITS    2000        // the most edits looked for when aligning a span
+
+int alignMode;
+
+typedef struct {
+    int x, y, len;          // a run of len matching items at x and y
+} run_t;
+
+typedef struct {
+    int cnt;
+    int size;
+    run_t *items;
+} runs_t;
+
+typedef struct {
+    byte *l, *r;
+} bytePair_t;
+
+typedef struct {
+    stream_t *l, *r;
+    match_t match;
+    void *arg;
+} anchorArg_t;
+
+
+void addStreamByte(stream_t *s, byte c, uint32_t addr)
+{
+    if (s->len >= s->size) {
+        s->size = s->size ? s->size * 2 : 1024;
+        s->bytes = (byte *)xrealloc(s->bytes, s->size);
+        s->addrs = (uint32_t *)xrealloc(s->addrs, s->size * sizeof(uint32_t));
+    }
+    s->bytes[s->len] = c;
+    s->addrs[s->len++] = addr;
+}
+
+static int streamPos(stream_t *s, uint32_t addr)    // returns -1 if there is no content at addr
+{
+    int lo = 0, hi = s->len - 1, mid;
+
+    while (lo <= hi) {
+        mid = (lo + hi) / 2;
+        if (s->addrs[mid] == addr)
+            return mid;
+        if (s->addrs[mid] < addr)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return -1;
+}
+
+/* addrs are the fixup locations in the order the fixups are aligned */
+void setFixupPos(stream_t *s, uint32_t *addrs, int cnt)
+{
+    s->fixPos = (int *)xmalloc((cnt + 1) * sizeof(int));
+    s->fixCnt = cnt;
+    for (int i = 0; i < cnt; i++)
+        s->fixPos[i] = streamPos(s, addrs[i]);
+}
+
+void deleteStream(stream_t *s)
+{
+    free(s->bytes);
+    free(s->addrs);
+    free(s->fixPos);
+}
+
+static void addRun(runs_t *runs, int x, int y, int len)
+{
+    if (runs->cnt >= runs->size) {
+        runs->size = runs->size ? runs->size * 2 : 64;
+        runs->items = (run_t *)xrealloc(runs->items, runs->size * sizeof(run_t));
+    }
+    runs->items[runs->cnt++] = (run_t){ x, y, len };
+}
+
+/*
+ * Myers' O(ND) difference algorithm
+ * v[k] is the furthest x reached on diagonal k = x - y with d edits. Row d of
+ * v is kept in trace, at trace + d * d, so the path can be traced back from
+ * n, m. The matching runs are added to runs in ascending order, offset by
+ * xbase and ybase. Returns 0 if more than MAXEDITS edits are needed.
+ */
+static int alignSeq(int n, int m, match_t match, void *arg, runs_t *runs, int xbase, int ybase)
+{
+    int limit = n + m < MAXEDITS ? n + m : MAXEDITS;
+    int *vbuf = (int *)xmalloc((2 * limit + 3) * sizeof(int));
+    int *v = vbuf + limit + 1;
+    int *trace = NULL;
+    size_t traceSize = 0;
+    int d, k, x, y, xs, pk;
+    int first = runs->cnt;
+    int found = 0;
+
+    v[1] = 0;
+    for (d = 0; d <= limit && !found; d++) {
+        for (k = -d; k <= d; k += 2) {
+            if (k == -d || (k != d && v[k - 1] < v[k + 1]))
+                x = v[k + 1];           // insertion
+            else
+                x = v[k - 1] + 1;       // deletion
+            y = x - k;
+            if (x < n && y < m)
+                x += match(arg, x, y, n - x < m - y ? n - x : m - y);
+            v[k] = x;
+            if (x >= n && x - k >= m)
+                found = 1;
+        }
+        if ((size_t)(d + 1) * (d + 1) > traceSize) {
+            traceSize = traceSize ? traceSize * 2 : 1024;
+            while ((size_t)(d + 1) * (d + 1) > traceSize)
+                traceSize *= 2;
+            trace = (int *)xrealloc(trace, traceSize * sizeof(int));
+        }
+        memcpy(trace + d * d, v - d, (2 * d + 1) * sizeof(int));
+    }
+    free(vbuf);
+    if (!found) {
+        free(trace);
+        return 0;
+    }
+
+    x = n;
+    y = m;
+    for (d--; d > 0; d--) {
+        int *prev = trace + (d - 1) * (d - 1) + d - 1;    // row d - 1 indexed by k
+        k = x - y;
+        if (k == -d || (k != d && prev[k - 1] < prev[k + 1]))
+            xs = prev[pk = k + 1];
+        else
+            xs = prev[pk = k - 1] + 1;
+        if (x > xs)
+            addRun(runs, xbase + xs, ybase + xs - k, x - xs);
+        x = prev[pk];
+        y = x - pk;
+    }
+    if (x > 0)
+        addRun(runs, xbase, ybase, x);
+    free(trace);
+
+    for (int i = first, j = runs->cnt - 1; i < j; i++, j--) {   // the runs were found last first
+        run_t tmp = runs->items[i];
+        runs->items[i] = runs->items[j];
+        runs->items[j] = tmp;
+    }
+    return 1;
+}
+
+static int matchBytes(void *arg, int x, int y, int len)
+{
+    bytePair_t *p = arg;
+
+    return sameLength(p->l + x, p->r + y, len);
+}
+
+/*
+ * aligns l[ls..le) with r[rs..re), trimming the common head and tail first
+ * returns 0 if the rest is too different to align, when it is left as one hunk
+ */
+static int alignSpan(stream_t *l, int ls, int le, stream_t *r, int rs, int re, runs_t *runs)
+{
+    bytePair_t p;
+    int head, tail = 0;
+    int ok;
+
+    head = sameLength(l->bytes + ls, r->bytes + rs, le - ls < re - rs ? le - ls : re - rs);
+    if (head)
+        addRun(runs, ls, rs, head);
+    ls += head;
+    rs += head;
+    while (le - tail > ls && re - tail > rs && l->bytes[le - tail - 1] == r->bytes[re - tail - 1])
+        tail++;
+    p.l = l->bytes + ls;
+    p.r = r->bytes + rs;
+    ok = ls == le - tail || rs == re - tail || alignSeq(le - tail - ls, re - tail - rs, matchBytes, &p, runs, ls, rs);
+    if (tail)
+        addRun(runs, le - tail, re - tail, tail);
+    return ok;
+}
+
+static int sameLeadIn(stream_t *l, int x, stream_t *r, int y)  // same content since the previous fixup
+{
+    int ls = x ? l->fixPos[x - 1] : 0;
+    int rs = y ? r->fixPos[y - 1] : 0;
+    int len = l->fixPos[x] - ls;
+
+    return ls >= 0 && rs >= 0 && l->fixPos[x] >= 0 && r->fixPos[y] - rs == len
+        && memcmp(l->bytes + ls, r->bytes + rs, len) == 0;
+}
+
+/*
+ * fixups to the same target are common, so to be an anchor a fixup must also
+ * have the same content leading up to it, otherwise a fixup added to one side
+ * could put all the following anchors out of step
+ */
+static int matchAnchors(void *arg, int x, int y, int len)
+{
+    anchorArg_t *a = arg;
+    int i = 0;
+
+    while (i < len && a->match(a->arg, x + i, y + i, 1) && sameLeadIn(a->l, x + i, a->r, y + i))
+        i++;
+    return i;
+}
+
+/* the hunks are the gaps between the matching runs of sequences of length n and m */
+static int runsToHunks(runs_t *runs, int n, int m, hunk_t **hunks)
+{
+    int x = 0, y = 0;
+    int cnt = 0;
+
+    addRun(runs, n, m, 0);          // sentinel for the tail
+    *hunks = (hunk_t *)xmalloc(runs->cnt * sizeof(hunk_t));
+    for (int i = 0; i < runs->cnt; i++) {
+        if (runs->items[i].x > x || runs->items[i].y > y)
+            (*hunks)[cnt++] = (hunk_t){ x, runs->items[i].x - x, y, runs->items[i].y - y };
+        x = runs->items[i].x + runs->items[i].len;
+        y = runs->items[i].y + runs->items[i].len;
+    }
+    return cnt;
+}
+
+/*
+ * aligns the two streams, anchored on the matching fixups if fixMatch is given
+ * returns the number of hunks, or -1 if the streams are too different to align
+ * a span between anchors that is too different to align is reported as one hunk
+ */
+int alignStreams(stream_t *l, stream_t *r, match_t fixMatch, void *fixArg, hunk_t **hunks)
+{
+    runs_t anchors = { 0 }, runs = { 0 };
+    anchorArg_t anchorArg = { l, r, fixMatch, fixArg };
+    int lpos = 0, rpos = 0;
+    int cnt;
+
+    if (fixMatch && l->fixCnt && r->fixCnt && !alignSeq(l->fixCnt, r->fixCnt, matchAnchors, &anchorArg, &anchors, 0, 0))
+        anchors.cnt = 0;        // too different to anchor on
+    for (int i = 0; i < anchors.cnt; i++)
+        for (int j = 0; j < anchors.items[i].len; j++) {
+            int lp = l->fixPos[anchors.items[i].x + j];
+            int rp = r->fixPos[anchors.items[i].y + j];
+            if (lp > lpos && rp > rpos) {       // skips fixups not on content or out of step
+                alignSpan(l, lpos, lp, r, rpos, rp, &runs);
+                lpos = lp;
+                rpos = rp;
+            }
+        }
+    if (alignSpan(l, lpos, l->len, r, rpos, r->len, &runs) || lpos)
+        cnt = runsToHunks(&runs, l->len, r->len, hunks);
+    else
+        cnt = -1;
+    free(anchors.items);
+    free(runs.items);
+    return cnt;
+}
+
+/* returns where left stream position pos is in the right stream, -1 if it was deleted or replaced */
+static int alignedPos(hunk_t *hunks, int cnt, int pos)
+{
+    int lo = 0, hi = cnt - 1, mid;
+    hunk_t *h = NULL;
+
+    if (pos < 0)
+        return -1;
+    while (lo <= hi) {          // find the last hunk starting at or before pos
+        mid = (lo + hi) / 2;
+        if (hunks[mid].lstart <= pos) {
+            h = &hunks[mid];
+            lo = mid + 1;
+        }
+        else
+            hi = mid - 1;
+    }
+    if (!h)
+        return pos;
+    if (pos < h->lstart + h->llen)     // a like for like replacement keeps its positions
+        return h->llen == h->rlen ? h->rstart + pos - h->lstart : -1;
+    return pos - (h->lstart + h->llen) + h->rstart + h->rlen;
+}
+
+/*
+ * merges the fixups, in location order, using the aligned left locations
+ * missing is called for each fixup only on one side, match checks the rest of a pair
+ */
+void alignFixups(stream_t *l, stream_t *r, hunk_t *hunks, int cnt, match_t match, void *arg,
+                 void (*missing)(void *arg, int index, int left))
+{
+    int i = 0, j = 0;
+    int lp, rp;
+
+    while (i < l->fixCnt || j < r->fixCnt) {
+        lp = i < l->fixCnt ? alignedPos(hunks, cnt, l->fixPos[i]) : INT_MAX;
+        rp = j < r->fixCnt ? r->fixPos[j] : INT_MAX;
+        if (lp < 0 || (lp < rp && rp >= 0))
+            missing(arg, i++, 1);
+        else if (rp < 0 || lp > rp)
+            missing(arg, j++, 0);
+        else if (!match(arg, i, j, 1)) {
+            missing(arg, i++, 1);
+            missing(arg, j++, 0);
+        }
+        else {
+            i++;
+            j++;
+        }
+    }
+}
+
+static uint32_t hunkAddr(stream_t *s, int start)   // an empty hunk at the end is just after the last byte
+{
+    if (start < s->len)
+        return s->addrs[start];
+    return s->len ? s->addrs[s->len - 1] + 1 : 0;
+}
+
+static char *hunkBytes(stream_t *s, int start, int len, char *buf) // the first MAXRUN bytes, NULL if none
+{
+    char *t = buf;
+
+    if (len == 0)
+        return NULL;
+    for (int i = 0; i < len && i < MAXRUN; i++)
+        t += sprintf(t, i ? " %02X" : "%02X", s->bytes[start + i]);
+    if (len > MAXRUN)
+        strcpy(t, " ...");
+    return buf;
+}
+
+void emitHunk(byte *segment, stream_t *l, stream_t *r, hunk_t *h)
+{
+    char lbuf[MAXRUN * 3 + 4], rbuf[MAXRUN * 3 + 4];
+    char const *kind = h->rlen == 0 ? "deleted" : h->llen == 0 ? "inserted" : "changed";
+    char *lbytes = hunkBytes(l, h->lstart, h->llen, lbuf);
+    char *rbytes = hunkBytes(r, h->rstart, h->rlen, rbuf);
+    uint32_t laddr = hunkAddr(l, h->lstart);
+    uint32_t raddr = hunkAddr(r, h->rstart);
+
+    if (jsonMode)
+        jsonHunk(segment, kind, laddr, h->llen, lbytes, raddr, h->rlen, rbytes);
+    else if (h->llen == h->rlen)
+        printf("%04X %s : %04X %s - %d bytes changed\n", laddr, lbytes, raddr, rbytes, h->llen);
+    else if (h->llen && h->rlen)
+        printf("%04X %s : %04X %s - %d : %d bytes changed\n", laddr, lbytes, raddr, rbytes, h->llen, h->rlen);
+    else
+        printf("%04X %s : %04X %s - %d bytes %s\n", laddr, lbytes ? lbytes : "--", raddr, rbytes ? rbytes : "--",
+               h->llen + h->rlen, kind);
+}
@@ -0,0 +1,56 @@
+/****************************************************************************
+ *                                                                          *
+ *  omfcmp: compare two omf85 files                                         *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+#pragma once
+
+/*
+ * the content of a segment as a byte stream in address order, with the
+ * address of each byte and the stream position of each fixup, in address
+ * order, -1 if the fixup is not on content
+ */
+typedef struct {
+    byte *bytes;
+    uint32_t *addrs;
+    int len;
+    int size;
+    int *fixPos;
+    int fixCnt;
+} stream_t;
+
+/* returns the length of the common run starting at items x and y, at most len */
+typedef int (*match_t)(void *arg, int x, int y, int len);
+
+/* a difference between aligned streams, llen items at lstart replaced by rlen items at rstart */
+typedef struct {
+    int lstart, llen;
+    int rstart, rlen;
+} hunk_t;
+
+enum { ALIGNOFF, ALIGNBYTES, ALIGNFIXUPS };
+extern int alignMode;      // -a ALIGNBYTES, -A ALIGNFIXUPS
+
+void addStreamByte(stream_t *s, byte c, uint32_t addr);
+void setFixupPos(stream_t *s, uint32_t *addrs, int cnt);
+void deleteStream(stream_t *s);
+int alignStreams(stream_t *l, stream_t *r, match_t fixMatch, void *fixArg, hunk_t **hunks);
+void alignFixups(stream_t *l, stream_t *r, hunk_t *hunks, int cnt, match_t match, void *arg,
+                 void (*missing)(void *arg, int index, int left));
+void emitHunk(byte *segment, stream_t *l, stream_t *r, hunk_t *h);
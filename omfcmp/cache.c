@@ -0,0 +1,202 @@
+/****************************************************************************
+ *                                                                          *
+ *  omfcmp: compare two omf85 files                                         *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+/*
+ * -c cachefile support
+ * The cache holds a fingerprint for each module compared, keyed on the file
+ * name as given and the module's offset in the file. An entry is only used
+ * while the module's length and a hash of its raw bytes are unchanged, which
+ * unlike the file's modification time also catches a rebuild within the same
+ * second, and is still much cheaper than parsing the module.
+ * New entries are appended a line at a time, so forked workers can add to the
+ * file without any coordination, and a later line for the same module
+ * replaces an earlier one. When most of the lines have been superseded the
+ * file is rewritten on loading.
+ */
+
+#include "omfcmp.h"
+
+#define CACHETAG    "# omfcmp fingerprints v2"
+
+typedef struct {
+    char *path;
+    int offset;
+    int size;               // of the module
+    uint64_t rawHash;       // of the module's bytes
+    uint64_t fingerprint;
+} centry_t;
+
+static char *cachePath;
+static FILE *cacheFp;
+static centry_t *entries;
+static int entryCnt;
+static int entrySize;
+static int *hashTable;	// index into entries, -1 if empty
+static int hashSize;
+
+static unsigned hashKey(char *path, int offset)	// FNV-1a of the path and offset
+{
+    unsigned hash = 2166136261u;
+
+    while (*path)
+        hash = (hash ^ (byte)*path++) * 16777619u;
+    return (hash ^ (unsigned)offset) * 16777619u;
+}
+
+static int *lookupSlot(char *path, int offset)
+{
+    int i = hashKey(path, offset) & (hashSize - 1);
+
+    while (hashTable[i] >= 0 && (entries[hashTable[i]].offset != offset || strcmp(entries[hashTable[i]].path, path) != 0))
+        i = (i + 1) & (hashSize - 1);
+    return &hashTable[i];
+}
+
+static uint64_t hashModule(omf_t *omf)
+{
+    return hashFinal(hashBytes(0x9E3779B97F4A7C15ULL ^ (uint64_t)omf->size, omf->image, omf->size));
+}
+
+static void setEntry(char *path, int offset, int size, uint64_t rawHash, uint64_t fingerprint)
+{
+    int *slot;
+    int i;
+
+    if (entryCnt * 2 >= hashSize) {		// grow and rehash
+        hashSize = hashSize ? hashSize * 2 : 1024;
+        hashTable = (int *)xrealloc(hashTable, hashSize * sizeof(int));
+        for (i = 0; i < hashSize; i++)
+            hashTable[i] = -1;
+        for (i = 0; i < entryCnt; i++)
+            *lookupSlot(entries[i].path, entries[i].offset) = i;
+    }
+    slot = lookupSlot(path, offset);
+    if (*slot < 0) {
+        if (entryCnt >= entrySize) {
+            entrySize = entrySize ? entrySize * 2 : 1024;
+            entries = (centry_t *)xrealloc(entries, entrySize * sizeof(centry_t));
+        }
+        entries[entryCnt].path = strcpy((char *)xmalloc(strlen(path) + 1), path);
+        entries[entryCnt].offset = offset;
+        *slot = entryCnt++;
+    }
+    entries[*slot].size = size;
+    entries[*slot].rawHash = rawHash;
+    entries[*slot].fingerprint = fingerprint;
+}
+
+/* returns the number of entry lines, or -1 if the file is missing or from another version */
+static int loadCache()
+{
+    FILE *fp;
+    char line[4096];
+    unsigned long long fingerprint, rawHash;
+    int size, offset, pos;
+    int lines = 0;
+
+    if ((fp = fopen(cachePath, "r")) == NULL)
+        return -1;
+    if (!fgets(line, sizeof(line), fp) || strncmp(line, CACHETAG, strlen(CACHETAG)) != 0) {
+        fclose(fp);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (sscanf(line, "%llx %llx %d %d %n", &fingerprint, &rawHash, &size, &offset, &pos) == 4 && line[pos]) {
+            setEntry(line + pos, offset, size, rawHash, fingerprint);
+            lines++;
+        }
+    }
+    fclose(fp);
+    return lines;
+}
+
+static void writeEntry(FILE *fp, centry_t *entry)
+{
+    fprintf(fp, "%016llx %016llx %d %d %s\n", (unsigned long long)entry->fingerprint,
+            (unsigned long long)entry->rawHash, entry->size, entry->offset, entry->path);
+}
+
+static void rewriteCache()
+{
+    FILE *fp;
+    char *tmpName = (char *)xmalloc(strlen(cachePath) + 5);
+
+    strcat(strcpy(tmpName, cachePath), ".tmp");
+    if ((fp = fopen(tmpName, "w")) == NULL)
+        fprintf(stderr, "%s: can't create fingerprint cache\n", cachePath);
+    else {
+        fprintf(fp, CACHETAG "\n");
+        for (int i = 0; i < entryCnt; i++)
+            writeEntry(fp, &entries[i]);
+        if (fclose(fp) == 0) {
+            remove(cachePath);			// rename won't replace on Windows
+            if (rename(tmpName, cachePath) != 0)
+                fprintf(stderr, "%s: can't update fingerprint cache\n", cachePath);
+        }
+        else
+            fprintf(stderr, "%s: error writing fingerprint cache\n", cachePath);
+    }
+    free(tmpName);
+}
+
+void openCache(char *path)
+{
+    int lines;
+
+    cachePath = path;
+    if ((lines = loadCache()) < 0 || lines > entryCnt * 2 + 64)
+        rewriteCache();
+    if ((cacheFp = fopen(cachePath, "a")) == NULL)
+        fprintf(stderr, "%s: can't update fingerprint cache\n", cachePath);
+}
+
+int cacheEnabled()
+{
+    return cachePath != NULL;
+}
+
+/* returns 1 and the fingerprint if there is a current entry for the module */
+int findFingerprint(omf_t *omf, uint64_t *fingerprint)
+{
+    centry_t *entry;
+    int idx;
+
+    if (!hashSize || (idx = *lookupSlot(omf->file->name, omf->offset)) < 0)
+        return 0;
+    entry = &entries[idx];
+    if (entry->size != omf->size || entry->rawHash != hashModule(omf))
+        return 0;
+    *fingerprint = entry->fingerprint;
+    return 1;
+}
+
+void saveFingerprint(omf_t *omf, uint64_t fingerprint)
+{
+    if (!cachePath)
+        return;
+    setEntry(omf->file->name, omf->offset, omf->size, hashModule(omf), fingerprint);
+    if (cacheFp) {
+        writeEntry(cacheFp, &entries[*lookupSlot(omf->file->name, omf->offset)]);
+        fflush(cacheFp);			// one write per line, so workers' lines don't interleave
+    }
+}
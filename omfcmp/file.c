@@ -21,16 +21,93 @@
  ****************************************************************************/
 
 #include "omfcmp.h"
+#include <sys/stat.h>
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
-file_t *newFile(char *fn)
+/* sum of bytes modulo 256, eight bytes at a time */
+static byte sumBytes(byte *s, int len)
+{
+    uint64_t chunk;
+    byte sum = 0;
+
+    for (; len >= 8; s += 8, len -= 8) {
+        memcpy(&chunk, s, 8);
+        /* add pairs of bytes into four 16 bit sums, which can't carry into each other,
+         * then fold those, the low byte of the result being the sum of all eight
+         */
+        chunk = (chunk & 0x00ff00ff00ff00ffULL) + ((chunk >> 8) & 0x00ff00ff00ff00ffULL);
+        chunk += chunk >> 16;
+        chunk += chunk >> 32;
+        sum += (byte)chunk;
+    }
+    while (len-- > 0)
+        sum += *s++;
+    return sum;
+}
+
+/*
+ * walk the records from the start of the file, marking each one whose checksum
+ * is valid. getRecord trusts a marked record and only recomputes the checksum
+ * for anything else, which is either bad or not on this chain.
+ * This is done when the file is first parsed, so files that are only compared
+ * byte for byte or hashed are never checked
+ */
+void checkRecords(file_t *fi)
+{
+    int pos, len;
+
+    if (fi->crcOk)
+        return;
+    fi->crcOk = (byte *)xcalloc(fi->size / 8 + 1, 1);
+    for (pos = 0; pos + 3 <= fi->size; pos += len + 3) {
+        len = fi->image[pos + 1] + fi->image[pos + 2] * 256;
+        if (pos + len + 3 > fi->size)
+            break;
+        if (sumBytes(fi->image + pos, len + 3) == 0)
+            fi->crcOk[pos / 8] |= 1 << (pos % 8);
+    }
+}
+
+#ifndef _MSC_VER
+file_t *newFile(char *fn)				// returns NULL after reporting the error if the file can't be read
+{
+    int fd;
+    struct stat st;
+    void *image;
+    file_t *fi = NULL;
+
+    if ((fd = open(fn, O_RDONLY)) < 0) {
+        fprintf(stderr, "can't open %s\n", fn);
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || st.st_size > INT32_MAX
+        || (image = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+        fprintf(stderr, "error reading %s\n", fn);
+    else {
+        fi = (file_t *)xmalloc(sizeof(file_t));
+        fi->name = fn;
+        fi->size = (int)st.st_size;
+        fi->image = (byte *)image;
+        fi->crcOk = NULL;
+        fi->mapped = 1;
+    }
+    close(fd);
+    return fi;
+}
+#else
+file_t *newFile(char *fn)				// returns NULL after reporting the error if the file can't be read
 {
     FILE *fp;
     long fileSize;
     file_t *fi = NULL;
 
     if ((fp = fopen(fn, "rb")) == NULL) {
-        usage("can't open %s\n", fn);
-        return NULL;                        
+        fprintf(stderr, "can't open %s\n", fn);
+        return NULL;
     }
     fseek(fp, 0, SEEK_END);
     if ((fileSize = ftell(fp)) <= 0)
@@ -49,8 +126,23 @@ file_t *newFile(char *fn)
         else {
             fi->size = fileSize;
             fi->name = fn;
+            fi->crcOk = NULL;
+            fi->mapped = 0;
         }
     }
     fclose(fp);
     return fi;
 }
+#endif
+
+void deleteFile(file_t *fi)				// the name belongs to the caller
+{
+#ifndef _MSC_VER
+    if (fi->mapped)
+        munmap(fi->image, (size_t)fi->size);
+    else
+#endif
+        free(fi->image);
+    free(fi->crcOk);
+    free(fi);
+}
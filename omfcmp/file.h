@@ -26,6 +26,10 @@ typedef struct {
     char *name;
     int size;
     byte *image;
+    byte *crcOk;        // bit set for each offset that starts a record with a valid checksum
+    int mapped;         // image is a read only mapping of the file
 } file_t;
 
-file_t *newFile(char *fn);
\ No newline at end of file
+file_t *newFile(char *fn);
+void deleteFile(file_t *fi);
+void checkRecords(file_t *fi);
\ No newline at end of file
@@ -0,0 +1,164 @@
+/****************************************************************************
+ *                                                                          *
+ *  omfcmp: compare two omf85 files                                         *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+/*
+ * --json and -q support
+ * With --json each result is written as a JSON object on a line of its own.
+ * A "diff" record is written for each difference, a "segment" record before
+ * the first difference in a segment and a "module" record with the outcome of
+ * each module comparison, all naming the files and module they apply to.
+ * Tree comparisons add a "file" record for each pair and a "summary" record.
+ * With -q nothing is written and the first difference that matters ends the
+ * run with an exit code of 1.
+ */
+
+#include "omfcmp.h"
+
+int jsonMode;       // --json
+int quiet;          // -q
+
+static char const *file1, *file2;
+static byte *module;
+
+
+/* called as each difference that affects the return code is found, with -q there is no need to look further */
+void foundDifference()
+{
+    if (quiet)
+        exit(1);
+}
+
+char *pstrToStr(byte *s, char *buf)     // buf needs room for 256 chars
+{
+    memcpy(buf, s + 1, s[0]);
+    buf[s[0]] = 0;
+    return buf;
+}
+
+static void putString(char const *s, int len)
+{
+    putchar('"');
+    for (int i = 0; i < len; i++) {
+        byte c = s[i];
+        if (c == '"' || c == '\\')
+            printf("\\%c", c);
+        else if (c < ' ' || c > '~')
+            printf("\\u%04X", c);
+        else
+            putchar(c);
+    }
+    putchar('"');
+}
+
+static void putField(char const *key, char const *value)   // ,"key":"value" or null if value is NULL
+{
+    printf(",\"%s\":", key);
+    if (value)
+        putString(value, (int)strlen(value));
+    else
+        printf("null");
+}
+
+static void putPstrField(char const *key, byte *value)
+{
+    printf(",\"%s\":", key);
+    putString((char *)value + 1, value[0]);
+}
+
+static void beginRecord(char const *record)
+{
+    printf("{\"record\":\"%s\"", record);
+    putField("file1", file1);
+    putField("file2", file2);
+    if (module)
+        putPstrField("module", module);
+}
+
+void jsonFiles(char const *left, char const *right)    // sets the files the following records are for
+{
+    file1 = left;
+    file2 = right;
+    module = NULL;
+}
+
+void jsonModule(byte *name)
+{
+    module = name;
+}
+
+void jsonSegment(byte *segment)
+{
+    beginRecord("segment");
+    putPstrField("segment", segment);
+    printf("}\n");
+}
+
+/* value1 and value2 are what each side has, NULL if it is missing */
+void jsonDiff(byte *segment, char const *kind, long addr, byte *name, char const *value1, char const *value2)
+{
+    beginRecord("diff");
+    if (segment)
+        putPstrField("segment", segment);
+    putField("kind", kind);
+    if (addr >= 0)
+        printf(",\"address\":%ld", addr);
+    if (name)
+        putPstrField("name", name);
+    putField("value1", value1);
+    putField("value2", value2);
+    printf("}\n");
+}
+
+/* an aligned content difference, the values are the leading bytes of each side */
+void jsonHunk(byte *segment, char const *kind, long addr1, int len1, char const *value1, long addr2, int len2,
+              char const *value2)
+{
+    beginRecord("diff");
+    putPstrField("segment", segment);
+    putField("kind", kind);
+    printf(",\"address\":%ld,\"length1\":%d", addr1, len1);
+    putField("value1", value1);
+    printf(",\"address2\":%ld,\"length2\":%d", addr2, len2);
+    putField("value2", value2);
+    printf("}\n");
+}
+
+void jsonResult(char const *status)
+{
+    beginRecord("module");
+    putField("status", status);
+    printf("}\n");
+}
+
+void jsonFile(char const *path, char const *status)
+{
+    printf("{\"record\":\"file\"");
+    putField("path", path);
+    putField("status", status);
+    printf("}\n");
+}
+
+void jsonSummary(int identical, int equivalent, int different, int missing)
+{
+    printf("{\"record\":\"summary\",\"identical\":%d,\"equivalent\":%d,\"different\":%d,\"missing\":%d}\n",
+           identical, equivalent, different, missing);
+}
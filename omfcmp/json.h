@@ -0,0 +1,38 @@
+/****************************************************************************
+ *                                                                          *
+ *  omfcmp: compare two omf85 files                                         *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+#pragma once
+
+extern int jsonMode;
+extern int quiet;
+
+void foundDifference();
+void jsonFiles(char const *file1, char const *file2);
+void jsonModule(byte *name);
+void jsonSegment(byte *segment);
+void jsonDiff(byte *segment, char const *kind, long addr, byte *name, char const *value1, char const *value2);
+void jsonHunk(byte *segment, char const *kind, long addr1, int len1, char const *value1, long addr2, int len2,
+              char const *value2);
+void jsonResult(char const *status);
+void jsonFile(char const *path, char const *status);
+void jsonSummary(int identical, int equivalent, int different, int missing);
+char *pstrToStr(byte *s, char *buf);
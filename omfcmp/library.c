@@ -22,39 +22,277 @@
 
 #include "omfcmp.h"
 
+static unsigned hashName(byte *name)	// FNV-1a of the pascal string
+{
+    unsigned hash = 2166136261u;
+
+    for (int i = 0; i <= name[0]; i++)
+        hash = (hash ^ name[i]) * 16777619u;
+    return hash;
+}
+
+static void indexNames(library_t *lib)	// builds the name to module index hash table
+{
+    int i, bucket;
+
+    for (lib->hashSize = 16; lib->hashSize < lib->count * 2; lib->hashSize *= 2)
+        ;
+    lib->hashHead = (int *)xmalloc(lib->hashSize * sizeof(int));
+    lib->hashNext = (int *)xmalloc((lib->count + 1) * sizeof(int));
+    for (i = 0; i < lib->hashSize; i++)
+        lib->hashHead[i] = -1;
+    for (i = lib->count - 1; i >= 0; i--) {		// in reverse so each chain is in module order
+        bucket = hashName((byte *)lib->names[i]) & (lib->hashSize - 1);
+        lib->hashNext[i] = lib->hashHead[bucket];
+        lib->hashHead[bucket] = i;
+    }
+}
+
+/*
+ * returns the index of the first module called name, searching from module
+ * from and wrapping round to the start of the library, or -1 if not present
+ */
+int findModule(library_t *lib, byte *name, int from)
+{
+    int i;
+    int first = -1;
+
+    for (i = lib->hashHead[hashName(name) & (lib->hashSize - 1)]; i >= 0; i = lib->hashNext[i])
+        if (pstrEqu((byte *)lib->names[i], name)) {
+            if (i >= from)
+                return i;
+            if (first < 0)
+                first = i;
+        }
+    return first;
+}
+
+typedef struct {
+    int cnt, size;
+    int *module;
+    byte **name;
+} dict_t;
+
+static void addDictName(dict_t *dict, int module, byte *name)
+{
+    if (dict->cnt >= dict->size) {
+        dict->size = dict->size ? dict->size * 2 : 256;
+        dict->module = (int *)xrealloc(dict->module, dict->size * sizeof(int));
+        dict->name = (byte **)xrealloc(dict->name, dict->size * sizeof(byte *));
+    }
+    dict->module[dict->cnt] = module;
+    dict->name[dict->cnt++] = name;
+}
+
+static int cmpName(const void *a, const void *b)
+{
+    return pstrCmp(*(byte **)a, *(byte **)b);
+}
+
+/* sorts the dictionary names into a list for each module, in name order, with a hash of each list.
+ * Modules with publics are also chained by that hash, so a renamed module is found without a scan
+ */
+static void indexPublics(library_t *lib, dict_t *dict)
+{
+    int i, j, bucket;
+    uint64_t hash;
+
+    lib->pubStart = (int *)xcalloc(lib->count + 2, sizeof(int));
+    lib->publics = (byte **)xmalloc((dict->cnt + 1) * sizeof(byte *));
+    lib->pubHash = (uint64_t *)xmalloc((lib->count + 1) * sizeof(uint64_t));
+    lib->pubHead = (int *)xmalloc(lib->hashSize * sizeof(int));
+    lib->pubNext = (int *)xmalloc((lib->count + 1) * sizeof(int));
+    for (i = 0; i < dict->cnt; i++)
+        lib->pubStart[dict->module[i] + 2]++;
+    for (i = 2; i <= lib->count + 1; i++)
+        lib->pubStart[i] += lib->pubStart[i - 1];
+    for (i = 0; i < dict->cnt; i++)         // pubStart[m + 1] moves from the start to the end of module m's list
+        lib->publics[lib->pubStart[dict->module[i] + 1]++] = dict->name[i];
+    for (i = 0; i < lib->count; i++) {
+        qsort(lib->publics + lib->pubStart[i], (size_t)(lib->pubStart[i + 1] - lib->pubStart[i]), sizeof(byte *), cmpName);
+        for (hash = 0, j = lib->pubStart[i]; j < lib->pubStart[i + 1]; j++)
+            hash = hashBytes(hash, lib->publics[j], lib->publics[j][0] + 1);
+        lib->pubHash[i] = hash;
+    }
+    for (i = 0; i < lib->hashSize; i++)
+        lib->pubHead[i] = -1;
+    for (i = lib->count - 1; i >= 0; i--)       // in reverse so each chain is in module order
+        if (lib->pubStart[i + 1] > lib->pubStart[i]) {
+            bucket = (int)(lib->pubHash[i] & (lib->hashSize - 1));
+            lib->pubNext[i] = lib->pubHead[bucket];
+            lib->pubHead[bucket] = i;
+        }
+    free(dict->module);
+    free(dict->name);
+}
+
+/* returns 1 if the two modules have the same non empty list of publics in their library dictionaries */
+static int samePublics(library_t *ll, int i, library_t *rl, int j)
+{
+    int n = ll->pubStart[i + 1] - ll->pubStart[i];
+
+    if (n == 0 || n != rl->pubStart[j + 1] - rl->pubStart[j] || ll->pubHash[i] != rl->pubHash[j])
+        return 0;
+    while (n-- > 0)
+        if (!pstrEqu(ll->publics[ll->pubStart[i] + n], rl->publics[rl->pubStart[j] + n]))
+            return 0;
+    return 1;
+}
+
+/*
+ * returns the first right module, not already paired and with no module of the same name in
+ * the left library, that has the same publics as left module i, i.e. it has been renamed.
+ * returns -1 if there is none
+ */
+static int findRenamed(library_t *ll, int i, library_t *rl, int *renamed)
+{
+    int k;
+
+    for (k = rl->pubHead[ll->pubHash[i] & (rl->hashSize - 1)]; k >= 0; k = rl->pubNext[k])
+        if (!renamed[k] && samePublics(ll, i, rl, k) && findModule(ll, (byte *)rl->names[k], 0) < 0)
+            return k;
+    return -1;
+}
+
+static int moduleAt(library_t *lib, int loc)	// returns the index of the module starting at loc, -1 if none
+{
+    int lo = 0, hi = lib->count - 1, mid;
+
+    while (lo <= hi) {
+        mid = (lo + hi) / 2;
+        if (lib->locations[mid] == loc)
+            return mid;
+        if (lib->locations[mid] < loc)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return -1;
+}
+
+/*
+ * Microsoft libraries start with a header padded to the page size, giving
+ * the location of the dictionary. Each module starts on a page boundary and
+ * runs to its MODEND, and the modules are followed by a library end record.
+ * The dictionary is a series of 512 byte blocks, each with 37 buckets
+ * holding the word offsets of entries, each entry being a name and the page
+ * of the module that defines it. Module names are also in the dictionary,
+ * with a trailing !, but are skipped as they come from the THEADR records
+ */
+static library_t *newMSLibrary(omf_t *omf)
+{
+    byte *image = omf->image;
+    int pageSize = image[1] + image[2] * 256 + 3;
+    long dictOffset = image[3] + (image[4] << 8) + (image[5] << 16) + ((long)image[6] << 24);
+    int dictBlocks = image[7] + image[8] * 256;
+    library_t *library;
+    dict_t dict = { 0 };
+    int size = 0;
+    int pos, type, b, bucket, m;
+    byte *block, *entry;
+
+    if (omf->size < pageSize || pageSize < 16 || (pageSize & (pageSize - 1)) || dictOffset + dictBlocks * 512L > omf->size)
+        return NULL;
+
+    library = (library_t *)xcalloc(1, sizeof(library_t));
+    for (pos = pageSize; pos < omf->size && image[pos] != MSLIBEND; pos = (pos + pageSize - 1) / pageSize * pageSize) {
+        if (image[pos] != THEADR && image[pos] != LHEADR)
+            break;
+        if (library->count >= size) {
+            size = size ? size * 2 : 64;
+            library->names = (char **)xrealloc(library->names, size * sizeof(char *));
+            library->locations = (int *)xrealloc(library->locations, (size + 1) * sizeof(int));
+        }
+        library->names[library->count] = (char *)image + pos + 3;
+        library->locations[library->count++] = pos;
+        do {
+            type = image[pos];
+            pos += image[pos + 1] + image[pos + 2] * 256 + 3;
+        } while (type != MODEND86 && type != MODEND86 + 1 && pos + 3 <= omf->size);
+    }
+    if (pos >= omf->size || image[pos] != MSLIBEND || library->count == 0) {
+        free(library->names);
+        free(library->locations);
+        free(library);
+        return NULL;
+    }
+    library->locations[library->count] = pos;   // end marker for final module
+
+    for (b = 0; b < dictBlocks; b++) {
+        block = image + dictOffset + b * 512;
+        for (bucket = 0; bucket < 37; bucket++) {
+            if (block[bucket] == 0)
+                continue;
+            entry = block + block[bucket] * 2;
+            if (entry + entry[0] + 3 > block + 512 || (entry[0] && entry[entry[0]] == '!'))
+                continue;
+            if ((m = moduleAt(library, (entry[entry[0] + 1] + entry[entry[0] + 2] * 256) * pageSize)) >= 0)
+                addDictName(&dict, m, entry);
+        }
+    }
+    library->omf86 = 1;
+    indexNames(library);
+    indexPublics(library, &dict);
+    return library;
+}
+
 library_t *newLibrary(omf_t *omf)		// returns the list of library modules and locations
 {
     word count, i;
     long loc;
     library_t *library;
+    dict_t dict = { 0 };
+    byte *name;
+    int omf86;
 
     seekRecord(omf, 0);					// rewind
-    if (getRecord(omf) != LIBHDR || omf->lengthRec != 7)
+    if (omf->size > 0 && omf->image[0] == MSLIBHDR)
+        return newMSLibrary(omf);
+    omf86 = omf->image[0] == LIBHED;
+    if (getRecord(omf) != (omf86 ? LIBHED : LIBHDR) || omf->lengthRec != 7)
         return NULL;
 
     count = getWord(omf);				// number of modules
     loc = getLoc(omf);					// offset to names record
-    if (!seekRecord(omf, loc) || getRecord(omf) != LIBNAM || getRecord(omf) != LIBLOC
-        || getRecord(omf) != LIBDIC || getRecord(omf) != EOFREC) {
+    if (!seekRecord(omf, loc) || getRecord(omf) != (omf86 ? LIBNAM86 : LIBNAM) || getRecord(omf) != (omf86 ? LIBLOC86 : LIBLOC)
+        || getRecord(omf) != (omf86 ? LIBDIC86 : LIBDIC) || (!omf86 && getRecord(omf) != EOFREC)) {	// OMF86 has no EOF record
         omf->error = 1;
         return NULL;
     }
 
-    library = (library_t *)xmalloc(sizeof(library_t));
+    library = (library_t *)xcalloc(1, sizeof(library_t));
     library->names = (char **)xcalloc(count, sizeof(byte *));
     library->locations = (int *)xcalloc(count + 1, sizeof(int));
 
     library->count = count;
     library->current = 0;
+    library->omf86 = omf86;
 
+    /* a corrupt count mustn't walk the names or locations off the end of
+     * their records, so both are checked against the record lengths
+     */
     seekRecord(omf, loc);
     getRecord(omf);
-    for (i = 0; i < count; i++)
+    for (i = 0; i < count && !atEndOfRecord(omf) && !omf->error; i++)
         library->names[i] = (char *)getName(omf);
-    getRecord(omf);
-    for (i = 0; i < count; i++)
-        library->locations[i] = getLoc(omf);
+    if (i < count || !getRecord(omf) || omf->lengthRec != count * 4 + 1)
+        omf->error = 1;
+    for (i = 0; i < count && !omf->error; i++)
+        if ((library->locations[i] = getLoc(omf)) >= loc)	// modules come before the names
+            omf->error = 1;
+    if (omf->error) {
+        deleteLibrary(library);
+        return NULL;
+    }
     library->locations[count] = loc;	// end marker for final module
+    getRecord(omf);						// the dictionary has each module's publics, ending with an empty name
+    for (i = 0; i < count && !atEndOfRecord(omf) && !omf->error;)
+        if ((name = getName(omf))[0] == 0)
+            i++;
+        else
+            addDictName(&dict, i, name);
+    indexNames(library);
+    indexPublics(library, &dict);
     return library;
 }
 
@@ -63,70 +301,178 @@ void deleteLibrary(library_t *lib)
 {
     free(lib->names);
     free(lib->locations);
+    free(lib->hashHead);
+    free(lib->hashNext);
+    free(lib->publics);
+    free(lib->pubStart);
+    free(lib->pubHash);
+    free(lib->pubHead);
+    free(lib->pubNext);
     free(lib);
 
 }
 
+typedef struct {
+    int left;           // module index in the left library
+    int right;          // matching module index in the right library, -1 if none
+    int orderChanged;   // report the module order change before this pair
+    int identical;
+} pair_t;
+
+typedef struct {
+    file_t *left, *right;
+    library_t *ll, *rl;
+    pair_t *pairs;
+    int *jobPair;       // pair index of each module comparison
+} libcmp_t;
+
+static int cmpPair(int job, void *arg)
+{
+    libcmp_t *cmp = arg;
+    pair_t *pair = &cmp->pairs[cmp->jobPair[job]];
+    omf_t *lo, *ro;
+    int result;
+
+    lo = newOMF(cmp->left, pair->left, cmp->ll->locations[pair->left], cmp->ll->locations[pair->left + 1]);
+    ro = newOMF(cmp->right, pair->right, cmp->rl->locations[pair->right], cmp->rl->locations[pair->right + 1]);
+    result = cmp->ll->omf86 ? cmpModule86(lo, ro) : cmpModule(lo, ro);
+    deleteOMF(lo);
+    deleteOMF(ro);
+    return result;
+}
+
+/*
+ * the modules are paired first, then the pairs that are not byte for byte
+ * identical are compared on the worker pool, and finally the results are
+ * printed in left library order
+ */
 void cmpLibrary(file_t *left, file_t *right)
 {
     library_t *ll, *rl;
     omf_t *lo, *ro;
+    pair_t *pairs;
+    libcmp_t cmp;
+    jobResult_t *results;
     int namesDifferent = 0;
-    int i, j, k, prevk;
+    int *renamed;       // set for right modules paired through the dictionaries
+    int i, k, prevk, next;
+    int job, jobCnt;
+    char name[256];
 
     lo = newOMF(left, -1, 0, left->size);
     ro = newOMF(right, -1, 0, right->size);
 
     if ((ll = newLibrary(lo)) == NULL || (rl = newLibrary(ro)) == NULL) {
-        diffBinary(lo, ro);
+        if (diffBinary(lo, ro))
+            returnCode = 1;
         if (ll) deleteLibrary(ll);
         deleteOMF(lo);
         deleteOMF(ro);
         return;
     }
-    prevk = k = 0;
+    deleteOMF(lo);
+    deleteOMF(ro);
+
+    /* pair each left module with the first right module of the same name at or
+     * after the previous match, so the order check only fires when the right
+     * library has to be searched backwards
+     */
+    /* in OMF86 libraries, a left module with no name match is paired through the dictionaries
+     * with a right module, also without a name match, that has the same publics
+     */
+    pairs = (pair_t *)xcalloc(ll->count + 1, sizeof(pair_t));
+    renamed = (int *)xcalloc(rl->count + 1, sizeof(int));
+    cmp.jobPair = (int *)xmalloc((ll->count + 1) * sizeof(int));
+    jobCnt = 0;
+    prevk = next = 0;
     for (i = 0; i < ll->count; i++) {
-        for (j = 0; j < rl->count; j++) {
-            if (pstrEqu((byte *)ll->names[i], (byte *)rl->names[k]))
-                break;
-            k = (k + 1) % rl->count;
+        pairs[i].left = i;
+        if ((k = findModule(rl, (byte *)ll->names[i], next)) >= 0) {
+            if (k < prevk && !namesDifferent)
+                pairs[i].orderChanged = namesDifferent = 1;
+            prevk = next = k;
         }
-        if (j == rl->count) {
-            printf("%.*s only in %s\n", ll->names[i][0], ll->names[i] + 1, left->name);
+        else if (ll->omf86 && (k = findRenamed(ll, i, rl, renamed)) >= 0)
+            renamed[k] = 1;
+        if ((pairs[i].right = k) >= 0) {
+            if (ll->locations[i + 1] - ll->locations[i] == rl->locations[k + 1] - rl->locations[k]
+                && memcmp(left->image + ll->locations[i], right->image + rl->locations[k],
+                          ll->locations[i + 1] - ll->locations[i]) == 0)
+                pairs[i].identical = 1;
+            else
+                cmp.jobPair[jobCnt++] = i;
+        }
+    }
+
+    cmp.left = left;
+    cmp.right = right;
+    cmp.ll = ll;
+    cmp.rl = rl;
+    cmp.pairs = pairs;
+    results = runJobs(jobCnt, cmpPair, &cmp);
+
+    for (i = job = 0; i < ll->count; i++) {
+        if (pairs[i].right < 0) {
+            foundDifference();
+            if (jsonMode) {
+                jsonFiles(left->name, right->name);
+                jsonDiff(NULL, "module", -1, NULL, pstrToStr((byte *)ll->names[i], name), NULL);
+            }
+            else
+                printf("%.*s only in %s\n", ll->names[i][0], ll->names[i] + 1, left->name);
             returnCode = 1;
+            continue;
         }
-        else {
-            if (k < prevk && !namesDifferent) {
+        if (pairs[i].orderChanged) {
+            foundDifference();
+            if (jsonMode) {
+                jsonFiles(left->name, right->name);
+                jsonDiff(NULL, "module-order", -1, NULL, pstrToStr((byte *)ll->names[i], name), NULL);
+            }
+            else
                 printf("***Module order is different***\n");
-                returnCode = namesDifferent = 1;
+            returnCode = 1;
+        }
+        if (pairs[i].identical) {
+            lo = newOMF(left, i, ll->locations[i], ll->locations[i + 1]);
+            ro = newOMF(right, pairs[i].right, rl->locations[pairs[i].right], rl->locations[pairs[i].right + 1]);
+            if (jsonMode) {
+                jsonFiles(lo->name, ro->name);
+                jsonModule((byte *)ll->names[i]);
+                jsonResult("identical");
             }
-            prevk = k;
+            else
+                printf("%s : %s %.*s *** Identical\n", lo->name, ro->name, ll->names[i][0], ll->names[i] + 1);
             deleteOMF(lo);
             deleteOMF(ro);
-            lo = newOMF(left, i, ll->locations[i], ll->locations[i + 1]);
-            ro = newOMF(right, k, rl->locations[k], rl->locations[k + 1]);
-            if (lo->size == ro->size && memcmp(lo->image, ro->image, lo->size) == 0)
-                printf("%s : %s %.*s *** Identical\n", lo->name, ro->name, ll->names[i][0], ll->names[i] + 1);
-            else
-                cmpModule(lo, ro);
         }
-    }
-    k = 0;
-    for (i = 0; i < rl->count; i++) {
-        for (j = 0; j < ll->count; j++) {
-            if (pstrEqu((byte *)rl->names[i], (byte *)ll->names[k]))
-                break;
-            k = (k + 1) % ll->count;
+        else {
+            if (results && results[job].done) {
+                fwrite(results[job].text, 1, results[job].length, stdout);
+                if (results[job].result)
+                    returnCode = 1;
+            }
+            else if (cmpPair(job, &cmp))
+                returnCode = 1;
+            job++;
         }
-        if (j == ll->count) {
-            printf("%.*s only in %s\n", rl->names[i][0], rl->names[i] + 1, right->name);
+    }
+    for (i = 0; i < rl->count; i++)
+        if (!renamed[i] && findModule(ll, (byte *)rl->names[i], 0) < 0) {
+            foundDifference();
+            if (jsonMode) {
+                jsonFiles(left->name, right->name);
+                jsonDiff(NULL, "module", -1, NULL, NULL, pstrToStr((byte *)rl->names[i], name));
+            }
+            else
+                printf("%.*s only in %s\n", rl->names[i][0], rl->names[i] + 1, right->name);
             returnCode = 1;
         }
-    }
 
-    deleteOMF(lo);
-    deleteOMF(ro);
+    deleteJobs(results, jobCnt);
+    free(cmp.jobPair);
+    free(renamed);
+    free(pairs);
     deleteLibrary(ll);
     deleteLibrary(rl);
-
 }
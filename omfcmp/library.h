@@ -27,9 +27,19 @@ typedef struct {
     int current;
     char **names;
     int *locations;
+    int hashSize;       // power of 2, at least twice count
+    int *hashHead;      // first module index for each hash bucket, -1 if none
+    int *hashNext;      // next module index in the same bucket, -1 at end
+    int omf86;          // the modules are OMF86
+    byte **publics;     // the dictionary's publics for each module, in name order
+    int *pubStart;      // index in publics of each module's first public, count + 1 entries
+    uint64_t *pubHash;  // hash of each module's publics
+    int *pubHead;       // first module with publics for each pubHash bucket, hashSize entries, -1 if none
+    int *pubNext;       // next module in the same pubHash bucket, -1 at end
 } library_t;
 
 library_t *newLibrary(omf_t *omf);
 void deleteLibrary(library_t *lib);
+int findModule(library_t *lib, byte *name, int from);
 void cmpLibrary(file_t *left, file_t *right);
 
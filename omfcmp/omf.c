@@ -41,6 +41,9 @@ omf_t *newOMF(file_t *fi, int mod, int start, int end)
     strcat(omf->name, modStr);
     omf->size = end - start;
     omf->image = fi->image + start;
+    omf->file = fi;
+    omf->offset = start;
+    checkRecords(fi);
     seekRecord(omf, 0);
     return omf;
 }
@@ -65,7 +68,7 @@ int seekRecord(omf_t *omf, int pos)		// forces seek to new location in file
 
 byte getRecord(omf_t *omf)					// sets up the next record and returns its type. The length is also skipped
 {
-    int crc, i;
+    int crc, i, loc;
 
     if (omf->lengthRec)	// skip any existing record
         omf->pos = omf->startRec + omf->lengthRec + 3;
@@ -73,10 +76,17 @@ byte getRecord(omf_t *omf)					// sets up the next record and returns its type.
         omf->startRec = omf->pos;
         omf->lengthRec = omf->image[omf->pos + 1] + omf->image[omf->pos + 2] * 256;
         omf->pos += 3;
-        for (crc = i = 0; i < omf->lengthRec + 3; i++)
-            crc += omf->image[omf->startRec + i];
-        if (crc & 0xff)
-            omf->error = 1;
+        loc = omf->offset + omf->startRec;
+        if (!(omf->file->crcOk[loc / 8] & (1 << (loc % 8)))) {	// not validated when the file was loaded
+            if (omf->startRec + omf->lengthRec + 3 > omf->size)
+                omf->error = 1;
+            else {
+                for (crc = i = 0; i < omf->lengthRec + 3; i++)
+                    crc += omf->image[omf->startRec + i];
+                if ((crc & 0xff) && (omf->image[omf->startRec] < THEADR || omf->image[omf->startRec + omf->lengthRec + 2] != 0))
+                    omf->error = 1;     // OMF86 allows a checksum of 0 to mean none
+            }
+        }
         return omf->error == 0 ? omf->image[omf->startRec] : 0;
     }
     omf->error = 1;
@@ -95,7 +105,7 @@ byte *getName(omf_t *omf)					// returns a name value with in the record
 {
     byte *name = omf->image + omf->pos;
 
-    if ((omf->pos += name[0] + 1) > omf->startRec + omf->lengthRec + 1)
+    if ((omf->pos += name[0] + 1) > omf->startRec + omf->lengthRec + 2)	// may run up to the checksum
         omf->error = 1;
     return name;
 
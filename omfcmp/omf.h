@@ -28,6 +28,8 @@ typedef struct {
     char *name;
     int size;
     byte *image;
+    file_t *file;
+    int offset;         // of image in the file
     int startRec;
     int lengthRec;
     int pos;
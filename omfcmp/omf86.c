@@ -0,0 +1,1263 @@
+/****************************************************************************
+ *                                                                          *
+ *  omfcmp: compare two omf85 files                                         *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+#include "omfcmp.h"
+
+/*
+ * OMF86 support
+ * A module is read into a model where every index is resolved to a name, so
+ * two modules compare the same whatever order their names, segments, groups
+ * and externals were defined in. LEDATA and LIDATA are copied into an image
+ * of each segment, with LIDATA expanded, and each fixup is placed at every
+ * address its location was copied to, with THREAD frames and targets
+ * resolved. Segments are identified by their segment:class:overlay name and,
+ * as for OMF85, segments, groups, publics, fixups and externals are sorted
+ * and then merged to find the differences.
+ */
+
+#define REPORTED    1
+#define ALIGNED     2       // content and fixup differences reported by alignment
+#define NOTHREAD    0xff    // method of a thread that hasn't been defined
+
+typedef struct {
+    byte method;        // frame method F0-F6 or target method T0-T3
+    byte *name;         // segment, group or external for methods 0-2
+    word frame;         // for method 3
+} ref86_t;
+
+typedef struct {
+    uint32_t addr;
+    byte loc;
+    byte self;
+    byte hasDisp;
+    ref86_t frame;
+    ref86_t target;
+    uint32_t disp;
+} fix86_t;
+
+typedef struct {
+    uint32_t addr;
+    byte *name;
+    byte *group;        // NULL if not in a group
+} pub86_t;
+
+typedef struct {
+    byte *name;         // segment:class:overlay
+    byte acbp;
+    word frame;         // absolute segments only
+    byte frameOffset;
+    uint32_t length;
+    uint32_t extent;    // size of image, grown as content is added
+    byte *image;
+    byte *defined;      // non zero for each byte of image given content
+    int status;
+    int pubCnt, pubSize;
+    pub86_t *publics;
+    int fixCnt, fixSize;
+    fix86_t *fixups;
+} seg86_t;
+
+typedef struct {
+    byte *name;
+    int cnt, size;
+    byte **members;
+} grp86_t;
+
+typedef struct {
+    uint32_t start;     // offset in the data record
+    uint32_t length;
+    uint32_t addr;      // where in the segment it was copied to
+} span_t;
+
+typedef struct {
+    byte *name;
+    int nameCnt, nameSize;
+    byte **names;       // LNAMES
+    int segCnt, segSize;
+    seg86_t *segs;      // segs[0] holds the absolute publics
+    int grpCnt, grpSize;
+    grp86_t *groups;
+    int extCnt, extSize;
+    byte **externals;
+    int strCnt, strSize;
+    byte **strings;     // names built while reading the module
+    byte modType;
+    fix86_t start;
+    ref86_t frameThreads[4];
+    ref86_t targetThreads[4];
+    int dataSeg;        // segment of the last data record, 0 if none
+    int spanCnt, spanSize;
+    span_t *spans;      // where the last data record's bytes were copied to
+} module86_t;
+
+
+static void *grow(void *items, int cnt, int *size, size_t itemSize)
+{
+    if (cnt < *size)
+        return items;
+    *size = *size ? *size * 2 : INITIALCHUNK;
+    return xrealloc(items, *size * itemSize);
+}
+
+static void sortItems(void *items, int cnt, size_t itemSize, int (*cmp)(const void *, const void *))
+{
+    if (cnt > 1)        // items is NULL if nothing was added
+        qsort(items, (size_t)cnt, itemSize, cmp);
+}
+
+static byte *addString(module86_t *mod, char *s)    // returns s as a pascal string freed with the module
+{
+    size_t len = strlen(s) > 255 ? 255 : strlen(s);
+    byte *name = (byte *)xmalloc(len + 1);
+
+    name[0] = (byte)len;
+    memcpy(name + 1, s, len);
+    mod->strings = grow(mod->strings, mod->strCnt, &mod->strSize, sizeof(byte *));
+    return mod->strings[mod->strCnt++] = name;
+}
+
+static uint32_t getDWord(omf_t *omf)
+{
+    uint32_t c = getWord(omf);
+    return c + ((uint32_t)getWord(omf) << 16);
+}
+
+static uint32_t getOffset(omf_t *omf, byte type)    // records with odd types have 32 bit offsets
+{
+    return type & 1 ? getDWord(omf) : getWord(omf);
+}
+
+static word getIndex(omf_t *omf)
+{
+    word c = getByte(omf);
+    return c & 0x80 ? ((c & 0x7f) << 8) + getByte(omf) : c;
+}
+
+static byte *lname(omf_t *omf, module86_t *mod, word index)
+{
+    if (index == 0 || index > mod->nameCnt) {
+        omf->error = 1;
+        return (byte *)"";
+    }
+    return mod->names[index - 1];
+}
+
+static byte *segName(omf_t *omf, module86_t *mod, word index)
+{
+    if (index == 0 || index >= mod->segCnt) {
+        omf->error = 1;
+        return (byte *)"";
+    }
+    return mod->segs[index].name;
+}
+
+static byte *grpName(omf_t *omf, module86_t *mod, word index)
+{
+    if (index == 0 || index > mod->grpCnt) {
+        omf->error = 1;
+        return (byte *)"";
+    }
+    return mod->groups[index - 1].name;
+}
+
+static byte *extName(omf_t *omf, module86_t *mod, word index)
+{
+    if (index == 0 || index > mod->extCnt) {
+        omf->error = 1;
+        return (byte *)"";
+    }
+    return mod->externals[index - 1];
+}
+
+static byte *segKey(module86_t *mod, byte *name, byte *cls, byte *ovl)  // segment:class:overlay as dumpomf shows it
+{
+    char key[3 * 256];
+
+    sprintf(key, "%.*s", name[0], name + 1);
+    if (cls[0])
+        sprintf(key + strlen(key), ":%.*s", cls[0], cls + 1);
+    if (ovl[0])
+        sprintf(key + strlen(key), "%s%.*s", cls[0] ? ":" : "::", ovl[0], ovl + 1);
+    return addString(mod, key);
+}
+
+static void addPublic86(seg86_t *seg, byte *name, uint32_t addr, byte *group)
+{
+    seg->publics = grow(seg->publics, seg->pubCnt, &seg->pubSize, sizeof(pub86_t));
+    seg->publics[seg->pubCnt].name = name;
+    seg->publics[seg->pubCnt].group = group;
+    seg->publics[seg->pubCnt++].addr = addr;
+}
+
+static void addExternal86(module86_t *mod, byte *name)
+{
+    mod->externals = grow(mod->externals, mod->extCnt, &mod->extSize, sizeof(byte *));
+    mod->externals[mod->extCnt++] = name;
+}
+
+
+static void lnames(omf_t *omf, module86_t *mod)
+{
+    while (!atEndOfRecord(omf)) {
+        mod->names = grow(mod->names, mod->nameCnt, &mod->nameSize, sizeof(byte *));
+        mod->names[mod->nameCnt++] = getName(omf);
+    }
+}
+
+static void segdef(omf_t *omf, byte type, module86_t *mod)
+{
+    seg86_t *seg;
+    byte *name, *cls;
+
+    mod->segs = grow(mod->segs, mod->segCnt, &mod->segSize, sizeof(seg86_t));
+    seg = &mod->segs[mod->segCnt++];
+    memset(seg, 0, sizeof(seg86_t));
+    seg->acbp = getByte(omf);
+    if ((seg->acbp >> 5) == 0) {            // absolute
+        seg->frame = getWord(omf);
+        seg->frameOffset = getByte(omf);
+    }
+    else if ((seg->acbp >> 5) == 6) {       // Intel LTL, the extra fields only matter to the locator
+        getByte(omf);
+        getWord(omf);
+        getWord(omf);
+    }
+    seg->length = getOffset(omf, type);
+    if (seg->acbp & 2) {                    // big, i.e. the full 64K or 4G
+        if (type & 1)
+            omf->error = 1;
+        seg->length = 0x10000;
+    }
+    name = lname(omf, mod, getIndex(omf));
+    cls = lname(omf, mod, getIndex(omf));
+    seg->name = segKey(mod, name, cls, lname(omf, mod, getIndex(omf)));
+}
+
+static void grpdef(omf_t *omf, module86_t *mod)
+{
+    grp86_t *grp;
+    byte *member;
+    byte *name, *cls;
+    char desc[32];
+    word w1, w2;
+    byte b;
+
+    mod->groups = grow(mod->groups, mod->grpCnt, &mod->grpSize, sizeof(grp86_t));
+    grp = &mod->groups[mod->grpCnt++];
+    memset(grp, 0, sizeof(grp86_t));
+    grp->name = lname(omf, mod, getIndex(omf));
+    while (!atEndOfRecord(omf) && !omf->error) {
+        switch (getByte(omf)) {
+        case 0xff:
+            member = segName(omf, mod, getIndex(omf));
+            break;
+        case 0xfe:
+            member = extName(omf, mod, getIndex(omf));
+            break;
+        case 0xfd:
+            name = lname(omf, mod, getIndex(omf));
+            cls = lname(omf, mod, getIndex(omf));
+            member = segKey(mod, name, cls, lname(omf, mod, getIndex(omf)));
+            break;
+        case 0xfb:
+            b = getByte(omf);
+            w1 = getWord(omf);
+            w2 = getWord(omf);
+            sprintf(desc, "LTL %02X %04X %04X", b, w1, w2);
+            member = addString(mod, desc);
+            break;
+        case 0xfa:
+            w1 = getWord(omf);
+            sprintf(desc, "ABS %04X:%02X", w1, getByte(omf));
+            member = addString(mod, desc);
+            break;
+        default:
+            omf->error = 1;
+            return;
+        }
+        grp->members = grow(grp->members, grp->cnt, &grp->size, sizeof(byte *));
+        grp->members[grp->cnt++] = member;
+    }
+}
+
+static void pubdef(omf_t *omf, byte type, module86_t *mod)
+{
+    word grpIdx = getIndex(omf);
+    word segIdx = getIndex(omf);
+    byte *group = grpIdx ? grpName(omf, mod, grpIdx) : NULL;
+    uint32_t base = segIdx ? 0 : getWord(omf) * 16;     // absolute publics are kept as linear addresses
+    byte *name;
+
+    if (segIdx >= mod->segCnt)
+        omf->error = 1;
+    while (!atEndOfRecord(omf) && !omf->error) {
+        name = getName(omf);
+        addPublic86(&mod->segs[segIdx], name, base + getOffset(omf, type), group);
+        getIndex(omf);      // type
+    }
+}
+
+static void extdef(omf_t *omf, module86_t *mod)
+{
+    while (!atEndOfRecord(omf) && !omf->error) {
+        addExternal86(mod, getName(omf));
+        getIndex(omf);      // type
+    }
+}
+
+static void communalLength(omf_t *omf)
+{
+    byte c = getByte(omf);
+
+    if (c == 0x81)
+        getWord(omf);
+    else if (c == 0x84) {
+        getWord(omf);
+        getByte(omf);
+    }
+    else if (c == 0x88)
+        getDWord(omf);
+    else if (c > 0x80)
+        omf->error = 1;
+}
+
+static void comdef(omf_t *omf, module86_t *mod)
+{
+    byte dataType;
+
+    while (!atEndOfRecord(omf) && !omf->error) {
+        addExternal86(mod, getName(omf));
+        getIndex(omf);      // type
+        dataType = getByte(omf);
+        if (dataType == 0x61) {         // far, number of elements and element size
+            communalLength(omf);
+            communalLength(omf);
+        }
+        else if (dataType == 0x62)      // near, size
+            communalLength(omf);
+        else if (dataType == 0 || dataType >= 0x60)     // 1-0x5f are Borland segment indexes
+            omf->error = 1;
+    }
+}
+
+/* copies len bytes of data record content to addr in seg, noting where they went for any fixups */
+static void putContent(omf_t *omf, module86_t *mod, seg86_t *seg, uint32_t start, uint32_t addr, byte *data, uint32_t len)
+{
+    uint64_t extent;
+
+    if ((uint64_t)addr + len > seg->length) {
+        omf->error = 1;
+        return;
+    }
+    if (addr + len > seg->extent) {     // grow the image, doubling so large segments aren't copied too often
+        extent = seg->extent ? (uint64_t)seg->extent * 2 : 0x10000;
+        if (extent < addr + len)
+            extent = addr + len;
+        if (extent > seg->length)
+            extent = seg->length;
+        seg->image = (byte *)xrealloc(seg->image, extent);
+        seg->defined = (byte *)xrealloc(seg->defined, extent);
+        memset(seg->image + seg->extent, 0, extent - seg->extent);
+        memset(seg->defined + seg->extent, 0, extent - seg->extent);
+        seg->extent = (uint32_t)extent;
+    }
+    memcpy(seg->image + addr, data, len);
+    memset(seg->defined + addr, 1, len);
+
+    mod->spans = grow(mod->spans, mod->spanCnt, &mod->spanSize, sizeof(span_t));
+    mod->spans[mod->spanCnt].start = start;
+    mod->spans[mod->spanCnt].length = len;
+    mod->spans[mod->spanCnt++].addr = addr;
+}
+
+static seg86_t *dataSeg(omf_t *omf, module86_t *mod)
+{
+    word segIdx = getIndex(omf);
+
+    if (segIdx == 0 || segIdx >= mod->segCnt) {
+        omf->error = 1;
+        return NULL;
+    }
+    mod->dataSeg = segIdx;
+    mod->spanCnt = 0;
+    return &mod->segs[segIdx];
+}
+
+static void ledata(omf_t *omf, byte type, module86_t *mod)
+{
+    seg86_t *seg;
+    uint32_t addr;
+
+    if ((seg = dataSeg(omf, mod)) == NULL)
+        return;
+    addr = getOffset(omf, type);
+    if (!omf->error)
+        putContent(omf, mod, seg, 0, addr, omf->image + omf->pos, omf->startRec + omf->lengthRec + 2 - omf->pos);
+}
+
+/*
+ * expands an iterated data block to *addr, base being where the blocks start
+ * in the record. A block with a repeat count of 0, or within one, is only
+ * skipped. A block whose first pass puts nothing in the segment, because
+ * everything inside it repeats 0 times, isn't repeated either, so every pass
+ * that is repeated adds at least one byte and expansion stops with an error
+ * once it runs off the end of the segment
+ */
+static void iterated(omf_t *omf, byte type, module86_t *mod, seg86_t *seg, int base, uint32_t *addr, int expand)
+{
+    uint32_t repeat = getOffset(omf, type);
+    word blocks = getWord(omf);
+    int pos = omf->pos;
+    uint32_t start = *addr;
+    uint32_t i;
+    word j;
+    byte len;
+
+    if (repeat == 0)
+        expand = 0;
+    for (i = 0; i < (expand ? repeat : 1) && !omf->error; i++) {
+        if (i == 1 && *addr == start)   // the first pass was empty, so all of them are
+            break;
+        omf->pos = pos;
+        if (blocks == 0) {
+            len = getByte(omf);
+            if (len == 0 || omf->pos + len > omf->startRec + omf->lengthRec + 2)
+                omf->error = 1;
+            else {
+                if (expand) {
+                    putContent(omf, mod, seg, omf->pos - base, *addr, omf->image + omf->pos, len);
+                    *addr += len;
+                }
+                omf->pos += len;
+            }
+        }
+        else
+            for (j = 0; j < blocks && !omf->error; j++)
+                iterated(omf, type, mod, seg, base, addr, expand);
+    }
+}
+
+static void lidata(omf_t *omf, byte type, module86_t *mod)
+{
+    seg86_t *seg;
+    uint32_t addr;
+    int base;
+
+    if ((seg = dataSeg(omf, mod)) == NULL)
+        return;
+    addr = getOffset(omf, type);
+    base = omf->pos;
+    while (!atEndOfRecord(omf) && !omf->error)
+        iterated(omf, type, mod, seg, base, &addr, 1);
+}
+
+static void getRef(omf_t *omf, module86_t *mod, ref86_t *ref, byte method)
+{
+    ref->method = method;
+    ref->name = NULL;
+    ref->frame = 0;
+    switch (method) {
+    case 0: ref->name = segName(omf, mod, getIndex(omf)); break;
+    case 1: ref->name = grpName(omf, mod, getIndex(omf)); break;
+    case 2: ref->name = extName(omf, mod, getIndex(omf)); break;
+    case 3: ref->frame = getWord(omf); break;
+    case 4: case 5: case 6: break;          // location, target and none frames
+    default: omf->error = 1;
+    }
+}
+
+static void fixdat(omf_t *omf, byte type, module86_t *mod, fix86_t *fix)
+{
+    byte fd = getByte(omf);
+
+    if (fd & 0x80)
+        fix->frame = mod->frameThreads[(fd >> 4) & 3];
+    else
+        getRef(omf, mod, &fix->frame, (fd >> 4) & 7);
+    if (fd & 0x08)
+        fix->target = mod->targetThreads[fd & 3];
+    else
+        getRef(omf, mod, &fix->target, fd & 3);
+    if (fix->frame.method == NOTHREAD || fix->target.method == NOTHREAD)
+        omf->error = 1;
+    fix->hasDisp = !(fd & 0x04);
+    fix->disp = fix->hasDisp ? getOffset(omf, type) : 0;
+}
+
+static void fixupp(omf_t *omf, byte type, module86_t *mod)
+{
+    byte typ;
+    word offset;
+    fix86_t fix;
+    seg86_t *seg = &mod->segs[mod->dataSeg];
+    int i;
+
+    while (!atEndOfRecord(omf) && !omf->error) {
+        typ = getByte(omf);
+        if (!(typ & 0x80)) {                // THREAD
+            if (typ & 0x40)
+                getRef(omf, mod, &mod->frameThreads[typ & 3], (typ >> 2) & 7);
+            else
+                getRef(omf, mod, &mod->targetThreads[typ & 3], (typ >> 2) & 3);
+            continue;
+        }
+        offset = (typ & 3) * 256 + getByte(omf);
+        fix.loc = (typ >> 2) & 0xf;
+        fix.self = !(typ & 0x40);
+        fixdat(omf, type, mod, &fix);
+        if (mod->dataSeg == 0)
+            omf->error = 1;
+        /* place the fixup everywhere its location was copied to */
+        for (i = 0; i < mod->spanCnt && !omf->error; i++)
+            if (mod->spans[i].start <= offset && offset < mod->spans[i].start + mod->spans[i].length) {
+                fix.addr = mod->spans[i].addr + offset - mod->spans[i].start;
+                seg->fixups = grow(seg->fixups, seg->fixCnt, &seg->fixSize, sizeof(fix86_t));
+                seg->fixups[seg->fixCnt++] = fix;
+            }
+    }
+}
+
+static void modend(omf_t *omf, byte type, module86_t *mod)
+{
+    mod->modType = getByte(omf);
+    if (!(mod->modType & 0x40))
+        return;
+    if (mod->modType & 1)                   // logical start address
+        fixdat(omf, type, mod, &mod->start);
+    else {                                  // physical, kept as an absolute frame and offset
+        mod->start.frame.method = mod->start.target.method = 3;
+        mod->start.frame.frame = mod->start.target.frame = getWord(omf);
+        mod->start.hasDisp = 1;
+        mod->start.disp = getWord(omf);
+    }
+}
+
+
+static void deleteModule86(module86_t *mod)
+{
+    int i;
+
+    for (i = 0; i < mod->segCnt; i++) {
+        free(mod->segs[i].image);
+        free(mod->segs[i].defined);
+        free(mod->segs[i].publics);
+        free(mod->segs[i].fixups);
+    }
+    for (i = 0; i < mod->grpCnt; i++)
+        free(mod->groups[i].members);
+    for (i = 0; i < mod->strCnt; i++)
+        free(mod->strings[i]);
+    free(mod->names);
+    free(mod->segs);
+    free(mod->groups);
+    free(mod->externals);
+    free(mod->strings);
+    free(mod->spans);
+    free(mod);
+}
+
+static module86_t *newModule86(omf_t *omf)
+{
+    module86_t *mod;
+    byte type;
+    int i;
+
+    mod = (module86_t *)xcalloc(1, sizeof(module86_t));
+    mod->segs = grow(mod->segs, 0, &mod->segSize, sizeof(seg86_t));
+    memset(mod->segs, 0, sizeof(seg86_t));
+    mod->segs[mod->segCnt++].name = (byte *)"\3ABS";
+    for (i = 0; i < 4; i++)
+        mod->frameThreads[i].method = mod->targetThreads[i].method = NOTHREAD;
+
+    seekRecord(omf, 0);
+    while (!omf->error) {
+        switch (type = getRecord(omf)) {
+        case THEADR: case LHEADR:
+            mod->name = getName(omf);
+            break;
+        case LNAMES:
+            lnames(omf, mod);
+            break;
+        case SEGDEF: case SEGDEF + 1:
+            segdef(omf, type, mod);
+            break;
+        case GRPDEF:
+            grpdef(omf, mod);
+            break;
+        case PUBDEF: case PUBDEF + 1:
+            pubdef(omf, type, mod);
+            break;
+        case EXTDEF: case LEXTDEF: case LEXTDEF + 1:
+            extdef(omf, mod);
+            break;
+        case COMDEF: case LCOMDEF:
+            comdef(omf, mod);
+            break;
+        case LEDATA: case LEDATA + 1:
+            ledata(omf, type, mod);
+            break;
+        case LIDATA: case LIDATA + 1:
+            lidata(omf, type, mod);
+            break;
+        case FIXUPP: case FIXUPP + 1:
+            fixupp(omf, type, mod);
+            break;
+        case MODEND86: case MODEND86 + 1:
+            modend(omf, type, mod);
+            if (!omf->error && mod->name)
+                return mod;
+            omf->error = 1;
+            break;
+        case COMENT: case TYPDEF: case LOCSYM: case LOCSYM + 1: case LINNUM86: case LINNUM86 + 1:
+        case LPUBDEF: case LPUBDEF + 1: case VERNUM: case VENDEXT:
+            break;
+        default:
+            omf->error = 1;
+        }
+    }
+    deleteModule86(mod);
+    return NULL;
+}
+
+
+static int pstrCmpNull(byte *s, byte *t)    // as pstrCmp but NULL sorts first
+{
+    return s && t ? pstrCmp(s, t) : (s != NULL) - (t != NULL);
+}
+
+static int cmpName(const void *a, const void *b)
+{
+    return pstrCmp(*(byte **)a, *(byte **)b);
+}
+
+static int cmpRef(ref86_t const *a, ref86_t const *b)
+{
+    int cmp;
+
+    if ((cmp = a->method - b->method) == 0 && (cmp = pstrCmpNull(a->name, b->name)) == 0)
+        cmp = a->frame - b->frame;
+    return cmp;
+}
+
+static int cmpFixKey(fix86_t const *a, fix86_t const *b)   // everything but the address
+{
+    int cmp;
+
+    if ((cmp = a->loc - b->loc) == 0 && (cmp = a->self - b->self) == 0 && (cmp = cmpRef(&a->frame, &b->frame)) == 0
+        && (cmp = cmpRef(&a->target, &b->target)) == 0 && (cmp = a->hasDisp - b->hasDisp) == 0)
+        cmp = a->disp < b->disp ? -1 : a->disp > b->disp;
+    return cmp;
+}
+
+static int cmpFix86(const void *a, const void *b)
+{
+    fix86_t const *ap = a;
+    fix86_t const *bp = b;
+
+    return ap->addr != bp->addr ? (ap->addr < bp->addr ? -1 : 1) : cmpFixKey(ap, bp);
+}
+
+static int cmpPub86(const void *a, const void *b)
+{
+    pub86_t const *ap = a;
+    pub86_t const *bp = b;
+    int cmp;
+
+    if ((cmp = pstrCmp(ap->name, bp->name)) == 0)
+        cmp = ap->addr < bp->addr ? -1 : ap->addr > bp->addr;
+    return cmp;
+}
+
+static char *refText(ref86_t *ref, char const *const *kinds, char *buf)
+{
+    switch (ref->method) {
+    case 0: case 1: case 2: sprintf(buf, "%s[%.*s]", kinds[ref->method], ref->name[0], ref->name + 1); break;
+    case 3: sprintf(buf, "%s%04X", kinds[3], ref->frame); break;
+    case 4: strcpy(buf, "LOCATION"); break;
+    case 5: strcpy(buf, "TARGET"); break;
+    case 6: strcpy(buf, "NONE"); break;
+    }
+    return buf + strlen(buf);
+}
+
+static char *fixRefsText(fix86_t *fix, char *buf)  // frame,target[+displacement]
+{
+    static char const *const frames[] = { "SI", "GI", "EI", "" };
+    static char const *const targets[] = { "Seg", "Grp", "Ext", "Frame " };
+    char *s = refText(&fix->frame, frames, buf);
+
+    *s++ = ',';
+    s = refText(&fix->target, targets, s);
+    if (fix->hasDisp)
+        sprintf(s, "+%04X", fix->disp);
+    return buf;
+}
+
+static char *fixup86Text(fix86_t *fix, char *buf)   // buf needs room for 2 names + 40 chars
+{
+    static char const *const locations[] = {
+        "LoByte", "Offset16", "Base", "Pointer32", "HiByte", "LrOffset16", "Pointer48", "Undefined7",
+        "Undefined8", "Offset32", "Undefined10", "Pointer48", "Undefined12", "LrOffset32", "Undefined14", "Undefined15"
+    };
+    sprintf(buf, "%s %s ", locations[fix->loc], fix->self ? "Self" : "Seg");
+    fixRefsText(fix, buf + strlen(buf));
+    return buf;
+}
+
+/* every OMF86 difference matters, so each one found is passed on for -q */
+static void printSegHeader86(seg86_t *ls, seg86_t *rs)
+{
+    foundDifference();
+    if (!(ls->status & REPORTED)) {
+        if (jsonMode)
+            jsonSegment(ls->name);
+        else
+            printf("\n%.*s:\n", ls->name[0], ls->name + 1);
+    }
+    ls->status |= REPORTED;
+    rs->status |= REPORTED;
+}
+
+/* starts a module level section on its first difference, section being the heading last printed */
+static void printSection(char const *title, int *result, char const **section)
+{
+    foundDifference();
+    if ((!*section || strcmp(*section, title) != 0) && !jsonMode)
+        printf("\n%s:\n", title);
+    *section = title;
+    *result = 0;
+}
+
+
+static void diffPublics86(seg86_t *ls, seg86_t *rs)
+{
+    pub86_t *lp = ls->publics, *rp = rs->publics;
+    int i = 0, j = 0;
+    int cmp;
+    char lbuf[260], rbuf[260];
+
+    sortItems(lp, ls->pubCnt, sizeof(pub86_t), cmpPub86);
+    sortItems(rp, rs->pubCnt, sizeof(pub86_t), cmpPub86);
+
+    while (i < ls->pubCnt || j < rs->pubCnt) {
+        if (i == ls->pubCnt)
+            cmp = 1;
+        else if (j == rs->pubCnt)
+            cmp = -1;
+        else
+            cmp = pstrCmp(lp[i].name, rp[j].name);
+        if (cmp < 0) {
+            printSegHeader86(ls, rs);
+            if (jsonMode) {
+                sprintf(lbuf, "%04X", lp[i].addr);
+                jsonDiff(ls->name, "public", -1, lp[i].name, lbuf, NULL);
+            }
+            else {
+                printPstrPair(lp[i].name, (byte *)"\x06------");
+                printf(" - Public missing\n");
+            }
+            i++;
+        }
+        else if (cmp > 0) {
+            printSegHeader86(ls, rs);
+            if (jsonMode) {
+                sprintf(rbuf, "%04X", rp[j].addr);
+                jsonDiff(ls->name, "public", -1, rp[j].name, NULL, rbuf);
+            }
+            else {
+                printPstrPair((byte *)"\x06------", rp[j].name);
+                printf(" - Public missing\n");
+            }
+            j++;
+        }
+        else {
+            if (lp[i].addr != rp[j].addr) {
+                printSegHeader86(ls, rs);
+                if (jsonMode) {
+                    sprintf(lbuf, "%04X", lp[i].addr);
+                    sprintf(rbuf, "%04X", rp[j].addr);
+                    jsonDiff(ls->name, "public", -1, lp[i].name, lbuf, rbuf);
+                }
+                else {
+                    printPstrPair(lp[i].name, rp[j].name);
+                    printf(" - Public addresses different %04X : %04X\n", lp[i].addr, rp[j].addr);
+                }
+            }
+            if (pstrCmpNull(lp[i].group, rp[j].group) != 0) {
+                printSegHeader86(ls, rs);
+                if (jsonMode)
+                    jsonDiff(ls->name, "public-group", -1, lp[i].name, lp[i].group ? pstrToStr(lp[i].group, lbuf) : NULL,
+                             rp[j].group ? pstrToStr(rp[j].group, rbuf) : NULL);
+                else {
+                    printPstrPair(lp[i].name, rp[j].name);
+                    printf(" - Public groups different ");
+                    printPstrPair(lp[i].group ? lp[i].group : (byte *)"\x06------", rp[j].group ? rp[j].group : (byte *)"\x06------");
+                    putchar('\n');
+                }
+            }
+            i++; j++;
+        }
+    }
+}
+
+static int matchFixups86(void *arg, int x, int y, int len)
+{
+    seg86_t **segs = arg;
+    int i = 0;
+
+    while (i < len && cmpFixKey(&segs[0]->fixups[x + i], &segs[1]->fixups[y + i]) == 0)
+        i++;
+    return i;
+}
+
+static void fixupMissing86(seg86_t *ls, seg86_t *rs, fix86_t *fix, int left)   // fix is only in the left or right segment
+{
+    char buf[600];
+
+    printSegHeader86(ls, rs);
+    if (jsonMode)
+        jsonDiff(ls->name, "fixup", fix->addr, NULL, left ? fixup86Text(fix, buf) : NULL, left ? NULL : fixup86Text(fix, buf));
+    else if (left)
+        printf("%04X: %s : ------ - Fixup missing\n", fix->addr, fixup86Text(fix, buf));
+    else
+        printf("%04X: ------ : %s - Fixup missing\n", fix->addr, fixup86Text(fix, buf));
+}
+
+static void alignedFixupMissing86(void *arg, int index, int left)
+{
+    seg86_t **segs = arg;
+
+    fixupMissing86(segs[0], segs[1], &segs[left ? 0 : 1]->fixups[index], left);
+}
+
+static void segStream86(seg86_t *seg, stream_t *s)
+{
+    uint32_t *addrs;
+
+    memset(s, 0, sizeof(stream_t));
+    for (uint32_t i = 0; i < seg->extent; i++)
+        if (seg->defined[i])
+            addStreamByte(s, seg->image[i], i);
+    sortItems(seg->fixups, seg->fixCnt, sizeof(fix86_t), cmpFix86);
+    addrs = (uint32_t *)xmalloc((seg->fixCnt + 1) * sizeof(uint32_t));
+    for (int i = 0; i < seg->fixCnt; i++)
+        addrs[i] = seg->fixups[i].addr;
+    setFixupPos(s, addrs, seg->fixCnt);
+    free(addrs);
+}
+
+/* as for OMF85, reports the content and fixup differences, returning 0 to leave them to the address comparison */
+static int diffAligned86(seg86_t *ls, seg86_t *rs)
+{
+    stream_t l, r;
+    hunk_t *hunks;
+    seg86_t *segs[2] = { ls, rs };
+    int cnt;
+
+    segStream86(ls, &l);
+    segStream86(rs, &r);
+    cnt = alignStreams(&l, &r, alignMode == ALIGNFIXUPS ? matchFixups86 : NULL, segs, &hunks);
+    if (cnt > 0) {
+        printSegHeader86(ls, rs);
+        ls->status |= ALIGNED;
+        for (int i = 0; i < cnt; i++)
+            emitHunk(ls->name, &l, &r, &hunks[i]);
+        alignFixups(&l, &r, hunks, cnt, matchFixups86, segs, alignedFixupMissing86);
+    }
+    if (cnt >= 0)
+        free(hunks);
+    deleteStream(&l);
+    deleteStream(&r);
+    return cnt > 0;
+}
+
+/* the images are compared by address, skipping matching spans a word at a time */
+static void diffContent86(seg86_t *ls, seg86_t *rs)
+{
+    uint32_t common = ls->extent < rs->extent ? ls->extent : rs->extent;
+    uint32_t end = ls->extent > rs->extent ? ls->extent : rs->extent;
+    uint32_t i, same, defSame;
+    int run = 0;            // count of different items used to format
+    uint32_t arun = 0;      // start address of difference run
+    short lrun[MAXRUN], rrun[MAXRUN];   // the run values -ve for missing
+    short lv, rv;
+
+    if (alignMode && diffAligned86(ls, rs))
+        return;
+    for (i = 0; i < end;) {
+        if (i < common) {
+            same = sameLength(ls->image + i, rs->image + i, common - i);
+            defSame = sameLength(ls->defined + i, rs->defined + i, common - i);
+            if ((same = same < defSame ? same : defSame)) {
+                emitRun(ls->name, arun, run, lrun, rrun);
+                run = 0;
+                i += same;
+                continue;
+            }
+        }
+        lv = i < ls->extent && ls->defined[i] ? ls->image[i] : -1;
+        rv = i < rs->extent && rs->defined[i] ? rs->image[i] : -1;
+        if (lv == rv) {                 // neither side has content
+            emitRun(ls->name, arun, run, lrun, rrun);
+            run = 0;
+        }
+        else {
+            printSegHeader86(ls, rs);
+            if (run == 0)
+                arun = i;
+            lrun[run] = lv;
+            rrun[run++] = rv;
+            if (run == MAXRUN) {
+                emitRun(ls->name, arun, run, lrun, rrun);
+                run = 0;
+            }
+        }
+        i++;
+    }
+    emitRun(ls->name, arun, run, lrun, rrun);
+}
+
+static void diffFixups86(seg86_t *ls, seg86_t *rs)
+{
+    fix86_t *lf = ls->fixups, *rf = rs->fixups;
+    int li = 0, ri = 0;
+    char lbuf[600], rbuf[600];
+
+    sortItems(lf, ls->fixCnt, sizeof(fix86_t), cmpFix86);
+    sortItems(rf, rs->fixCnt, sizeof(fix86_t), cmpFix86);
+
+    if (ls->status & ALIGNED)      // reported with the content
+        return;
+    while (li < ls->fixCnt || ri < rs->fixCnt) {
+        if (ri >= rs->fixCnt || (li < ls->fixCnt && lf[li].addr < rf[ri].addr))
+            fixupMissing86(ls, rs, &lf[li++], 1);
+        else if (li >= ls->fixCnt || lf[li].addr > rf[ri].addr)
+            fixupMissing86(ls, rs, &rf[ri++], 0);
+        else if (cmpFixKey(&lf[li], &rf[ri]) != 0) {
+            printSegHeader86(ls, rs);
+            if (jsonMode)
+                jsonDiff(ls->name, "fixup", lf[li].addr, NULL, fixup86Text(&lf[li], lbuf), fixup86Text(&rf[ri], rbuf));
+            else
+                printf("%04X: %s : %s - Fixup different\n", lf[li].addr, fixup86Text(&lf[li], lbuf), fixup86Text(&rf[ri], rbuf));
+            li++;
+            ri++;
+        }
+        else {
+            li++;
+            ri++;
+        }
+    }
+}
+
+static void diffSeg86(seg86_t *ls, seg86_t *rs)
+{
+    char lbuf[12], rbuf[12];
+
+    if (ls->acbp != rs->acbp) {
+        printSegHeader86(ls, rs);
+        sprintf(lbuf, "%02X", ls->acbp);
+        sprintf(rbuf, "%02X", rs->acbp);
+        if (jsonMode)
+            jsonDiff(ls->name, "segment-attributes", -1, NULL, lbuf, rbuf);
+        else
+            printf("%s : %s - Segment attributes different\n", lbuf, rbuf);
+    }
+    else if ((ls->acbp >> 5) == 0 && (ls->frame != rs->frame || ls->frameOffset != rs->frameOffset)) {
+        printSegHeader86(ls, rs);
+        sprintf(lbuf, "%04X:%02X", ls->frame, ls->frameOffset);
+        sprintf(rbuf, "%04X:%02X", rs->frame, rs->frameOffset);
+        if (jsonMode)
+            jsonDiff(ls->name, "segment-frame", -1, NULL, lbuf, rbuf);
+        else
+            printf("%s : %s - Segment frames different\n", lbuf, rbuf);
+    }
+    if (ls->length != rs->length) {
+        printSegHeader86(ls, rs);
+        sprintf(lbuf, "%04X", ls->length);
+        sprintf(rbuf, "%04X", rs->length);
+        if (jsonMode)
+            jsonDiff(ls->name, "segment-size", -1, NULL, lbuf, rbuf);
+        else
+            printf("%s : %s - Segment sizes different\n", lbuf, rbuf);
+    }
+    diffPublics86(ls, rs);
+    diffContent86(ls, rs);
+    diffFixups86(ls, rs);
+}
+
+static int cmpSeg86(const void *a, const void *b)
+{
+    return pstrCmp((*(seg86_t **)a)->name, (*(seg86_t **)b)->name);
+}
+
+static seg86_t **sortedSegs(module86_t *mod, int *cnt)     // segments in name order, segs[0] only if used
+{
+    seg86_t **list = (seg86_t **)xmalloc(mod->segCnt * sizeof(seg86_t *));
+    int i;
+
+    *cnt = 0;
+    for (i = mod->segs[0].pubCnt ? 0 : 1; i < mod->segCnt; i++)
+        list[(*cnt)++] = &mod->segs[i];
+    sortItems(list, *cnt, sizeof(seg86_t *), cmpSeg86);
+    return list;
+}
+
+static void diffSegs86(module86_t *lm, module86_t *rm, int *result, char const **section)
+{
+    int lcnt, rcnt;
+    seg86_t **ls = sortedSegs(lm, &lcnt);
+    seg86_t **rs = sortedSegs(rm, &rcnt);
+    int i = 0, j = 0;
+    int cmp;
+    char buf[260];
+
+    while (i < lcnt || j < rcnt) {
+        if (i == lcnt)
+            cmp = 1;
+        else if (j == rcnt)
+            cmp = -1;
+        else
+            cmp = pstrCmp(ls[i]->name, rs[j]->name);
+        if (cmp < 0) {
+            printSection("Segments", result, section);
+            if (jsonMode)
+                jsonDiff(NULL, "segment", -1, ls[i]->name, pstrToStr(ls[i]->name, buf), NULL);
+            else {
+                printPstrPair(ls[i]->name, (byte *)"\x06------");
+                printf(" - Segment missing\n");
+            }
+            i++;
+        }
+        else if (cmp > 0) {
+            printSection("Segments", result, section);
+            if (jsonMode)
+                jsonDiff(NULL, "segment", -1, rs[j]->name, NULL, pstrToStr(rs[j]->name, buf));
+            else {
+                printPstrPair((byte *)"\x06------", rs[j]->name);
+                printf(" - Segment missing\n");
+            }
+            j++;
+        }
+        else {
+            diffSeg86(ls[i], rs[j]);
+            if (ls[i++]->status & REPORTED) {
+                *result = 0;
+                *section = NULL;        // a missing segment after this one needs the heading again
+            }
+            j++;
+        }
+    }
+    free(ls);
+    free(rs);
+}
+
+static int cmpGrp86(const void *a, const void *b)
+{
+    return pstrCmp(((grp86_t *)a)->name, ((grp86_t *)b)->name);
+}
+
+static void diffGroups86(module86_t *lm, module86_t *rm, int *result, char const **section)
+{
+    grp86_t *lg = lm->groups, *rg = rm->groups;
+    int i = 0, j = 0, li, ri;
+    int cmp;
+    char buf[260];
+
+    sortItems(lg, lm->grpCnt, sizeof(grp86_t), cmpGrp86);
+    sortItems(rg, rm->grpCnt, sizeof(grp86_t), cmpGrp86);
+    while (i < lm->grpCnt || j < rm->grpCnt) {
+        if (i == lm->grpCnt)
+            cmp = 1;
+        else if (j == rm->grpCnt)
+            cmp = -1;
+        else
+            cmp = pstrCmp(lg[i].name, rg[j].name);
+        if (cmp < 0) {
+            printSection("Groups", result, section);
+            if (jsonMode)
+                jsonDiff(NULL, "group", -1, lg[i].name, pstrToStr(lg[i].name, buf), NULL);
+            else {
+                printPstrPair(lg[i].name, (byte *)"\x06------");
+                printf(" - Group missing\n");
+            }
+            i++;
+        }
+        else if (cmp > 0) {
+            printSection("Groups", result, section);
+            if (jsonMode)
+                jsonDiff(NULL, "group", -1, rg[j].name, NULL, pstrToStr(rg[j].name, buf));
+            else {
+                printPstrPair((byte *)"\x06------", rg[j].name);
+                printf(" - Group missing\n");
+            }
+            j++;
+        }
+        else {
+            sortItems(lg[i].members, lg[i].cnt, sizeof(byte *), cmpName);
+            sortItems(rg[j].members, rg[j].cnt, sizeof(byte *), cmpName);
+            for (li = ri = 0; li < lg[i].cnt || ri < rg[j].cnt;) {
+                if (li == lg[i].cnt)
+                    cmp = 1;
+                else if (ri == rg[j].cnt)
+                    cmp = -1;
+                else
+                    cmp = pstrCmp(lg[i].members[li], rg[j].members[ri]);
+                if (cmp == 0) {
+                    li++; ri++;
+                    continue;
+                }
+                printSection("Groups", result, section);
+                if (jsonMode) {
+                    if (cmp < 0)
+                        jsonDiff(NULL, "group-member", -1, lg[i].name, pstrToStr(lg[i].members[li++], buf), NULL);
+                    else
+                        jsonDiff(NULL, "group-member", -1, lg[i].name, NULL, pstrToStr(rg[j].members[ri++], buf));
+                    continue;
+                }
+                printPstr(lg[i].name);
+                printf(": ");
+                if (cmp < 0)
+                    printPstrPair(lg[i].members[li++], (byte *)"\x06------");
+                else
+                    printPstrPair((byte *)"\x06------", rg[j].members[ri++]);
+                printf(" - Group member missing\n");
+            }
+            i++; j++;
+        }
+    }
+}
+
+static void diffExternals86(module86_t *lm, module86_t *rm, int *result, char const **section)
+{
+    int i = 0, j = 0;
+    int cmp;
+    char buf[260];
+
+    sortItems(lm->externals, lm->extCnt, sizeof(byte *), cmpName);
+    sortItems(rm->externals, rm->extCnt, sizeof(byte *), cmpName);
+    while (i < lm->extCnt || j < rm->extCnt) {
+        if (i == lm->extCnt)
+            cmp = 1;
+        else if (j == rm->extCnt)
+            cmp = -1;
+        else
+            cmp = pstrCmp(lm->externals[i], rm->externals[j]);
+        if (cmp < 0) {
+            printSection("Externals", result, section);
+            if (jsonMode)
+                jsonDiff(NULL, "external", -1, lm->externals[i], pstrToStr(lm->externals[i], buf), NULL);
+            else {
+                printPstrPair(lm->externals[i], (byte *)"\x06------");
+                printf(" - External missing\n");
+            }
+            i++;
+        }
+        else if (cmp > 0) {
+            printSection("Externals", result, section);
+            if (jsonMode)
+                jsonDiff(NULL, "external", -1, rm->externals[j], NULL, pstrToStr(rm->externals[j], buf));
+            else {
+                printPstrPair((byte *)"\x06------", rm->externals[j]);
+                printf(" - External missing\n");
+            }
+            j++;
+        }
+        else {
+            i++; j++;
+        }
+    }
+}
+
+static char *start86Text(module86_t *mod, char *buf)
+{
+    strcpy(buf, mod->modType & 0x80 ? "Main" : "Non main");
+    if (mod->modType & 0x40) {
+        strcat(buf, " ");
+        fixRefsText(&mod->start, buf + strlen(buf));
+    }
+    return buf;
+}
+
+/*
+ * returns 1 if the modules are equivalent. result is 1 until the first
+ * difference and 0 after, section is the module level heading last printed
+ */
+static int diffModule86(module86_t *lm, module86_t *rm)
+{
+    int result = 1;
+    char const *section = NULL;
+    char lbuf[600], rbuf[600];
+
+    if (jsonMode)
+        jsonModule(lm->name);
+    else
+        printf(" %.*s", lm->name[0], lm->name + 1);
+    if (!pstrEqu(lm->name, rm->name)) {
+        foundDifference();
+        if (jsonMode)
+            jsonDiff(NULL, "module-name", -1, NULL, pstrToStr(lm->name, lbuf), pstrToStr(rm->name, rbuf));
+        else
+            printf(" : %.*s - Module names different\n", rm->name[0], rm->name + 1);
+        result = 0;
+    }
+    diffSegs86(lm, rm, &result, &section);
+    diffGroups86(lm, rm, &result, &section);
+    diffExternals86(lm, rm, &result, &section);
+    if ((lm->modType & 0xc0) != (rm->modType & 0xc0)
+        || ((lm->modType & 0x40) && cmpFixKey(&lm->start, &rm->start) != 0)) {
+        foundDifference();
+        if (jsonMode)
+            jsonDiff(NULL, "start", -1, NULL, start86Text(lm, lbuf), start86Text(rm, rbuf));
+        else {
+            if (result > 0)
+                putchar('\n');
+            printf("Starts differ - %s : %s", start86Text(lm, lbuf), start86Text(rm, rbuf));
+        }
+        result = 0;
+    }
+    return result > 0;
+}
+
+/* compare two OMF86 modules, returns 1 if they differ */
+int cmpModule86(omf_t *lomf, omf_t *romf)
+{
+    module86_t *lm, *rm = NULL;
+    int result = 0;
+
+    if ((lm = newModule86(lomf)) == NULL || (rm = newModule86(romf)) == NULL) {
+        result = diffBinary(lomf, romf);
+        if (lm) deleteModule86(lm);
+        return result;
+    }
+    if (jsonMode)
+        jsonFiles(lomf->name, romf->name);
+    else
+        printf("%s : %s", lomf->name, romf->name);
+    result = !diffModule86(lm, rm);
+    if (jsonMode)
+        jsonResult(result ? "different" : "equivalent");
+    else
+        printf(result ? "\n" : " *** Equivalent\n");
+    deleteModule86(lm);
+    deleteModule86(rm);
+    return result;
+}
@@ -0,0 +1,55 @@
+/****************************************************************************
+ *                                                                          *
+ *  omfcmp: compare two omf85 files                                         *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+#pragma once
+
+enum {
+    THEADR = 0x80,
+    LHEADR = 0x82,
+    COMENT = 0x88,
+    MODEND86 = 0x8a,
+    EXTDEF = 0x8c,
+    TYPDEF = 0x8e,
+    PUBDEF = 0x90,
+    LOCSYM = 0x92,
+    LINNUM86 = 0x94,
+    LNAMES = 0x96,
+    SEGDEF = 0x98,
+    GRPDEF = 0x9a,
+    FIXUPP = 0x9c,
+    LEDATA = 0xa0,
+    LIDATA = 0xa2,
+    LIBHED = 0xa4,
+    LIBNAM86 = 0xa6,
+    LIBLOC86 = 0xa8,
+    LIBDIC86 = 0xaa,
+    COMDEF = 0xb0,
+    LEXTDEF = 0xb4,
+    LPUBDEF = 0xb6,
+    LCOMDEF = 0xb8,
+    VERNUM = 0xcc,
+    VENDEXT = 0xce,
+    MSLIBHDR = 0xf0,
+    MSLIBEND = 0xf1
+};
+
+int cmpModule86(omf_t *lomf, omf_t *romf);
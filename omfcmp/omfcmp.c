@@ -36,7 +36,8 @@ enum {
     HASINFO = 2,
     CHECKED = 4,
     ERROR = 8,
-    WARNING = 16
+    WARNING = 16,
+    ALIGNED = 32        // content and fixup differences reported by alignment
 };
 
 typedef struct {
@@ -106,15 +107,16 @@ typedef struct {
     byte modType;
     byte startSeg;
     word startOffset;
+    word lastContentAddr;
+    byte lastContentSeg;
 } module_t;
 
 
 int returnCode = 0;
-word lastContentAddr;
-byte lastContentSeg;
 
 
 void deleteModule(module_t *mod);
+static int diffAligned(seg_t *ls, seg_t *rs);
 
 void printPstr(byte *s)
 {
@@ -167,67 +169,121 @@ void addContent(content_t *con, word addr, word length, byte *image)
 {
     checkAllocItem((vector_t *)con, sizeof(struct _content));
 
-    lastContentAddr = con->items[con->cnt].addr = addr;
+    con->items[con->cnt].addr = addr;
     con->items[con->cnt].length = length;
     con->items[con->cnt++].image = image;
 }
 
 #define DUMPLEN	8
+#define SKIPLEN	(DUMPLEN * 64)		// equal spans are skipped this many bytes at a time
+#define CHUNKLEN	0x100000		// read size when streaming, a multiple of SKIPLEN
 
-void dumpDiff(omf_t *left, omf_t *right, int start, int cnt)
+/* print one row of up to DUMPLEN bytes from each side, start is the file offset of the row */
+static void dumpDiff(long long start, byte *left, byte *right, int cnt)
 {
-    printf("%04X:", start);
+    char lhex[DUMPLEN * 3 + 1], rhex[DUMPLEN * 3 + 1];
+
+    if (jsonMode) {
+        for (int i = 0; i < cnt; i++) {
+            sprintf(lhex + i * 3, "%02X ", left[i]);
+            sprintf(rhex + i * 3, "%02X ", right[i]);
+        }
+        lhex[cnt * 3 - 1] = rhex[cnt * 3 - 1] = 0;
+        jsonDiff(NULL, "binary", (long)start, NULL, lhex, rhex);
+        return;
+    }
+    printf("%04llX:", start);
     for (int i = 0; i < DUMPLEN; i++)
         if (i < cnt)
-            printf(" %02X", left->image[start + i]);
+            printf(" %02X", left[i]);
         else
             printf("   ");
     printf(" |");
     for (int i = 0; i < DUMPLEN; i++)
-        printf("%c", i < cnt && isprint(left->image[start + i]) ? left->image[start + i] : '.');
+        printf("%c", i < cnt && isprint(left[i]) ? left[i] : '.');
     printf("| :");
     for (int i = 0; i < DUMPLEN; i++)
         if (i >= cnt)
             printf("   ");
-        else if (left->image[start + i] != right->image[start + i])
-            printf(" %02X", right->image[start + i]);
+        else if (left[i] != right[i])
+            printf(" %02X", right[i]);
         else
             printf(" ==");
     printf(" |");
     for (int i = 0; i < DUMPLEN; i++)
-        printf("%c", i < cnt && isprint(right->image[start + i]) ? right->image[start + i] : '.');
+        printf("%c", i < cnt && isprint(right[i]) ? right[i] : '.');
     printf("|\n");
 }
 
-/* print out the binary differences*/
-void diffBinary(omf_t *left, omf_t *right)
+/* dump the rows that differ in len bytes at file offset base, which is a multiple of DUMPLEN.
+ * memcmp skips the equal spans, so only the spans holding a difference are looked at a row at a time.
+ * returns 1 if any row differs
+ */
+static int diffRows(long long base, byte *left, byte *right, int len)
 {
-    int cmplen = left->size < right->size ? left->size : right->size;
+    int i = 0;
+    int result = 0;
 
-    printf("%s : %s ===Binary difference===\n", left->name, right->name);
+    while (i < len) {
+        int end = len - i < SKIPLEN ? len : i + SKIPLEN;
+        if (memcmp(left + i, right + i, end - i) == 0) {
+            i = end;
+            continue;
+        }
+        for (; i < end; i += DUMPLEN) {
+            int cnt = end - i < DUMPLEN ? end - i : DUMPLEN;
+            if (memcmp(left + i, right + i, cnt) != 0) {
+                foundDifference();			// with -q any byte difference counts
+                dumpDiff(base + i, left + i, right + i, cnt);
+                result = 1;
+            }
+        }
+    }
+    return result;
+}
 
-    int i = 0;
-    while (i < cmplen) {
-        if (left->image[i] != right->image[i]) {
-            i = (i / DUMPLEN) * DUMPLEN;		// truncate to block boundary
-            dumpDiff(left, right, (i / DUMPLEN) * DUMPLEN, (i + DUMPLEN <= cmplen) ? DUMPLEN : cmplen - i);
-            i += DUMPLEN;
+static void binaryHeader(char *lname, char *rname)
+{
+    if (jsonMode)
+        jsonFiles(lname, rname);
+    else
+        printf("%s : %s ===Binary difference===\n", lname, rname);
+}
+
+/* report and finish a binary difference, returns 1 if the lengths differ */
+static int binaryTail(char *lname, char *rname, long long lsize, long long rsize)
+{
+    char lstr[24], rstr[24];
+    int result = 0;
+
+    if (lsize != rsize) {
+        foundDifference();
+        if (jsonMode) {
+            sprintf(lstr, "%lld", lsize);
+            sprintf(rstr, "%lld", rsize);
+            jsonDiff(NULL, "length", -1, NULL, lstr, rstr);
         }
         else
-            i++;
+            printf("%s is longer\n", lsize > rsize ? lname : rname);
+        result = 1;
     }
+    if (jsonMode)
+        jsonResult("binary");
+    return result;
+}
 
-    if (left->size > right->size) {
-        printf("%s is longer\n", left->name);
-        returnCode = 1;
-    }
-    else if (left->size < right->size) {
-        printf("%s is longer\n", right->name);
-        returnCode = 1;
-    }
+/* print out the binary differences, returns 1 if the files differ in any byte or in length */
+int diffBinary(omf_t *left, omf_t *right)
+{
+    int result;
+
+    binaryHeader(left->name, right->name);
+    result = diffRows(0, left->image, right->image, left->size < right->size ? left->size : right->size);
+    return binaryTail(left->name, right->name, left->size, right->size) || result;
 }
 
 
+
 int findSegByName(module_t *mod, byte *name)
 {
     int i;
@@ -272,12 +328,12 @@ void content(omf_t *omf, module_t *mod)
     word addr;
     word length;
 
-    lastContentSeg = getByte(omf);
-    if (lastContentSeg > mod->maxSeg) mod->maxSeg = lastContentSeg;
+    mod->lastContentSeg = getByte(omf);
+    if (mod->lastContentSeg > mod->maxSeg) mod->maxSeg = mod->lastContentSeg;
 
-    seg = &mod->segs[lastContentSeg];
+    seg = &mod->segs[mod->lastContentSeg];
     seg->status |= HASINFO;
-    addr = getWord(omf);
+    mod->lastContentAddr = addr = getWord(omf);
     length = omf->lengthRec - 4;
 
     addContent(&seg->contents, addr, length, omf->image + omf->pos);
@@ -315,7 +371,7 @@ void extnam(omf_t *omf, module_t *mod)
 void extref(omf_t *omf, module_t *mod)
 {
     word extId;
-    seg_t *seg = &mod->segs[lastContentSeg];
+    seg_t *seg = &mod->segs[mod->lastContentSeg];
 
     byte type = getByte(omf);
     while (!atEndOfRecord(omf)) {
@@ -327,16 +383,16 @@ void extref(omf_t *omf, module_t *mod)
 
 void reloc(omf_t *omf, module_t *mod)
 {
-    seg_t *seg = &mod->segs[lastContentSeg];
+    seg_t *seg = &mod->segs[mod->lastContentSeg];
 
     byte type = getByte(omf);
     while (!atEndOfRecord(omf))
-        addFixup(&seg->fixups, lastContentSeg, mod->segs[lastContentSeg].name, getWord(omf), type);
+        addFixup(&seg->fixups, mod->lastContentSeg, mod->segs[mod->lastContentSeg].name, getWord(omf), type);
 }
 void intseg(omf_t *omf, module_t *mod)
 {
     word segId;
-    seg_t *seg = &mod->segs[lastContentSeg];
+    seg_t *seg = &mod->segs[mod->lastContentSeg];
 
     segId = getByte(omf);
     byte type = getByte(omf);
@@ -435,8 +491,14 @@ void deleteModule(module_t *mod)
 
 void printSegHeader(seg_t *ls, seg_t *rs, int status)
 {
-    if ((ls->status & (ERROR | WARNING)) == 0)
-        printf("\n%.*s:\n", ls->name[0], ls->name + 1);
+    if (status & ERROR)
+        foundDifference();
+    if ((ls->status & (ERROR | WARNING)) == 0) {
+        if (jsonMode)
+            jsonSegment(ls->name);
+        else
+            printf("\n%.*s:\n", ls->name[0], ls->name + 1);
+    }
     ls->status |= status;
     rs->status |= status;
 }
@@ -460,6 +522,7 @@ void diffPublics(module_t *lm, byte lseg, module_t *rm, byte rseg)
     int cmp;
     public_t *lp, *rp;
     seg_t *ls, *rs;
+    char laddr[8], raddr[8];
 
     ls = &lm->segs[lseg];
     rs = &rm->segs[rseg];
@@ -483,21 +546,40 @@ void diffPublics(module_t *lm, byte lseg, module_t *rm, byte rseg)
             cmp = pstrCmp(lp->items[i].name, rp->items[j].name);
         if (cmp < 0) {
             printSegHeader(ls, rs, ERROR);
-            printPstrPair(lp->items[i].name, (byte *)"\x06------");
-            printf(" - Public missing\n");
+            if (jsonMode) {
+                sprintf(laddr, "%04X", lp->items[i].addr);
+                jsonDiff(ls->name, "public", -1, lp->items[i].name, laddr, NULL);
+            }
+            else {
+                printPstrPair(lp->items[i].name, (byte *)"\x06------");
+                printf(" - Public missing\n");
+            }
             i++;
         }
         else if (cmp > 0) {
             printSegHeader(ls, rs, ERROR);
-            printPstrPair((byte *)"\x06------",rp->items[j].name);
-            printf(" - Public missing\n");
+            if (jsonMode) {
+                sprintf(raddr, "%04X", rp->items[j].addr);
+                jsonDiff(ls->name, "public", -1, rp->items[j].name, NULL, raddr);
+            }
+            else {
+                printPstrPair((byte *)"\x06------",rp->items[j].name);
+                printf(" - Public missing\n");
+            }
             j++;
         }
         else {
             if (lp->items[i].addr != rp->items[j].addr) {
                 printSegHeader(ls, rs, ERROR);
-                printPstrPair(lp->items[i].name, rp->items[j].name);
-                printf(" - Public addresses different %04X : %04X\n", lp->items[i].addr, rp->items[j].addr);
+                if (jsonMode) {
+                    sprintf(laddr, "%04X", lp->items[i].addr);
+                    sprintf(raddr, "%04X", rp->items[j].addr);
+                    jsonDiff(ls->name, "public", -1, lp->items[i].name, laddr, raddr);
+                }
+                else {
+                    printPstrPair(lp->items[i].name, rp->items[j].name);
+                    printf(" - Public addresses different %04X : %04X\n", lp->items[i].addr, rp->items[j].addr);
+                }
             }
             i++; j++;
         }
@@ -516,12 +598,21 @@ int cmpContent(const void *a, const void *b)
 
 
 
-#define MAXRUN  8
-
-void emitRun(int addr, int run, short *lrun, short *rrun)
+void emitRun(byte *seg, int addr, int run, short *lrun, short *rrun)
 {
+    char lbytes[MAXRUN * 3 + 1], rbytes[MAXRUN * 3 + 1];
+
     if (run == 0)
         return;
+    if (jsonMode) {
+        for (int i = 0; i < run; i++) {
+            sprintf(lbytes + i * 3, lrun[i] < 0 ? "-- " : "%02X ", lrun[i]);
+            sprintf(rbytes + i * 3, rrun[i] < 0 ? "-- " : "%02X ", rrun[i]);
+        }
+        lbytes[run * 3 - 1] = rbytes[run * 3 - 1] = 0;
+        jsonDiff(seg, "content", addr, NULL, lbytes, rbytes);
+        return;
+    }
     printf("%04X", addr);
     for (int i = 0; i < run; i++)
         if (lrun[i] < 0)
@@ -537,6 +628,23 @@ void emitRun(int addr, int run, short *lrun, short *rrun)
     putchar('\n');
 }
 
+/* returns the number of leading bytes that are the same, comparing a word at a time */
+int sameLength(byte *s, byte *t, int len)
+{
+    uint64_t ls, lt;
+    int i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        memcpy(&ls, s + i, 8);
+        memcpy(&lt, t + i, 8);
+        if (ls != lt)
+            break;
+    }
+    while (i < len && s[i] == t[i])
+        i++;
+    return i;
+}
+
 void diffContent(module_t *lm, byte lseg, module_t *rm, byte rseg)
 {
     seg_t *ls, *rs;
@@ -547,6 +655,7 @@ void diffContent(module_t *lm, byte lseg, module_t *rm, byte rseg)
     int run = 0;        // count of different items used to format
     int arun = -1;       // start address of difference run
     short lrun[MAXRUN], rrun[MAXRUN]; // the run values -ve for missing
+    int same;           // length of matching bytes
 
 
     ls = &lm->segs[lseg];
@@ -558,6 +667,9 @@ void diffContent(module_t *lm, byte lseg, module_t *rm, byte rseg)
     qsort(lc->items, (size_t)lc->cnt, sizeof(content_t), &cmpContent);
     qsort(rc->items, (size_t)rc->cnt, sizeof(content_t), &cmpContent);
 
+    if (alignMode && diffAligned(ls, rs))
+        return;
+
     lcb = rcb = 0;
     laddr = raddr = -1;
     li = ri = 0;
@@ -571,7 +683,7 @@ void diffContent(module_t *lm, byte lseg, module_t *rm, byte rseg)
             ri = 0;
         }
         if (run && (laddr < 0 || arun + run != laddr + li) && (raddr < 0 || arun + run != raddr + ri)) {
-            emitRun(arun, run, lrun, rrun);
+            emitRun(ls->name, arun, run, lrun, rrun);
             run = 0;
         }
         if (raddr < 0 || (laddr >= 0 && laddr + li < raddr + ri)) {
@@ -599,13 +711,17 @@ void diffContent(module_t *lm, byte lseg, module_t *rm, byte rseg)
             li++; ri++;
         }
         else {
-            emitRun(arun, run, lrun, rrun);
+            emitRun(ls->name, arun, run, lrun, rrun);
             run = 0;
-            li++; ri++;
+            /* the addresses are aligned, so skip the rest of the matching span in one go */
+            same = sameLength(lc->items[lcb].image + li, rc->items[rcb].image + ri,
+                              lc->items[lcb].length - li < rc->items[rcb].length - ri ?
+                              lc->items[lcb].length - li : rc->items[rcb].length - ri);
+            li += same; ri += same;
         }
 
         if (run == MAXRUN) {
-            emitRun(arun, run, lrun, rrun);
+            emitRun(ls->name, arun, run, lrun, rrun);
             run = 0;
         }
         if (laddr >= 0 && li >= lc->items[lcb].length) {
@@ -618,7 +734,7 @@ void diffContent(module_t *lm, byte lseg, module_t *rm, byte rseg)
         }
 
     }
-    emitRun(arun, run, lrun, rrun);
+    emitRun(ls->name, arun, run, lrun, rrun);
 }
 
 int cmpFixup(const void *a, const void *b)
@@ -632,16 +748,103 @@ int cmpFixup(const void *a, const void *b)
     return cmp;
 }
 
+char *fixupText(struct _fixup *fix, char *buf)	// buf needs room for the name plus 10 chars
+{
+    sprintf(buf, fix->segId < 256 ? "%s(%.*s)" : "%s\"%.*s\"", fix->type == 1 ? "low " : fix->type == 2 ? "high " : "",
+            fix->name[0], fix->name + 1);
+    return buf;
+}
+
 void printFixup(struct _fixup *fix)
 {
-    if (fix->type == 1)
-        printf("low ");
-    else if (fix->type == 2)
-        printf("high ");
-    if (fix->segId < 256)
-        printf("(%.*s)", fix->name[0], fix->name + 1);
-    else
-        printf("\"%*s\"", fix->name[0], fix->name + 1);
+    char buf[266];
+
+    printf("%s", fixupText(fix, buf));
+}
+
+static int sameFixupKey(struct _fixup *a, struct _fixup *b)     // everything but the address
+{
+    return a->segId == b->segId && (a->segId < 256 || pstrEqu(a->name, b->name)) && a->type == b->type;
+}
+
+static int matchFixups(void *arg, int x, int y, int len)
+{
+    seg_t **segs = arg;
+    int i = 0;
+
+    while (i < len && sameFixupKey(&segs[0]->fixups.items[x + i], &segs[1]->fixups.items[y + i]))
+        i++;
+    return i;
+}
+
+static void fixupMissing(seg_t *ls, seg_t *rs, struct _fixup *fix, int left)     // fix is only in the left or right segment
+{
+    char buf[266];
+
+    printSegHeader(ls, rs, ERROR);
+    if (jsonMode)
+        jsonDiff(ls->name, "fixup", fix->addr, NULL, left ? fixupText(fix, buf) : NULL, left ? NULL : fixupText(fix, buf));
+    else if (left) {
+        printf("%04X: ", fix->addr);
+        printFixup(fix);
+        printf(" : ------ - Fixup missing\n");
+    }
+    else {
+        printf("%04X: ------ :", fix->addr);
+        printFixup(fix);
+        printf(" - Fixup missing\n");
+    }
+}
+
+static void alignedFixupMissing(void *arg, int index, int left)
+{
+    seg_t **segs = arg;
+
+    fixupMissing(segs[0], segs[1], &segs[left ? 0 : 1]->fixups.items[index], left);
+}
+
+static void segStream(seg_t *seg, stream_t *s)     // content already sorted by address
+{
+    content_t *c = &seg->contents;
+    uint32_t *addrs;
+
+    memset(s, 0, sizeof(stream_t));
+    for (int i = 0; i < c->cnt; i++)
+        for (int j = 0; j < c->items[i].length; j++)
+            addStreamByte(s, c->items[i].image[j], c->items[i].addr + j);
+    qsort(seg->fixups.items, (size_t)seg->fixups.cnt, sizeof(struct _fixup), cmpFixup);
+    addrs = (uint32_t *)xmalloc((seg->fixups.cnt + 1) * sizeof(uint32_t));
+    for (int i = 0; i < seg->fixups.cnt; i++)
+        addrs[i] = seg->fixups.items[i].addr;
+    setFixupPos(s, addrs, seg->fixups.cnt);
+    free(addrs);
+}
+
+/*
+ * reports the content and fixup differences of the aligned segments
+ * returns 0 if the content is the same or too different to align, so is left to the address comparison
+ */
+static int diffAligned(seg_t *ls, seg_t *rs)
+{
+    stream_t l, r;
+    hunk_t *hunks;
+    seg_t *segs[2] = { ls, rs };
+    int cnt;
+
+    segStream(ls, &l);
+    segStream(rs, &r);
+    cnt = alignStreams(&l, &r, alignMode == ALIGNFIXUPS ? matchFixups : NULL, segs, &hunks);
+    if (cnt > 0) {
+        printSegHeader(ls, rs, ERROR | ALIGNED);
+        for (int i = 0; i < cnt; i++)
+            emitHunk(ls->name, &l, &r, &hunks[i]);
+        alignFixups(&l, &r, hunks, cnt, matchFixups, segs, alignedFixupMissing);
+    }
+    if (cnt >= 0)
+        free(hunks);
+    deleteStream(&l);
+    deleteStream(&r);
+    return cnt > 0;
 }
 
 void diffFixups(module_t *lm, byte lseg, module_t *rm, byte rseg)
@@ -650,6 +853,7 @@ void diffFixups(module_t *lm, byte lseg, module_t *rm, byte rseg)
     fixup_t *lf, *rf;
 
     int li, ri;        // index into fixups
+    char lbuf[266], rbuf[266];
 
     ls = &lm->segs[lseg];
     rs = &rm->segs[rseg];
@@ -660,24 +864,23 @@ void diffFixups(module_t *lm, byte lseg, module_t *rm, byte rseg)
     qsort(lf->items, (size_t)lf->cnt, sizeof(struct _fixup), &cmpFixup);
     qsort(rf->items, (size_t)rf->cnt, sizeof(struct _fixup), &cmpFixup);
 
+    if (ls->status & ALIGNED)      // reported with the content
+        return;
     li = ri = 0;
     while (li < lf->cnt || ri < rf->cnt) {
-        if (ri >= rf->cnt || (li < lf->cnt && lf->items[li].addr < rf->items[ri].addr)) {
-            printSegHeader(ls, rs, ERROR);
-            printf("%04X: ", lf->items[li].addr);
-            printFixup(&lf->items[li++]);
-            printf(" : ------ - Fixup missing\n");
-        }
-        else if (li >= lf->cnt || (ri < rf->cnt && lf->items[li].addr > rf->items[ri].addr)) {
-            printSegHeader(ls, rs, ERROR);
-            printf("%04X: ------ :", rf->items[ri].addr);
-            printFixup(&rf->items[ri++]);
-            printf(" - Fixup missing\n");
-        }
+        if (ri >= rf->cnt || (li < lf->cnt && lf->items[li].addr < rf->items[ri].addr))
+            fixupMissing(ls, rs, &lf->items[li++], 1);
+        else if (li >= lf->cnt || (ri < rf->cnt && lf->items[li].addr > rf->items[ri].addr))
+            fixupMissing(ls, rs, &rf->items[ri++], 0);
         else if (lf->items[li].segId != rf->items[ri].segId ||
             (lf->items[li].segId > 255 && !pstrEqu(lf->items[li].name, rf->items[ri].name)) ||
             lf->items[li].type != rf->items[ri].type) {
             printSegHeader(ls, rs, ERROR);
+            if (jsonMode) {
+                jsonDiff(ls->name, "fixup", lf->items[li].addr, NULL, fixupText(&lf->items[li], lbuf), fixupText(&rf->items[ri], rbuf));
+                li++; ri++;
+                continue;
+            }
             printf("%04X ", lf->items[li].addr);
             printFixup(&lf->items[li++]);
             printf(" : ");
@@ -697,6 +900,7 @@ void diffFixups(module_t *lm, byte lseg, module_t *rm, byte rseg)
 int diffExternals(module_t *lm, module_t *rm, int result)
 {
     int i, j;
+    char buf[256];
 
     /* check that any unused externals match */
     for (i = 0; i < lm->externals.cnt; i++) {
@@ -705,9 +909,14 @@ int diffExternals(module_t *lm, module_t *rm, int result)
                 break;
 
         if (j == rm->externals.cnt) {
-            if (result == 1) printf("\nExternals:\n");
-            printPstrPair(lm->externals.items[i].name, (byte *)"\x06------");
-            printf(" - External missing\n");
+            foundDifference();
+            if (jsonMode)
+                jsonDiff(NULL, "external", -1, lm->externals.items[i].name, pstrToStr(lm->externals.items[i].name, buf), NULL);
+            else {
+                if (result == 1) printf("\nExternals:\n");
+                printPstrPair(lm->externals.items[i].name, (byte *)"\x06------");
+                printf(" - External missing\n");
+            }
             result = 0;
         } else
             rm->externals.items[j].status |= CHECKED;
@@ -715,9 +924,14 @@ int diffExternals(module_t *lm, module_t *rm, int result)
     }
     for (j = 0; j < rm->externals.cnt; j++)
         if (!(rm->externals.items[j].status & CHECKED)) {
-            if (result == 1) printf("\nExternals:\n");
-            printPstrPair((byte *)"\06------", rm->externals.items[j].name);
-            printf(" - External missing\n");
+            foundDifference();
+            if (jsonMode)
+                jsonDiff(NULL, "external", -1, rm->externals.items[j].name, NULL, pstrToStr(rm->externals.items[j].name, buf));
+            else {
+                if (result == 1) printf("\nExternals:\n");
+                printPstrPair((byte *)"\06------", rm->externals.items[j].name);
+                printf(" - External missing\n");
+            }
             result = 0;
             rm->externals.items[j].status |= CHECKED;
         }
@@ -725,52 +939,93 @@ int diffExternals(module_t *lm, module_t *rm, int result)
 }
 
 
-void printCompiler(int compiler, int version)
+char *compilerText(byte compiler, byte version, char *buf)
 {
     switch (compiler) {
-    case 1: printf("PLM_%d.%d", version / 16, version % 16); return;
-    case 2: printf("FORT_%d.%d", version / 16, version % 16); return;
-    case 0: if (version == 0) return;
-    default: printf("%02X_%02X", compiler, version);
+    case 1: sprintf(buf, "PLM_%d.%d", version / 16, version % 16); break;
+    case 2: sprintf(buf, "FORT_%d.%d", version / 16, version % 16); break;
+    case 0: if (version == 0) { buf[0] = 0; break; }
+    default: sprintf(buf, "%02X_%02X", compiler, version);
     }
+    return buf;
+}
+
+void printCompiler(byte compiler, byte version)
+{
+    char buf[16];
+
+    printf("%s", compilerText(compiler, version, buf));
+}
+
+char *startText(module_t *mod, char *buf)	// Main|Non main [seg:offset]
+{
+    strcpy(buf, mod->modType ? "Main" : "Non main");
+    if (mod->modType || mod->startSeg || mod->startOffset)
+        sprintf(buf + strlen(buf), " %.*s:%04X", mod->segs[mod->startSeg].name[0], mod->segs[mod->startSeg].name + 1, mod->startOffset);
+    return buf;
 }
 
 int diffModule(module_t *lm, module_t *rm)
 {
     int i, j;
     int result = 1;
+    char lbuf[300], rbuf[300];
 
-    printf(" %.*s ", lm->name[0], lm->name + 1);
-    printCompiler(lm->compiler[0], lm->compiler[1]);
-    if (!pstrEqu((byte *)lm->name, (byte *)rm->name)) {
-        printf(" : %.*s", rm->name[0], rm->name + 1);
-        result = 0;
+    if (jsonMode) {
+        jsonModule((byte *)lm->name);
+        if (!pstrEqu((byte *)lm->name, (byte *)rm->name)) {
+            foundDifference();
+            jsonDiff(NULL, "module-name", -1, NULL, pstrToStr((byte *)lm->name, lbuf), pstrToStr((byte *)rm->name, rbuf));
+            result = 0;
+        }
+        if (lm->compiler[0] != rm->compiler[0] || lm->compiler[1] != rm->compiler[1])
+            jsonDiff(NULL, "compiler", -1, NULL, compilerText(lm->compiler[0], lm->compiler[1], lbuf),
+                     compilerText(rm->compiler[0], rm->compiler[1], rbuf));
     }
+    else {
+        printf(" %.*s ", lm->name[0], lm->name + 1);
+        printCompiler(lm->compiler[0], lm->compiler[1]);
+        if (!pstrEqu((byte *)lm->name, (byte *)rm->name)) {
+            foundDifference();
+            printf(" : %.*s", rm->name[0], rm->name + 1);
+            result = 0;
+        }
 
-    if (lm->compiler[0] != rm->compiler[0] || lm->compiler[1] != rm->compiler[1]) {
-        printf(result ? " : " : " ");
-        printCompiler(rm->compiler[0], rm->compiler[1]);
+        if (lm->compiler[0] != rm->compiler[0] || lm->compiler[1] != rm->compiler[1]) {
+            printf(result ? " : " : " ");
+            printCompiler(rm->compiler[0], rm->compiler[1]);
+        }
+        if (!result)
+            printf(" - Module names different\n");
     }
-    if (!result)
-        printf(" - Module names different\n");
 
 
     for (i = 0; i <= lm->maxSeg; i++) {
         if (lm->segs[i].status) {
             j = (i < 5 || i == 255) ? i : findSegByName(rm, lm->segs[i].name);
             if (j < 0 || rm->segs[j].status == 0) {
-                  if (result) {
-                    putchar('\n');
-                    result = 0;
+                foundDifference();
+                if (jsonMode)
+                    jsonDiff(NULL, "segment", -1, lm->segs[i].name, pstrToStr(lm->segs[i].name, lbuf), NULL);
+                else {
+                    if (result)
+                        putchar('\n');
+                    printPstrPair(lm->segs[i].name, (byte *)"\x06------");
+                    printf(" - Segment missing\n");
                 }
-                printPstrPair(lm->segs[i].name, (byte *)"\x06------");
-                printf(" - Segment missing\n");
+                result = 0;
                 lm->segs[i].status |= ERROR + CHECKED;
             }
             else {
                 if (lm->segs[i].length != rm->segs[j].length) {
                     printSegHeader(&lm->segs[i], &rm->segs[j], ERROR);
-                    printf("%04X : %04X - Segment sizes different\n", lm->segs[i].length, rm->segs[j].length);
+                    if (jsonMode) {
+                        sprintf(lbuf, "%04X", lm->segs[i].length);
+                        sprintf(rbuf, "%04X", rm->segs[j].length);
+                        jsonDiff(lm->segs[i].name, "segment-size", -1, NULL, lbuf, rbuf);
+                    }
+                    else
+                        printf("%04X : %04X - Segment sizes different\n", lm->segs[i].length, rm->segs[j].length);
                 }
                 diffPublics(lm, i, rm, j);
                 diffContent(lm, i, rm, j);
@@ -786,14 +1041,20 @@ int diffModule(module_t *lm, module_t *rm)
         }
     }
     for (j = 1; j <= rm->maxSeg; j++)
-        if (rm->segs[i].status && (rm->segs[j].status & CHECKED) == 0) {
-            putchar('\n');
-            printPstrPair((byte *)"\x06------", rm->segs[j].name);
-            printf(" - Segment missing");
+        if (rm->segs[j].status && (rm->segs[j].status & CHECKED) == 0) {
             if (j == 4 && rm->segs[j].length == 0) {
-                printf(" - benign as length 0");
+                if (!jsonMode)
+                    printf("\n------ : %.*s - Segment missing - benign as length 0", rm->segs[j].name[0], rm->segs[j].name + 1);
                 rm->segs[j].status |= CHECKED;
             } else {
+                foundDifference();
+                if (jsonMode)
+                    jsonDiff(NULL, "segment", -1, rm->segs[j].name, NULL, pstrToStr(rm->segs[j].name, rbuf));
+                else {
+                    putchar('\n');
+                    printPstrPair((byte *)"\x06------", rm->segs[j].name);
+                    printf(" - Segment missing");
+                }
                 rm->segs[j].status |= ERROR + CHECKED;
                 result = 0;
             }
@@ -804,17 +1065,17 @@ int diffModule(module_t *lm, module_t *rm)
     if (!diffExternals(lm, rm, result))
         result = 0;
     if (lm->modType != rm->modType || lm->startSeg != rm->startSeg || lm->startOffset != rm->startOffset) {
-        if (result)
-            putchar('\n');
-        printf("Starts differ - ");
-        printf("%s", lm->modType ? "Main" : "Non main");
-        if (lm->modType || lm->startSeg || lm->startOffset)
-            printf(" %.*s:%04X", lm->segs[lm->startSeg].name[0], lm->segs[lm->startSeg].name + 1, lm->startOffset);
-        printf(" : %s", rm->modType ? "Main" : "Non main");
-        if (rm->modType || rm->startSeg || rm->startOffset)
-            printf(" %.*s:%04X", rm->segs[rm->startSeg].name[0], rm->segs[rm->startSeg].name + 1, rm->startOffset);
-        if ((lm->modType == 0 && (lm->startSeg || lm->startOffset)) || (rm->modType == 0 && (rm->startSeg || rm->startOffset)))
-            printf(" - benign non compliance");
+        if (lm->modType != rm->modType || (lm->modType == 1 && lm->startSeg != rm->startSeg && lm->startOffset != rm->startOffset))
+            foundDifference();
+        if (jsonMode)
+            jsonDiff(NULL, "start", -1, NULL, startText(lm, lbuf), startText(rm, rbuf));
+        else {
+            if (result)
+                putchar('\n');
+            printf("Starts differ - %s : %s", startText(lm, lbuf), startText(rm, rbuf));
+            if ((lm->modType == 0 && (lm->startSeg || lm->startOffset)) || (rm->modType == 0 && (rm->startSeg || rm->startOffset)))
+                printf(" - benign non compliance");
+        }
         if (lm->modType != rm->modType || (lm->modType == 1 && lm->startSeg != rm->startSeg && lm->startOffset != rm->startOffset))
             result = 0;
     }
@@ -827,26 +1088,220 @@ int diffModule(module_t *lm, module_t *rm)
 
 
 
-void cmpModule(omf_t *lomf, omf_t *romf)
+/*
+ * fingerprint support
+ * The fingerprint is a hash of everything diffModule compares, put into a
+ * canonical order: publics sorted by name, content as runs of contiguous bytes
+ * in address order whatever the record split, fixups sorted by address and
+ * externals sorted by name. Equal fingerprints therefore mean diffModule would
+ * report the modules as equivalent with nothing else to say.
+ * Segments are kept by index, as fixups and the start address refer to them
+ * by index. Modules where diffModule's result depends on more than the
+ * canonical view, i.e. repeated segment names, overlapping content or more
+ * than one fixup at an address, get a fingerprint of 0 and are always parsed.
+ */
+int cmpFixupKey(const void *a, const void *b)
 {
-    module_t *lm, *rm;
+    int cmp;
+    const struct _fixup *ap = a;
+    const struct _fixup *bp = b;
 
-    if ((lm = newModule(lomf)) == NULL || (rm = newModule(romf)) == NULL) {
-        diffBinary(lomf, romf);
-        if (lm) deleteModule(lm);
+    if ((cmp = ap->addr - bp->addr) == 0 && (cmp = ap->segId - bp->segId) == 0
+        && (ap->segId < 256 || (cmp = pstrCmp(ap->name, bp->name)) == 0))
+        cmp = ap->type - bp->type;
+    return cmp;
+}
+
+int cmpExternal(const void *a, const void *b)
+{
+    return pstrCmp(((const struct _extern *)a)->name, ((const struct _extern *)b)->name);
+}
+
+uint64_t hashWord(uint64_t hash, word val)
+{
+    byte buf[2] = { val & 0xff, val >> 8 };
+    return hashBytes(hash, buf, 2);
+}
+
+void *sortedCopy(void *items, int cnt, size_t size, int (*cmp)(const void *, const void *))
+{
+    void *copy = xmalloc(cnt * size + 1);
+
+    if (cnt) {
+        memcpy(copy, items, cnt * size);
+        qsort(copy, (size_t)cnt, size, cmp);
+    }
+    return copy;
+}
+
+uint64_t hashContent(uint64_t hash, content_t *con, int *ok)
+{
+    struct _content *items = sortedCopy(con->items, con->cnt, sizeof(struct _content), cmpContent);
+    byte *run = xmalloc(0x10000 + 1);
+    int i, len = 0;
+    long end = -1;		// address after the current run
+
+    hash = hashWord(hash, con->cnt ? 1 : 0);
+    for (i = 0; i < con->cnt && *ok; i++) {
+        if (items[i].addr < end || items[i].length == 0)	// overlapping or empty blocks
+            *ok = 0;
+        else {
+            if (items[i].addr != end) {	// a gap, so start a new run
+                if (len)
+                    hash = hashBytes(hashWord(hashWord(hash, (word)(end - len)), (word)len), run, len);
+                len = 0;
+            }
+            if (len + items[i].length > 0x10000)
+                *ok = 0;
+            else {
+                memcpy(run + len, items[i].image, items[i].length);
+                len += items[i].length;
+                end = items[i].addr + items[i].length;
+            }
+        }
+    }
+    if (len)
+        hash = hashBytes(hashWord(hashWord(hash, (word)(end - len)), (word)len), run, len);
+    free(run);
+    free(items);
+    return hash;
+}
+
+uint64_t fingerprint(module_t *mod)
+{
+    uint64_t hash = 0x9E3779B97F4A7C15ULL;
+    seg_t *seg;
+    struct _public *pub;
+    struct _fixup *fix;
+    struct _extern *ext;
+    int i, j;
+    int ok = 1;
+
+    hash = hashBytes(hash, (byte *)mod->name, mod->name[0] + 1);
+    hash = hashBytes(hash, mod->compiler, 2);
+    hash = hashWord(hash, mod->modType);
+    hash = hashWord(hash, mod->startSeg);
+    hash = hashWord(hash, mod->startOffset);
+    for (i = 0; i <= mod->maxSeg && ok; i++) {
+        seg = &mod->segs[i];
+        if (seg->status == 0)
+            continue;
+        hash = hashWord(hash, i);
+        if (i >= 5 && i != 255) {
+            if (!seg->name || findSegByName(mod, seg->name) != i)
+                break;
+            hash = hashBytes(hash, seg->name, seg->name[0] + 1);
+        }
+        hash = hashWord(hash, seg->length);
+
+        pub = sortedCopy(seg->publics.items, seg->publics.cnt, sizeof(struct _public), cmpPublic);
+        hash = hashWord(hash, seg->publics.cnt);
+        for (j = 0; j < seg->publics.cnt; j++)
+            hash = hashBytes(hashWord(hash, pub[j].addr), pub[j].name, pub[j].name[0] + 1);
+        free(pub);
+
+        hash = hashContent(hash, &seg->contents, &ok);
+
+        fix = sortedCopy(seg->fixups.items, seg->fixups.cnt, sizeof(struct _fixup), cmpFixupKey);
+        hash = hashWord(hash, seg->fixups.cnt);
+        for (j = 0; j < seg->fixups.cnt; j++) {
+            if (j && fix[j].addr == fix[j - 1].addr)
+                ok = 0;
+            hash = hashWord(hashWord(hashWord(hash, fix[j].addr), fix[j].segId), fix[j].type);
+            if (fix[j].segId > 255)
+                hash = hashBytes(hash, fix[j].name, fix[j].name[0] + 1);
+        }
+        free(fix);
+    }
+    if (i <= mod->maxSeg)			// stopped early on a repeated or missing segment name
+        ok = 0;
+
+    ext = sortedCopy(mod->externals.items, mod->externals.cnt, sizeof(struct _extern), cmpExternal);
+    hash = hashWord(hash, mod->externals.cnt);
+    for (j = 0; j < mod->externals.cnt; j++)
+        hash = hashBytes(hash, ext[j].name, ext[j].name[0] + 1);
+    free(ext);
+
+    if (!ok)
+        return 0;
+    hash = hashFinal(hash);
+    return hash ? hash : 1;
+}
+
+/* parses the module and caches its fingerprint, returns 0 if it isn't a valid module */
+int parseFingerprint(omf_t *omf, module_t **mod, uint64_t *fp)
+{
+    if ((*mod = newModule(omf)) == NULL)
+        return 0;
+    *fp = fingerprint(*mod);
+    saveFingerprint(omf, *fp);
+    return 1;
+}
+
+/* the result line diffModule prints for modules with the same fingerprint */
+void printEquivalent(omf_t *lomf, omf_t *romf)
+{
+    byte *name = (byte *)"";
+    byte compiler[2] = { 0, 0 };
+
+    seekRecord(lomf, 0);
+    while (!lomf->error)
+        if (getRecord(lomf) == MODHDR) {
+            name = getName(lomf);
+            compiler[0] = getByte(lomf);
+            compiler[1] = getByte(lomf);
+            break;
+        }
+    if (jsonMode) {
+        jsonFiles(lomf->name, romf->name);
+        jsonModule(name);
+        jsonResult("equivalent");
         return;
     }
-    printf("%s : %s", lomf->name, romf->name);
+    printf("%s : %s %.*s ", lomf->name, romf->name, name[0], name + 1);
+    printCompiler(compiler[0], compiler[1]);
+    printf(" *** Equivalent\n");
+}
 
-    
-    if (diffModule(lm, rm))
-        printf(" *** Equivalent\n");
-    else {
-        putchar('\n');
-        returnCode = 1;
+/* compare two modules, returns 1 if they differ. All state is local so
+ * library modules can be compared in parallel
+ */
+int cmpModule(omf_t *lomf, omf_t *romf)
+{
+    module_t *lm = NULL, *rm = NULL;
+    uint64_t lfp, rfp;
+    int result = 0;
+
+    /* with a fingerprint cache, only modules without a current entry are
+     * parsed before comparing fingerprints, and if they agree that is all
+     */
+    if (cacheEnabled() && (findFingerprint(lomf, &lfp) || parseFingerprint(lomf, &lm, &lfp))
+        && (findFingerprint(romf, &rfp) || parseFingerprint(romf, &rm, &rfp)) && lfp && lfp == rfp) {
+        printEquivalent(lomf, romf);
+        if (lm) deleteModule(lm);
+        if (rm) deleteModule(rm);
+        return 0;
+    }
+
+    if ((!lm && (lm = newModule(lomf)) == NULL) || (!rm && (rm = newModule(romf)) == NULL)) {
+        result = diffBinary(lomf, romf);
+        if (lm) deleteModule(lm);
+        return result;
     }
+    if (jsonMode)
+        jsonFiles(lomf->name, romf->name);
+    else
+        printf("%s : %s", lomf->name, romf->name);
+
+    
+    result = !diffModule(lm, rm);
+    if (jsonMode)
+        jsonResult(result ? "different" : "equivalent");
+    else
+        printf(result ? "\n" : " *** Equivalent\n");
     deleteModule(lm);
     deleteModule(rm);
+    return result;
 }
 
 
@@ -858,12 +1313,153 @@ _Noreturn void usage(char *fmt, ...) {
         vfprintf(stderr, fmt, args);
         va_end(args);
     }
-    fprintf(stderr, "\nUsage: %s -v | -V | file1 file2\n", invokedBy);
+    fprintf(stderr, "\nUsage: %s -v | -V | [-j n] [-c cachefile] [-q | --json] [-a | -A] file1 file2 |"
+                    " [-j n] [-c cachefile] [-q | --json] [-a | -A] -r dir1 dir2\n", invokedBy);
 
     exit(1);
 }
 
 
+/* returns the first record type of the file, normalised so that files that can be compared semantically
+ * have the same non zero kind, 0 if the file can only be compared as binary
+ */
+static int recordKind(byte type)
+{
+    switch (type) {
+    case LIBHDR: case MODHDR:
+        return type;
+    case LIBHED: case MSLIBHDR:     // both hold OMF86 modules
+        return LIBHED;
+    case THEADR: case LHEADR:
+        return THEADR;
+    }
+    return 0;
+}
+
+int fileKind(file_t *fi)
+{
+    return recordKind(fi->image[0]);
+}
+
+/* compare two files that are known to differ, returns 1 if the difference matters */
+int cmpFiles(file_t *left, file_t *right)
+{
+    omf_t *lomf, *romf;
+    int kind = fileKind(left) == fileKind(right) ? fileKind(left) : 0;
+
+    returnCode = 0;
+    if (kind == LIBHDR || kind == LIBHED)
+        cmpLibrary(left, right);
+    else {
+        lomf = newOMF(left, -1, 0, left->size);
+        romf = newOMF(right, -1, 0, right->size);
+        if (kind == MODHDR)
+            returnCode = cmpModule(lomf, romf);
+        else if (kind == THEADR)
+            returnCode = cmpModule86(lomf, romf);
+        else
+            returnCode = diffBinary(lomf, romf);
+        deleteOMF(lomf);
+        deleteOMF(romf);
+    }
+    return returnCode;
+}
+
+/* fill buf from fp, returns the number of bytes read, which is only short at the end of the file */
+static int readChunk(FILE *fp, byte *buf)
+{
+    int len = 0;
+    size_t actual;
+
+    while (len < CHUNKLEN && (actual = fread(buf + len, 1, CHUNKLEN - len, fp)) != 0)
+        len += (int)actual;
+    return len;
+}
+
+/* the chunk by chunk compare for streamFiles, returns as cmpFiles does */
+static int streamCompare(char *lname, char *rname, FILE *lfp, FILE *rfp, byte *lbuf, byte *rbuf)
+{
+    int llen = readChunk(lfp, lbuf);
+    int rlen = readChunk(rfp, rbuf);
+    int cmplen;
+    long long lsize = 0, rsize = 0;
+    int started = 0;
+
+    for (;;) {
+        cmplen = llen < rlen ? llen : rlen;
+        if (memcmp(lbuf, rbuf, cmplen) != 0) {
+            if (!started++)
+                binaryHeader(lname, rname);
+            diffRows(lsize, lbuf, rbuf, cmplen);
+        }
+        lsize += llen;
+        rsize += rlen;
+        if (llen < CHUNKLEN || rlen < CHUNKLEN)
+            break;
+        llen = readChunk(lfp, lbuf);
+        rlen = readChunk(rfp, rbuf);
+    }
+    /* only the length of whatever is left of the longer file matters */
+    if (llen == CHUNKLEN)
+        while ((llen = readChunk(lfp, lbuf)) != 0)
+            lsize += llen;
+    if (rlen == CHUNKLEN)
+        while ((rlen = readChunk(rfp, rbuf)) != 0)
+            rsize += rlen;
+
+    if (started || lsize != rsize) {
+        if (!started)
+            binaryHeader(lname, rname);
+        return binaryTail(lname, rname, lsize, rsize) || started;
+    }
+    if (jsonMode) {
+        jsonFiles(lname, rname);
+        jsonResult("identical");
+    }
+    else
+        printf("%s and %s are identical\n", lname, rname);
+    return 0;
+}
+
+/*
+ * compare two files that can only be compared byte for byte without loading either of them.
+ * Both are read CHUNKLEN bytes at a time and rows are reported as each chunk is compared,
+ * so the memory used is the same whatever the size of the files.
+ * returns -1 if the files need loading, i.e. either is empty or unreadable, left for newFile
+ * to report, or both start with the same kind of OMF record. Only the first byte of each is
+ * read to decide that, so OMF files aren't read twice. Otherwise returns as cmpFiles does
+ */
+int streamFiles(char *lname, char *rname)
+{
+    FILE *lfp, *rfp;
+    byte *lbuf, *rbuf;
+    int lc, rc;
+    int result;
+
+    if ((lfp = fopen(lname, "rb")) == NULL)
+        return -1;
+    if ((rfp = fopen(rname, "rb")) == NULL) {
+        fclose(lfp);
+        return -1;
+    }
+    lc = getc(lfp);
+    rc = getc(rfp);
+    if (lc == EOF || rc == EOF || (recordKind(lc) && recordKind(lc) == recordKind(rc))) {
+        fclose(lfp);
+        fclose(rfp);
+        return -1;
+    }
+    ungetc(lc, lfp);
+    ungetc(rc, rfp);
+    lbuf = (byte *)xmalloc(CHUNKLEN);
+    rbuf = (byte *)xmalloc(CHUNKLEN);
+    result = streamCompare(lname, rname, lfp, rfp, lbuf, rbuf);
+    free(lbuf);
+    free(rbuf);
+    fclose(lfp);
+    fclose(rfp);
+    return result;
+}
 
 
 
@@ -871,26 +1467,68 @@ _Noreturn void usage(char *fmt, ...) {
 int main(int argc, char **argv)
 {
     file_t *left, *right;
+    int treeMode = 0;
+    int result;
     invokedBy = argv[0];
 
     CHK_SHOW_VERSION(argc, argv);
-    if (argc != 3)
+    while (argc > 1 && argv[1][0] == '-' && argv[1][1]) {
+        if (strcmp(argv[1], "-j") == 0 && argc > 2) {
+            if ((workers = atoi(argv[2])) <= 0)
+                usage("-j needs a positive number of workers\n");
+            argc--, argv++;
+        }
+        else if (strcmp(argv[1], "-r") == 0)
+            treeMode = 1;
+        else if (strcmp(argv[1], "-c") == 0 && argc > 2) {
+            openCache(argv[2]);
+            argc--, argv++;
+        }
+        else if (strcmp(argv[1], "-q") == 0)
+            quiet = 1;
+        else if (strcmp(argv[1], "--json") == 0)
+            jsonMode = 1;
+        else if (strcmp(argv[1], "-a") == 0)
+            alignMode = ALIGNBYTES;
+        else if (strcmp(argv[1], "-A") == 0)
+            alignMode = ALIGNFIXUPS;
+        else
+            usage("Unknown option %s\n", argv[1]);
+        argc--, argv++;
+    }
+    if (argc != 3 || (quiet && jsonMode))
         usage(NULL);
+    /* with -q the comparison stops at the first difference, so there is nothing to gain from
+     * workers comparing modules that may never be looked at
+     */
+    if (quiet) {
+        workers = 1;
+#ifdef _MSC_VER
+        freopen("NUL", "w", stdout);
+#else
+        freopen("/dev/null", "w", stdout);
+#endif
+    }
+    if (treeMode)
+        return cmpTree(argv[1], argv[2]);
+
+    /* files that can only be compared byte for byte are streamed rather than loaded */
+    if ((result = streamFiles(argv[1], argv[2])) >= 0)
+        return result;
 
     if ((left = newFile(argv[1])) == NULL || (right = newFile(argv[2])) == NULL)
         usage(NULL);
 
     /* do a fast check to see if identical */
     if (left->size == right->size && memcmp(left->image, right->image, left->size) == 0) {
-        printf("%s and %s are identical\n", left->name, right->name);
+        if (jsonMode) {
+            jsonFiles(left->name, right->name);
+            jsonResult("identical");
+        }
+        else
+            printf("%s and %s are identical\n", left->name, right->name);
         return 0;
     }
 
-    if (left->image[0] == LIBHDR && right->image[0] == LIBHDR)
-        cmpLibrary(left, right);
-    else if (left->image[0] == MODHDR && right->image[0] == MODHDR)
-        cmpModule(newOMF(left, -1, 0, left->size), newOMF(right, -1, 0, right->size));
-    else
-        diffBinary(newOMF(left, -1, 0, left->size), newOMF(right, -1, 0, right->size));
-    return returnCode;
+    return cmpFiles(left, right);
 }
@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
 
 typedef unsigned char byte;
@@ -33,11 +34,18 @@ typedef unsigned short word;
 #include "util.h"
 #include "file.h"
 #include "omf.h"
+#include "omf86.h"
 #include "library.h"
+#include "cache.h"
+#include "json.h"
+#include "align.h"
+#include "pool.h"
+#include "tree.h"
 
 
 #define MAXNAME	31
 #define INITIALCHUNK 10
+#define MAXRUN  8
 
 enum {
     MODHDR = 0x2,
@@ -60,6 +68,13 @@ enum {
 };
 
 extern int returnCode;
-void diffBinary(omf_t *left, omf_t *right);
-void cmpModule(omf_t *lomf, omf_t *romf);
+void printPstr(byte *s);
+void printPstrPair(byte *s, byte *t);
+void emitRun(byte *seg, int addr, int run, short *lrun, short *rrun);
+int sameLength(byte *s, byte *t, int len);
+int diffBinary(omf_t *left, omf_t *right);
+int streamFiles(char *lname, char *rname);
+int cmpModule(omf_t *lomf, omf_t *romf);
+int fileKind(file_t *fi);
+int cmpFiles(file_t *left, file_t *right);
 void usage(char *fmt, ...);
\ No newline at end of file
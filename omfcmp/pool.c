@@ -0,0 +1,161 @@
+/****************************************************************************
+ *                                                                          *
+ *  omfcmp: compare two omf85 files                                         *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+/*
+ * simple worker pool for independent comparisons
+ * The module parser and the diff routines print directly to stdout, so rather
+ * than threads each worker is a forked process with its stdout redirected to
+ * a temporary file. Worker w runs jobs w, w + n, w + 2n ... and after each job
+ * records the span of the file it wrote, so the parent can return each job's
+ * output separately and the caller can print them in job order.
+ * Any job not run, because fork is not available, a worker could not be
+ * started or a worker died, is left with done clear for the caller to run
+ * itself.
+ */
+
+#include "omfcmp.h"
+#ifndef _MSC_VER
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+int workers = 0;		// -j n, 0 for one per processor
+static int inWorker;	// jobs run by a worker don't start their own pool
+
+#ifndef _MSC_VER
+typedef struct {
+    int job;
+    int result;
+    long start;
+    long end;
+} span_t;
+
+static int defaultWorkers()
+{
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#else
+    return 1;
+#endif
+}
+
+static void runWorker(int first, int step, int count, int (*job)(int index, void *arg), void *arg,
+                      FILE *text, FILE *spans)
+{
+    span_t span;
+
+    inWorker = 1;
+    if (dup2(fileno(text), STDOUT_FILENO) < 0)
+        _exit(1);
+    for (span.job = first; span.job < count; span.job += step) {
+        span.start = (long)lseek(STDOUT_FILENO, 0, SEEK_CUR);
+        span.result = job(span.job, arg);
+        fflush(stdout);
+        span.end = (long)lseek(STDOUT_FILENO, 0, SEEK_CUR);
+        fwrite(&span, sizeof(span), 1, spans);
+        fflush(spans);			// so a later failure only loses the remaining jobs
+    }
+    _exit(0);
+}
+
+static void collect(FILE *text, FILE *spans, jobResult_t *results)
+{
+    span_t span;
+    jobResult_t *r;
+
+    rewind(spans);
+    while (fread(&span, sizeof(span), 1, spans) == 1) {
+        r = &results[span.job];
+        r->length = span.end - span.start;
+        r->text = (char *)xmalloc(r->length + 1);
+        if (fseek(text, span.start, SEEK_SET) != 0 || fread(r->text, 1, r->length, text) != (size_t)r->length) {
+            free(r->text);
+            r->text = NULL;
+            continue;
+        }
+        r->text[r->length] = 0;
+        r->result = span.result;
+        r->done = 1;
+    }
+}
+#endif
+
+/*
+ * returns the results of running job(0..count-1, arg) on the worker pool,
+ * or NULL if there would be fewer than two workers or this is already a worker
+ */
+jobResult_t *runJobs(int count, int (*job)(int index, void *arg), void *arg)
+{
+#ifdef _MSC_VER
+    return NULL;
+#else
+    int n = workers > 0 ? workers : defaultWorkers();
+    int w, started;
+    jobResult_t *results;
+    FILE **text, **spans;
+    pid_t *pids;
+
+    if (n > count)
+        n = count;
+    if (n < 2 || inWorker)
+        return NULL;
+
+    results = (jobResult_t *)xcalloc(count, sizeof(jobResult_t));
+    text = (FILE **)xcalloc(n, sizeof(FILE *));
+    spans = (FILE **)xcalloc(n, sizeof(FILE *));
+    pids = (pid_t *)xcalloc(n, sizeof(pid_t));
+
+    fflush(NULL);				// don't let the workers inherit pending output
+    for (started = 0; started < n; started++) {
+        if ((text[started] = tmpfile()) == NULL || (spans[started] = tmpfile()) == NULL)
+            break;
+        if ((pids[started] = fork()) == 0)
+            runWorker(started, n, count, job, arg, text[started], spans[started]);
+        if (pids[started] < 0)
+            break;
+    }
+    for (w = 0; w < n; w++) {
+        if (w < started) {
+            waitpid(pids[w], NULL, 0);
+            collect(text[w], spans[w], results);
+        }
+        if (text[w])
+            fclose(text[w]);
+        if (spans[w])
+            fclose(spans[w]);
+    }
+    free(text);
+    free(spans);
+    free(pids);
+    return results;
+#endif
+}
+
+void deleteJobs(jobResult_t *results, int count)
+{
+    if (results) {
+        for (int i = 0; i < count; i++)
+            free(results[i].text);
+        free(results);
+    }
+}
@@ -0,0 +1,249 @@
+/****************************************************************************
+ *                                                                          *
+ *  genfix.c is part of omfcmp                                              *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+/*
+ * genfix writes the small OMF86 objects and libraries that test.sh compares
+ * to the current directory.
+ * Each module is the same base module with a few variations, so the pairs
+ * cover identical, equivalent, different and renamed modules, as well as
+ * inputs that once hung or crashed omfcmp or were misread: nested LIDATA
+ * blocks that repeat nothing, a library header with a corrupt module count
+ * and a record with a bad checksum.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SPLIT       1       // the code is split over two LEDATA records
+#define DIFFER      2       // a public moved and a segment, group member and external changed
+#define LIDZERO     4       // adds nested LIDATA blocks whose innermost repeat is 0
+#define BADSUM      8       // the code record's checksum is wrong
+
+static FILE *out;
+static long outPos;
+static unsigned char body[1024];
+static int bodyLen;
+
+static void put8(int val)
+{
+    body[bodyLen++] = (unsigned char)val;
+}
+
+static void put16(int val)
+{
+    put8(val & 0xff);
+    put8(val >> 8);
+}
+
+static void putName(char const *name)
+{
+    put8((int)strlen(name));
+    while (*name)
+        put8(*name++);
+}
+
+static void writeRec(int type)
+{
+    unsigned char hdr[3] = { (unsigned char)type, (bodyLen + 1) & 0xff, (bodyLen + 1) >> 8 };
+    unsigned char crc = hdr[0] + hdr[1] + hdr[2];
+    int i;
+
+    for (i = 0; i < bodyLen; i++)
+        crc += body[i];
+    crc = -crc;
+    fwrite(hdr, 1, 3, out);
+    fwrite(body, 1, bodyLen, out);
+    fwrite(&crc, 1, 1, out);
+    outPos += bodyLen + 4;
+    bodyLen = 0;
+}
+
+static void code(int start, int end)
+{
+    int i;
+
+    put8(1);                    // CODE
+    put16(start);
+    for (i = start; i < end; i++)
+        put8(i * 7 + 3);
+    writeRec(0xa0);
+}
+
+static void module(char const *name, int flags)
+{
+    static char const *lnames[] = { "", "CODE", "DATA", "DGROUP", "STACK", NULL };
+    long codePos;
+    int i;
+
+    putName(name);
+    writeRec(0x80);
+    for (i = 0; lnames[i]; i++)
+        putName(lnames[i]);
+    writeRec(0x96);
+    for (i = 1; i <= ((flags & DIFFER) ? 3 : 2); i++) {
+        put8(0x48);             // relocatable, word aligned, public
+        put16(i == 1 ? 0x40 : 0x20);
+        put8(i == 3 ? 5 : i + 1);
+        put8(i == 3 ? 5 : i + 1);
+        put8(1);
+        writeRec(0x98);
+    }
+    put8(4);                    // DGROUP
+    put8(0xff);
+    put8((flags & DIFFER) ? 1 : 2);
+    writeRec(0x9a);
+    putName("EXT1");
+    put8(0);
+    putName((flags & DIFFER) ? "EXT3" : "EXT2");
+    put8(0);
+    writeRec(0x8c);
+    put8(0);
+    put8(1);
+    putName("ENTRY");
+    put16((flags & DIFFER) ? 4 : 0);
+    put8(0);
+    writeRec(0x90);
+
+    if (flags & SPLIT) {
+        code(0, 0x10);
+        code(0x10, 0x20);
+    }
+    else {
+        codePos = outPos;
+        code(0, 0x20);
+        if (flags & BADSUM) {   // the first code byte is changed after the checksum is worked out
+            fseek(out, codePos + 6, SEEK_SET);
+            fputc(0xfb, out);   // rather than 3, so a sum of eight bytes at a time that carries between bytes is 0
+            fseek(out, 0, SEEK_END);
+        }
+    }
+    put8(0xc4);                 // segment relative offset at 0x12, from the start of the last LEDATA
+    put8((flags & SPLIT) ? 0x02 : 0x12);
+    put8(0x56);                 // F5, EXTDEF target, no displacement
+    put8(1);
+    writeRec(0x9c);
+
+    put8(2);                    // DATA
+    put16(0);
+    put16(4);                   // repeat
+    put16(0);
+    put8(2);
+    put8(0xaa);
+    put8(0x55);
+    writeRec(0xa2);
+    if (flags & LIDZERO) {
+        put8(2);
+        put16(8);
+        for (i = 0; i < 3; i++) {
+            put16(0xffff);
+            put16(1);
+        }
+        put16(0);
+        put16(0);
+        put8(1);
+        put8(0xcc);
+        writeRec(0xa2);
+    }
+    put8(0);
+    writeRec(0x8a);
+}
+
+static void libHeader(int count, long namesPos)
+{
+    put16(count);
+    put16(namesPos / 128);
+    put16(namesPos % 128);
+    writeRec(0xa4);
+}
+
+/* writes a library of the named modules, count being what the header claims */
+static void library(char const *fn, char const **names, int *flags, int cnt, int count)
+{
+    long modPos[8];
+    long namesPos;
+    int i;
+
+    if ((out = fopen(fn, "wb")) == NULL) {
+        fprintf(stderr, "%s: can't create\n", fn);
+        exit(1);
+    }
+    outPos = 0;
+    libHeader(count, 0);
+    for (i = 0; i < cnt; i++) {
+        modPos[i] = outPos;
+        module(names[i], flags[i]);
+    }
+    namesPos = outPos;
+    for (i = 0; i < cnt; i++)
+        putName(names[i]);
+    writeRec(0xa6);
+    for (i = 0; i < cnt; i++) {
+        put16(modPos[i] / 128);
+        put16(modPos[i] % 128);
+    }
+    writeRec(0xa8);
+    for (i = 0; i < cnt; i++) {
+        putName("ENTRY");
+        put8(0);
+    }
+    writeRec(0xaa);
+    fseek(out, 0, SEEK_SET);
+    libHeader(count, namesPos);
+    if (count != cnt) {         // a corrupt count, with a checksum of 0 so the header is still read
+        fseek(out, 9, SEEK_SET);
+        fputc(0, out);
+    }
+    fclose(out);
+}
+
+static void object(char const *fn, int flags)
+{
+    if ((out = fopen(fn, "wb")) == NULL) {
+        fprintf(stderr, "%s: can't create\n", fn);
+        exit(1);
+    }
+    outPos = 0;
+    module("MOD", flags);
+    fclose(out);
+}
+
+int main()
+{
+    static char const *names[] = { "MODA", "MODB" };
+    static char const *newNames[] = { "MODA", "MODC" };
+    static int base[] = { 0, 0 };
+    static int changed[] = { SPLIT, DIFFER };
+    static int lidzero[] = { LIDZERO, 0 };
+
+    object("base.obj", 0);
+    object("split.obj", SPLIT);
+    object("differ.obj", DIFFER);
+    object("lidzero.obj", LIDZERO);
+    object("badsum.obj", BADSUM);
+    library("base.lib", names, base, 2, 2);
+    library("changed.lib", names, changed, 2, 2);
+    library("lidzero.lib", names, lidzero, 2, 2);
+    library("renamed.lib", newNames, base, 2, 2);
+    library("badcount.lib", names, base, 2, 0xffff);
+    return 0;
+}
@@ -0,0 +1,46 @@
+#!/bin/bash
+# test.sh is part of omfcmp
+#
+# usage: test.sh omfcmp genfix goldendir
+# Compares the pairs of OMF86 objects and libraries written by genfix and
+# checks omfcmp's output and return code against the golden files. Each
+# comparison is given 10 seconds, so an input that makes omfcmp spin fails
+# rather than hanging the test. Run with UPDATE=1 to rewrite the golden files
+# after an intended change.
+
+OMFCMP=$(realpath "$1")
+GENFIX=$(realpath "$2")
+GOLDEN=$(realpath "$3")
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+failed=0
+
+# name|omfcmp options and files
+tests=(
+    "identical|base.obj base.obj"
+    "split|base.obj split.obj"
+    "differ|base.obj differ.obj"
+    "differ-quiet|-q base.obj differ.obj"
+    "lidzero|base.obj lidzero.obj"
+    "badsum|base.obj badsum.obj"
+    "library|base.lib changed.lib"
+    "library-lidzero|base.lib lidzero.lib"
+    "library-renamed|base.lib renamed.lib"
+    "badcount|badcount.lib base.lib"
+)
+
+cd "$WORK" && $GENFIX || exit 1
+for t in "${tests[@]}"; do
+    IFS='|' read -r name args <<< "$t"
+    timeout 10 $OMFCMP $args > "$name.out" 2>&1
+    echo "rc=$?" >> "$name.out"
+    if [ -n "$UPDATE" ]; then
+        cp "$name.out" "$GOLDEN/$name.out"
+    elif ! cmp -s "$name.out" "$GOLDEN/$name.out"; then
+        echo "test: $name differs"
+        diff "$GOLDEN/$name.out" "$name.out" | head -20
+        failed=1
+    fi
+done
+[ -n "$UPDATE" ] && echo "golden files updated" || [ $failed -ne 0 ] || echo "tests ok"
+exit $failed
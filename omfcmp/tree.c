@@ -0,0 +1,297 @@
+/****************************************************************************
+ *                                                                          *
+ *  omfcmp: compare two omf85 files                                         *
+ *  Copyright (C) 2020 Mark Ogden <mark.pm.ogden@btinternet.com>            *
+ *                                                                          *
+ *  This program is free software; you can redistribute it and/or           *
+ *  modify it under the terms of the GNU General Public License             *
+ *  as published by the Free Software Foundation; either version 2          *
+ *  of the License, or (at your option) any later version.                  *
+ *                                                                          *
+ *  This program is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ *  GNU General Public License for more details.                            *
+ *                                                                          *
+ *  You should have received a copy of the GNU General Public License       *
+ *  along with this program; if not, write to the Free Software             *
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,              *
+ *  MA  02110-1301, USA.                                                    *
+ *                                                                          *
+ ****************************************************************************/
+
+/*
+ * -r support
+ * Both trees are walked and the files paired by their path relative to the
+ * tree root. Links to directories are skipped, so a link loop can't make the
+ * walk recurse forever. Each pair is compared on the worker pool, the files
+ * first being checked byte for byte, so an identical pair is not parsed.
+ * Other pairs are compared as for a pair of files named on the command line,
+ * and the results are printed in path order followed by a summary.
+ */
+
+#include "omfcmp.h"
+#include <sys/stat.h>
+#ifdef _MSC_VER
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
+
+enum {
+    IDENTICAL = 0,
+    EQUIVALENT,
+    DIFFERENT,
+    MISSING,
+    PENDING
+};
+
+typedef struct {
+    char *path;         // relative to the tree root
+    long long size;
+} entry_t;
+
+typedef struct {
+    int cnt;
+    int size;
+    entry_t *items;
+} list_t;
+
+typedef struct {
+    char *path;         // relative to the tree roots
+    entry_t *left;      // NULL if only in the right tree
+    entry_t *right;     // NULL if only in the left tree
+    int status;
+} pair_t;
+
+typedef struct {
+    char *leftDir, *rightDir;
+    pair_t *pairs;
+    int *jobPair;       // pair index of each comparison
+} treecmp_t;
+
+
+static char *joinPath(char *dir, char *name)
+{
+    size_t len = strlen(dir);
+    char *path = (char *)xmalloc(len + strlen(name) + 2);
+
+    strcpy(path, dir);
+    if (len && *name && dir[len - 1] != '/' && dir[len - 1] != '\\')
+        path[len++] = '/';
+    strcpy(path + len, name);
+    return path;
+}
+
+static void addEntry(list_t *list, char *path, long long size)
+{
+    if (list->cnt >= list->size) {
+        list->size = list->size ? list->size * 2 : 256;
+        list->items = (entry_t *)xrealloc(list->items, list->size * sizeof(entry_t));
+    }
+    list->items[list->cnt].path = path;
+    list->items[list->cnt++].size = size;
+}
+
+static int isLink(char *path)
+{
+#ifdef _MSC_VER
+    return 0;
+#else
+    struct stat st;
+
+    return lstat(path, &st) == 0 && (st.st_mode & S_IFMT) == S_IFLNK;
+#endif
+}
+
+static void scanDir(list_t *list, char *root, char *rel);
+
+static void addPath(list_t *list, char *root, char *rel)	// takes ownership of rel
+{
+    struct stat st;
+    char *path = joinPath(root, rel);
+
+    if (stat(path, &st) != 0)
+        fprintf(stderr, "%s: can't access\n", path);
+    else if ((st.st_mode & S_IFMT) == S_IFDIR) {
+        if (isLink(path))
+            fprintf(stderr, "%s: link to a directory skipped\n", path);
+        else
+            scanDir(list, root, rel);
+    }
+    else if ((st.st_mode & S_IFMT) == S_IFREG) {
+        addEntry(list, rel, st.st_size);
+        rel = NULL;
+    }
+    free(path);
+    free(rel);
+}
+
+static void scanDir(list_t *list, char *root, char *rel)
+{
+    char *dir = joinPath(root, rel);
+#ifdef _MSC_VER
+    struct _finddata_t fd;
+    char *pattern = joinPath(dir, "*");
+    intptr_t handle;
+
+    if ((handle = _findfirst(pattern, &fd)) == -1)
+        fprintf(stderr, "%s: can't open directory\n", dir);
+    else {
+        do {
+            if (strcmp(fd.name, ".") != 0 && strcmp(fd.name, "..") != 0)
+                addPath(list, root, joinPath(rel, fd.name));
+        } while (_findnext(handle, &fd) == 0);
+        _findclose(handle);
+    }
+    free(pattern);
+#else
+    DIR *dp;
+    struct dirent *de;
+
+    if ((dp = opendir(dir)) == NULL)
+        fprintf(stderr, "%s: can't open directory\n", dir);
+    else {
+        while ((de = readdir(dp)))
+            if (strcmp(de->d_name, ".") != 0 && strcmp(de->d_name, "..") != 0)
+                addPath(list, root, joinPath(rel, de->d_name));
+        closedir(dp);
+    }
+#endif
+    free(dir);
+}
+
+static int cmpEntry(const void *a, const void *b)
+{
+    return strcmp(((const entry_t *)a)->path, ((const entry_t *)b)->path);
+}
+
+static void scanTree(list_t *list, char *root)
+{
+    struct stat st;
+
+    if (stat(root, &st) != 0 || (st.st_mode & S_IFMT) != S_IFDIR)
+        usage("%s is not a directory\n", root);
+    scanDir(list, root, "");
+    qsort(list->items, (size_t)list->cnt, sizeof(entry_t), cmpEntry);
+}
+
+static int cmpPair(int job, void *arg)
+{
+    treecmp_t *cmp = arg;
+    pair_t *pair = &cmp->pairs[cmp->jobPair[job]];
+    char *lpath, *rpath;
+    file_t *left, *right = NULL;
+    int status = DIFFERENT;
+
+    if (pair->left->size == 0 && pair->right->size == 0)	// newFile rejects empty files
+        return IDENTICAL;
+    lpath = joinPath(cmp->leftDir, pair->path);
+    rpath = joinPath(cmp->rightDir, pair->path);
+    if ((left = newFile(lpath)) && (right = newFile(rpath))) {
+        if (left->size == right->size && memcmp(left->image, right->image, left->size) == 0)
+            status = IDENTICAL;
+        else if (cmpFiles(left, right) == 0)
+            status = EQUIVALENT;
+    }
+    else    // with --json the pair is still reported as different, so keep stdout to records
+        fprintf(jsonMode ? stderr : stdout, "%s : %s can't be compared\n", lpath, rpath);
+    if (left)
+        deleteFile(left);
+    if (right)
+        deleteFile(right);
+    free(lpath);
+    free(rpath);
+    return status;
+}
+
+int cmpTree(char *leftDir, char *rightDir)
+{
+    list_t ll = { 0 }, rl = { 0 };
+    treecmp_t cmp;
+    jobResult_t *results;
+    int counts[MISSING + 1] = { 0 };
+    int i, li, ri, cnt, jobCnt, job;
+    int diff;
+    static char const *const statusNames[] = { "identical", "equivalent", "different", "missing" };
+
+    scanTree(&ll, leftDir);
+    scanTree(&rl, rightDir);
+
+    cmp.leftDir = leftDir;
+    cmp.rightDir = rightDir;
+    cmp.pairs = (pair_t *)xcalloc(ll.cnt + rl.cnt + 1, sizeof(pair_t));
+    cmp.jobPair = (int *)xmalloc((ll.cnt + 1) * sizeof(int));
+
+    /* merge the two sorted lists, each pair of files in both trees is a job */
+    for (cnt = li = ri = jobCnt = 0; li < ll.cnt || ri < rl.cnt; cnt++) {
+        pair_t *pair = &cmp.pairs[cnt];
+
+        if (li == ll.cnt)
+            diff = 1;
+        else if (ri == rl.cnt)
+            diff = -1;
+        else
+            diff = strcmp(ll.items[li].path, rl.items[ri].path);
+        if (diff <= 0) {
+            pair->path = ll.items[li].path;
+            pair->left = &ll.items[li++];
+        }
+        if (diff >= 0) {
+            pair->path = rl.items[ri].path;
+            pair->right = &rl.items[ri++];
+        }
+        if (diff)
+            pair->status = MISSING;
+        else {
+            pair->status = PENDING;
+            cmp.jobPair[jobCnt++] = cnt;
+        }
+    }
+
+    results = runJobs(jobCnt, cmpPair, &cmp);
+
+    for (i = job = 0; i < cnt; i++) {
+        pair_t *pair = &cmp.pairs[i];
+
+        if (pair->status == MISSING) {
+            foundDifference();
+            if (jsonMode)
+                jsonFile(pair->path, statusNames[MISSING]);
+            else
+                printf("%s only in %s\n", pair->path, pair->left ? leftDir : rightDir);
+        }
+        else if (pair->status == PENDING) {
+            if (results && results[job].done) {
+                fwrite(results[job].text, 1, results[job].length, stdout);
+                pair->status = results[job].result;
+            }
+            else
+                pair->status = cmpPair(job, &cmp);
+            job++;
+            if (pair->status == DIFFERENT)
+                foundDifference();
+            if (jsonMode)
+                jsonFile(pair->path, statusNames[pair->status]);
+        }
+        else if (jsonMode)
+            jsonFile(pair->path, statusNames[pair->status]);
+        counts[pair->status]++;
+    }
+    if (jsonMode)
+        jsonSummary(counts[IDENTICAL], counts[EQUIVALENT], counts[DIFFERENT], counts[MISSING]);
+    else
+        printf("\n%d identical, %d equivalent, %d different, %d missing\n",
+               counts[IDENTICAL], counts[EQUIVALENT], counts[DIFFERENT], counts[MISSING]);
+
+    deleteJobs(results, jobCnt);
+    for (i = 0; i < ll.cnt; i++)
+        free(ll.items[i].path);
+    for (i = 0; i < rl.cnt; i++)
+        free(rl.items[i].path);
+    free(ll.items);
+    free(rl.items);
+    free(cmp.pairs);
+    free(cmp.jobPair);
+    return counts[DIFFERENT] || counts[MISSING];
+}
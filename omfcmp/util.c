@@ -64,4 +64,30 @@ int pstrCmp(byte *s, byte *t)
     if ((cmp = strncmp((char *)s + 1, (char *)t + 1, *s <= *t ? *s : *t)) == 0)
         cmp = *s - *t;
     return cmp;
-}
\ No newline at end of file
+}
+
+static uint64_t rotl(uint64_t x, int n)
+{
+    return (x << n) | (x >> (64 - n));
+}
+
+/* adds len bytes to a 64 bit hash, a word at a time. Call hashFinal on the result */
+uint64_t hashBytes(uint64_t hash, byte *s, int len)
+{
+    uint64_t chunk;
+
+    for (; len >= 8; s += 8, len -= 8) {
+        memcpy(&chunk, s, 8);
+        hash = rotl(hash ^ (chunk * 0x87C37B91114253D5ULL), 27) * 0x4CF5AD432745937FULL;
+    }
+    for (chunk = 0; len > 0; len--)
+        chunk = (chunk << 8) | *s++;
+    return rotl(hash ^ (chunk * 0x87C37B91114253D5ULL), 27) * 0x4CF5AD432745937FULL;
+}
+
+uint64_t hashFinal(uint64_t hash)		// final mix so all bits depend on the last word
+{
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    return hash ^ (hash >> 33);
+}
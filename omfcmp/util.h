@@ -26,4 +26,6 @@ void *xmalloc(size_t len);
 void *xrealloc(void *buf, size_t len);
 void *xcalloc(size_t len, size_t size);
 int pstrEqu(byte *s, byte *t);
-int pstrCmp(byte *s, byte *t);
\ No newline at end of file
+int pstrCmp(byte *s, byte *t);
+uint64_t hashBytes(uint64_t hash, byte *s, int len);
+uint64_t hashFinal(uint64_t hash);